@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+/* standard library header */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <new>
+
+/* SLP library header */
+
+/* local header */
+#include "APDUHelper.h"
+
+using namespace smartcard_service_api;
+
+/* every allocation of the process, the common library included */
+static unsigned long allocations = 0;
+
+void *operator new(size_t size) throw (std::bad_alloc)
+{
+	void *result;
+
+	allocations++;
+
+	if ((result = malloc(size > 0 ? size : 1)) == NULL)
+		throw std::bad_alloc();
+
+	return result;
+}
+
+void *operator new[](size_t size) throw (std::bad_alloc)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) throw ()
+{
+	allocations++;
+
+	return malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) throw ()
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *pointer) throw ()
+{
+	free(pointer);
+}
+
+void operator delete[](void *pointer) throw ()
+{
+	free(pointer);
+}
+
+static double getElapsed(const struct timespec &begin, const struct timespec &end)
+{
+	return (end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec);
+}
+
+/* one SELECT by file id and the parsing of its FCP response, as done for
+ * each file of the access control loader */
+int main(int argc, char *argv[])
+{
+	unsigned char fid[] = { 0x3F, 0x00 };
+	unsigned char fcp[] = { 0x6F, 0x10, 0x82, 0x01, 0x38, 0x83, 0x02, 0x3F,
+		0x00, 0x8A, 0x01, 0x05, 0x80, 0x02, 0x00, 0x20, 0x90, 0x00 };
+	ByteArray file(fid, sizeof(fid));
+	ByteArray response(fcp, sizeof(fcp));
+	struct timespec begin, end;
+	unsigned long before;
+	int count, i;
+
+	count = (argc > 1) ? atoi(argv[1]) : 1000000;
+	if (count <= 0)
+	{
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	before = allocations;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < count; i++)
+	{
+		ByteArray command = APDUHelper::generateAPDU(APDUHelper::COMMAND_SELECT_BY_ID, 0, file);
+		ResponseHelper helper(response);
+		ByteArray data;
+
+		if (command.getLength() != 7 || helper.getStatus() != 0)
+		{
+			fprintf(stderr, "unexpected apdu [%d] or status [%d]\n", command.getLength(), helper.getStatus());
+			return 1;
+		}
+
+		data = helper.getDataField();
+		if (data.getLength() != sizeof(fcp) - 2)
+		{
+			fprintf(stderr, "unexpected data length [%d]\n", data.getLength());
+			return 1;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("generateAPDU + ResponseHelper : %.2f allocations, %.0f ns per cycle (%d cycles)\n",
+		(double)(allocations - before) / count, getElapsed(begin, end) / count, count);
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+/* standard library header */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* SLP library header */
+
+/* local header */
+#include "AccessCondition.h"
+
+using namespace smartcard_service_api;
+
+/* APDUFilters choice of count entries, UPDATE BINARY ones and READ BINARY last */
+static void loadFilters(APDUAccessRule &rule, unsigned int count)
+{
+	unsigned char buffer[2 + 16 * 10];
+	unsigned int i, length = 0;
+
+	if (count == 0 || count > 16)
+		return;
+
+	buffer[length++] = 0xA1;
+	buffer[length++] = count * 10;
+
+	for (i = 0; i < count; i++)
+	{
+		unsigned char filter[] = { 0x04, 0x08, 0x00, 0xD6, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00 };
+
+		if (i == count - 1)
+			filter[3] = 0xB0;
+
+		memcpy(buffer + length, filter, sizeof(filter));
+		length += sizeof(filter);
+	}
+
+	rule.loadAPDUAccessRule(ByteArray(buffer, length));
+}
+
+static bool run(const char *title, const APDUAccessRule &rule, const ByteArray &command, bool expected, int count)
+{
+	struct timespec begin, end;
+	int i, allowed = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < count; i++)
+	{
+		if (rule.isAuthorizedAccess(command) == true)
+			allowed++;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (allowed != (expected ? count : 0))
+	{
+		fprintf(stderr, "%s : unexpected result [%d/%d]\n", title, allowed, count);
+		return false;
+	}
+
+	printf("%-22s : %6.2f ns per check\n", title,
+		((end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec)) / count);
+
+	return true;
+}
+
+/* cost of the apdu filter check done by the daemon on every transmit */
+int main(int argc, char *argv[])
+{
+	/* READ BINARY on logical channel 1, filters are matched as basic channel */
+	unsigned char read[] = { 0x01, 0xB0, 0x00, 0x00, 0x10 };
+	unsigned char get[] = { 0x00, 0xCA, 0x00, 0x00, 0x00 };
+	ByteArray readBinary(read, sizeof(read));
+	ByteArray getData(get, sizeof(get));
+	APDUAccessRule none, one, many;
+	int count;
+
+	count = (argc > 1) ? atoi(argv[1]) : 20000000;
+	if (count <= 0)
+	{
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	loadFilters(one, 1);
+	loadFilters(many, 16);
+
+	if (run("no filters", none, readBinary, true, count) == false ||
+		run("1 filter", one, readBinary, true, count) == false ||
+		run("16 filters, miss", many, getData, false, count) == false ||
+		run("16 filters, last", many, readBinary, true, count) == false)
+	{
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+/* standard library header */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* SLP library header */
+
+/* local header */
+#include "FileObject.h"
+#include "EmulatorTerminal.h"
+
+using namespace smartcard_service_api;
+
+/* basic channel wired straight to the terminal. a round trip is one call
+ * from the channel into the terminal, as one request to the worker of the
+ * daemon; batched, all commands of a transmitSync go in one trip */
+class BenchChannel : public Channel
+{
+private:
+	Terminal *terminal;
+	bool batched;
+
+public:
+	unsigned int trips;
+	unsigned int apdus;
+
+	BenchChannel(Terminal *terminal, bool batched) : Channel()
+	{
+		this->terminal = terminal;
+		this->batched = batched;
+		session = NULL;
+		channelNum = 0;
+		trips = 0;
+		apdus = 0;
+	}
+
+	int transmitSync(const ByteArray &command, ByteArray &result)
+	{
+		trips++;
+		apdus++;
+
+		return terminal->transmitSync(command, result);
+	}
+
+	int transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results)
+	{
+		int rv = 0;
+		size_t i;
+
+		if (batched == false)
+			return Channel::transmitSync(commands, results);
+
+		trips++;
+		results.clear();
+
+		for (i = 0; i < commands.size(); i++)
+		{
+			ByteArray response;
+
+			apdus++;
+			if ((rv = terminal->transmitSync(commands[i], response)) != 0)
+				break;
+
+			results.push_back(response);
+
+			if (response.getLength() < 2 || response[response.getLength() - 2] != 0x90 || response[response.getLength() - 1] != 0x00)
+				break;
+		}
+
+		return rv;
+	}
+
+	void closeSync() {}
+	int close(closeCallback callback, void *userParam) { return -1; }
+	int transmit(const ByteArray &command, transmitCallback callback, void *userData) { return -1; }
+};
+
+static bool checkContents(const ByteArray &data, unsigned int size)
+{
+	unsigned int i;
+
+	if (data.getLength() != size)
+		return false;
+
+	for (i = 0; i < size; i++)
+	{
+		if (data[i] != (unsigned char)(i + (i >> 8)))
+			return false;
+	}
+
+	return true;
+}
+
+static bool run(const char *title, Terminal *terminal, bool batched, unsigned int maxResponseSize, unsigned int size, int count)
+{
+	unsigned char path[] = { 0x60, 0x01 };
+	BenchChannel channel(terminal, batched);
+	FileObject file(&channel);
+	struct timespec begin, end;
+	ByteArray data;
+	int i;
+
+	channel.setMaxResponseSize(maxResponseSize);
+
+	if (file.select(ByteArray(path, sizeof(path)), false) != FileObject::SUCCESS)
+	{
+		fprintf(stderr, "%s : select failed\n", title);
+		return false;
+	}
+
+	/* contents are checked once, outside of the measurement */
+	if (file.readBinary(0, 0, size, data) != FileObject::SUCCESS || checkContents(data, size) == false)
+	{
+		fprintf(stderr, "%s : wrong contents [%d]\n", title, data.getLength());
+		return false;
+	}
+
+	channel.trips = 0;
+	channel.apdus = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < count; i++)
+	{
+		if (file.readBinary(0, 0, size, data) != FileObject::SUCCESS || data.getLength() != size)
+		{
+			fprintf(stderr, "%s : read failed [%d]\n", title, data.getLength());
+			return false;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%-26s : %9.1f us per read, %u apdus, %u round trips\n", title,
+		((end.tv_sec - begin.tv_sec) * 1e6 + (end.tv_nsec - begin.tv_nsec) / 1e3) / count,
+		channel.apdus / count, channel.trips / count);
+
+	return true;
+}
+
+/* READ BINARY of a large ef on the emulator, by short chunks one call each,
+ * by short chunks in one batch and by one extended length command.
+ * SE_EMULATOR_LATENCY_US adds a delay to every apdu */
+int main(int argc, char *argv[])
+{
+	EmulatorTerminal terminal;
+	unsigned int size;
+	char buffer[16];
+	int count;
+
+	size = (argc > 1) ? strtoul(argv[1], NULL, 10) : 8192;
+	count = (argc > 2) ? atoi(argv[2]) : 20;
+	if (size == 0 || size > 0x8000 || count <= 0)
+	{
+		fprintf(stderr, "usage: %s [file size, up to 32768] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	snprintf(buffer, sizeof(buffer), "%u", size);
+	setenv("SE_EMULATOR_EF_SIZE", buffer, 1);
+	setenv("SE_EMULATOR_SYNC", "1", 1);
+
+	if (terminal.initialize() == false)
+	{
+		fprintf(stderr, "emulator initialize failed\n");
+		return 1;
+	}
+
+	if (run("short, one call per chunk", &terminal, false, 256, size, count) == false ||
+		run("short, batched", &terminal, true, 256, size, count) == false ||
+		run("extended length", &terminal, true, 65536, size, count) == false)
+	{
+		return 1;
+	}
+
+	return 0;
+}
@@ -38,6 +38,7 @@ namespace smartcard_service_api
 		this->channelNum = -1;
 		this->handle = NULL;
 		this->context = NULL;
+		this->autoGetResponse = false;
 
 		if (handle == NULL)
 		{
@@ -58,8 +59,14 @@ namespace smartcard_service_api
 	}
 
 	void ClientChannel::closeSync()
+	{
+		closeSync(-1);
+	}
+
+	void ClientChannel::closeSync(int timeout)
 	{
 		Message msg;
+		Future future;
 		int rv;
 
 		if (isClosed() == false)
@@ -69,14 +76,8 @@ namespace smartcard_service_api
 			msg.param1 = (int)handle;
 			msg.error = (unsigned int)context; /* using error to context */
 			msg.caller = (void *)this;
-			msg.callback = (void *)this; /* if callback is class instance, it means synchronized call */
-
-			ClientIPC::getInstance().sendMessage(&msg);
-
-			syncLock();
-			rv = waitTimedCondition(0);
-			syncUnlock();
 
+			rv = ClientIPC::getInstance().sendRequestSync(&msg, &future, timeout);
 			if (rv < 0)
 			{
 				SCARD_DEBUG_ERR("closeSync failed [%d]", rv);
@@ -102,59 +103,184 @@ namespace smartcard_service_api
 			msg.callback = (void *)callback;
 			msg.userParam = userParam;
 
-			ClientIPC::getInstance().sendMessage(&msg);
+			ClientIPC::getInstance().sendRequest(&msg);
 		}
 
 		return 0;
 	}
 
-	int ClientChannel::transmitSync(ByteArray command, ByteArray &result)
+	int ClientChannel::transmitSync(const ByteArray &command, ByteArray &result)
+	{
+		return transmitSync(command, result, -1);
+	}
+
+	int ClientChannel::transmitSync(const ByteArray &command, ByteArray &result, int timeout)
+	{
+		unsigned int chainedCount;
+
+		return transmitSync(command, result, timeout, chainedCount);
+	}
+
+	int ClientChannel::transmitSync(const ByteArray &command, ByteArray &result, int timeout, unsigned int &chainedCount)
 	{
 		Message msg;
+		Future future;
 		int rv;
 
+		chainedCount = 0;
+
 		/* send message to server */
 		msg.message = Message::MSG_REQUEST_TRANSMIT;
 		msg.param1 = (int)handle;
-		msg.param2 = 0;
+		msg.param2 = autoGetResponse ? Message::TRANSMIT_AUTO_GET_RESPONSE : 0;
 		msg.data = command;
 		msg.error = (unsigned int)context; /* using error to context */
 		msg.caller = (void *)this;
-		msg.callback = (void *)this; /* if callback is class instance, it means synchronized call */
 
-		ClientIPC::getInstance().sendMessage(&msg);
+		rv = ClientIPC::getInstance().sendRequestSync(&msg, &future, timeout);
+		if (rv < 0 || future.error != 0)
+		{
+			SCARD_DEBUG_ERR("transmit failed, rv [%d], error [%d]", rv, future.error);
+
+			return -1;
+		}
+
+		result = future.data;
+		chainedCount = future.param2;
 
-		syncLock();
-		rv = waitTimedCondition(0);
-		syncUnlock();
+		return 0;
+	}
+
+	int ClientChannel::transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results)
+	{
+		unsigned int chainedCount;
+
+		return transmitSync(commands, results, chainedCount);
+	}
+
+	int ClientChannel::transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results, unsigned int &chainedCount)
+	{
+		Message msg;
+		Future future;
+		int rv;
+
+		results.clear();
+		chainedCount = 0;
+
+		if (commands.size() == 0 || commands.size() > Message::MAX_BATCH_COUNT)
+		{
+			SCARD_DEBUG_ERR("invalid command count [%d]", (int)commands.size());
+
+			return -1;
+		}
 
+		/* send message to server */
+		msg.message = Message::MSG_REQUEST_TRANSMIT_BATCH;
+		msg.param1 = (int)handle;
+		msg.param2 = Message::TRANSMIT_BATCH_STOP_ON_ERROR;
+		if (autoGetResponse == true)
+		{
+			msg.param2 |= Message::TRANSMIT_AUTO_GET_RESPONSE;
+		}
+		msg.data = Message::serializeList(commands);
+		msg.error = (unsigned int)context; /* using error to context */
+		msg.caller = (void *)this;
+
+		rv = ClientIPC::getInstance().sendRequestSync(&msg, &future, -1);
 		if (rv < 0)
 		{
-			SCARD_DEBUG_ERR("clientIPC is null");
+			SCARD_DEBUG_ERR("transmit failed, rv [%d]", rv);
 
 			return -1;
 		}
 
-		result = response;
+		/* responses of executed commands come even if one of them failed */
+		Message::deserializeList(future.data, results);
+		chainedCount = future.param2;
 
-		return 0;
+		return (future.error != 0) ? -1 : 0;
 	}
 
-	int ClientChannel::transmit(ByteArray command, transmitCallback callback, void *userParam)
+	int ClientChannel::transmit(const ByteArray &command, transmitCallback callback, void *userParam)
 	{
 		Message msg;
 
 		/* send message to server */
 		msg.message = Message::MSG_REQUEST_TRANSMIT;
 		msg.param1 = (int)handle;
-		msg.param2 = 0;
+		msg.param2 = autoGetResponse ? Message::TRANSMIT_AUTO_GET_RESPONSE : 0;
 		msg.data = command;
 		msg.error = (unsigned int)context; /* using error to context */
 		msg.caller = (void *)this;
 		msg.callback = (void *)callback;
 		msg.userParam = userParam;
 
-		ClientIPC::getInstance().sendMessage(&msg);
+		if (ClientIPC::getInstance().sendRequest(&msg) == false)
+		{
+			return -1;
+		}
+
+		return 0;
+	}
+
+	int ClientChannel::transmit(const ByteArray &command, transmitChainedCallback callback, void *userParam)
+	{
+		chained_context_t *chained;
+
+		if (callback == NULL)
+		{
+			return transmit(command, (transmitCallback)NULL, userParam);
+		}
+
+		chained = new chained_context_t;
+		chained->callback = callback;
+		chained->userParam = userParam;
+
+		/* the context goes as user parameter, unwrapped by the dispatcher with the reply */
+		if (transmit(command, &ClientChannel::chainedCallback, chained) != 0)
+		{
+			delete chained;
+
+			return -1;
+		}
+
+		return 0;
+	}
+
+	void ClientChannel::chainedCallback(unsigned char *buffer, unsigned int length, int error, void *userParam)
+	{
+		/* never called, marks requests of transmitChainedCallback */
+	}
+
+	int ClientChannel::transmitBatch(vector<ByteArray> &commands, bool stopOnError, transmitBatchCallback callback, void *userParam)
+	{
+		Message msg;
+
+		if (commands.size() == 0 || commands.size() > Message::MAX_BATCH_COUNT)
+		{
+			SCARD_DEBUG_ERR("invalid command count [%d]", (int)commands.size());
+
+			return -1;
+		}
+
+		/* send message to server */
+		msg.message = Message::MSG_REQUEST_TRANSMIT_BATCH;
+		msg.param1 = (int)handle;
+		msg.param2 = stopOnError ? Message::TRANSMIT_BATCH_STOP_ON_ERROR : 0;
+		if (autoGetResponse == true)
+		{
+			msg.param2 |= Message::TRANSMIT_AUTO_GET_RESPONSE;
+		}
+		msg.data = Message::serializeList(commands);
+		msg.error = (unsigned int)context; /* using error to context */
+		msg.caller = (void *)this;
+		msg.callback = (void *)callback;
+		msg.userParam = userParam;
+
+		if (ClientIPC::getInstance().sendRequest(&msg) == false)
+		{
+			return -1;
+		}
 
 		return 0;
 	}
@@ -162,7 +288,6 @@ namespace smartcard_service_api
 	bool ClientChannel::dispatcherCallback(void *message)
 	{
 		Message *msg = (Message *)message;
-		ClientChannel *channel = NULL;
 		bool result = false;
 
 		if (msg == NULL)
@@ -171,8 +296,6 @@ namespace smartcard_service_api
 			return result;
 		}
 
-		channel = (ClientChannel *)msg->caller;
-
 		switch (msg->message)
 		{
 		case Message::MSG_REQUEST_TRANSMIT :
@@ -180,17 +303,14 @@ namespace smartcard_service_api
 				/* transmit result */
 				SCARD_DEBUG("MSG_REQUEST_TRANSMIT");
 
-				if (msg->callback == (void *)channel) /* synchronized call */
+				if (msg->callback == (void *)&ClientChannel::chainedCallback)
 				{
-					/* sync call */
-					channel->syncLock();
+					chained_context_t *chained = (chained_context_t *)msg->userParam;
 
-					/* copy result */
-					channel->error = msg->error;
-					channel->response = msg->data;
+					/* async call, with the chained count of this request */
+					chained->callback(msg->data.getBuffer(), msg->data.getLength(), msg->param2, msg->error, chained->userParam);
 
-					channel->signalCondition();
-					channel->syncUnlock();
+					delete chained;
 				}
 				else if (msg->callback != NULL)
 				{
@@ -202,21 +322,44 @@ namespace smartcard_service_api
 			}
 			break;
 
-		case Message::MSG_REQUEST_CLOSE_CHANNEL :
+		case Message::MSG_REQUEST_TRANSMIT_BATCH :
 			{
-				SCARD_DEBUG("MSG_REQUEST_CLOSE_CHANNEL");
+				SCARD_DEBUG("MSG_REQUEST_TRANSMIT_BATCH");
 
-				if (msg->callback == (void *)channel) /* synchronized call */
+				if (msg->callback != NULL)
 				{
-					/* sync call */
-					channel->syncLock();
+					transmitBatchCallback cb = (transmitBatchCallback)msg->callback;
+					vector<ByteArray> responses;
+					vector<unsigned char *> buffers;
+					vector<unsigned int> lengths;
+					size_t i;
+
+					Message::deserializeList(msg->data, responses);
 
-					channel->error = msg->error;
+					for (i = 0; i < responses.size(); i++)
+					{
+						buffers.push_back(responses[i].getBuffer());
+						lengths.push_back(responses[i].getLength());
+					}
 
-					channel->signalCondition();
-					channel->syncUnlock();
+					/* async call */
+					if (responses.size() > 0)
+					{
+						cb(&buffers[0], &lengths[0], responses.size(), msg->param2, msg->error, msg->userParam);
+					}
+					else
+					{
+						cb(NULL, NULL, 0, msg->param2, msg->error, msg->userParam);
+					}
 				}
-				else if (msg->callback != NULL)
+			}
+			break;
+
+		case Message::MSG_REQUEST_CLOSE_CHANNEL :
+			{
+				SCARD_DEBUG("MSG_REQUEST_CLOSE_CHANNEL");
+
+				if (msg->callback != NULL)
 				{
 					closeCallback cb = (closeCallback)msg->callback;
 
@@ -277,6 +420,44 @@ EXTERN_API int channel_transmit(channel_h handle, unsigned char *command, unsign
 	return result;
 }
 
+EXTERN_API int channel_transmit_chained(channel_h handle, unsigned char *command, unsigned int length, channel_transmit_chained_cb callback, void *userParam)
+{
+	int result = -1;
+
+	CHANNEL_EXTERN_BEGIN;
+	ByteArray temp;
+
+	temp.setBuffer(command, length);
+	result = channel->transmit(temp, (transmitChainedCallback)callback, userParam);
+	CHANNEL_EXTERN_END;
+
+	return result;
+}
+
+EXTERN_API int channel_transmit_batch(channel_h handle, unsigned char **commands, unsigned int *lengths, unsigned int count, bool stopOnError, channel_transmit_batch_cb callback, void *userParam)
+{
+	int result = -1;
+
+	if (commands == NULL || lengths == NULL || count == 0)
+	{
+		return result;
+	}
+
+	CHANNEL_EXTERN_BEGIN;
+	vector<ByteArray> temp;
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+	{
+		temp.push_back(ByteArray(commands[i], lengths[i]));
+	}
+
+	result = channel->transmitBatch(temp, stopOnError, (transmitBatchCallback)callback, userParam);
+	CHANNEL_EXTERN_END;
+
+	return result;
+}
+
 EXTERN_API bool channel_is_basic_channel(channel_h handle)
 {
 	bool result = false;
@@ -299,6 +480,13 @@ EXTERN_API bool channel_is_closed(channel_h handle)
 	return result;
 }
 
+EXTERN_API void channel_set_auto_get_response(channel_h handle, bool enable)
+{
+	CHANNEL_EXTERN_BEGIN;
+	channel->setAutoGetResponse(enable);
+	CHANNEL_EXTERN_END;
+}
+
 EXTERN_API unsigned int channel_get_select_response_length(channel_h handle)
 {
 	unsigned int result = 0;
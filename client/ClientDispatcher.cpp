@@ -27,6 +27,7 @@
 #include "Reader.h"
 #include "Session.h"
 #include "ClientChannel.h"
+#include "ClientIPC.h"
 
 namespace smartcard_service_api
 {
@@ -92,6 +93,10 @@ namespace smartcard_service_api
 		if (msg == NULL)
 			return NULL;
 
+		/* put back the instance and callback of the request, synchronous replies end here */
+		if (msg->requestId != 0 && ClientIPC::getInstance().resolveRequest(msg) == false)
+			return NULL;
+
 		/* this messages are response from server */
 		switch (msg->message)
 		{
@@ -127,6 +132,7 @@ namespace smartcard_service_api
 
 		/* ClientChannel requests */
 		case Message::MSG_REQUEST_TRANSMIT :
+		case Message::MSG_REQUEST_TRANSMIT_BATCH :
 		case Message::MSG_REQUEST_CLOSE_CHANNEL :
 			{
 				DispatcherMsg *tempMsg = new DispatcherMsg(msg);
@@ -155,6 +161,9 @@ namespace smartcard_service_api
 			{
 				map<void *, SEService *>::iterator item;
 
+				/* no reply will come, synchronous callers must not wait forever */
+				ClientIPC::getInstance().abortRequests();
+
 				for (item = mapSESerivces.begin(); item != mapSESerivces.end(); item++)
 				{
 					DispatcherMsg *tempMsg = new DispatcherMsg(msg);
@@ -30,6 +30,15 @@ namespace smartcard_service_api
 {
 	ClientIPC::ClientIPC():IPCHelper()
 	{
+		lastRequestId = 0;
+		syncTimeout = SYNC_TIMEOUT_DEFAULT;
+		requestCount = 0;
+		requests.resize(REQUEST_TABLE_SIZE);
+#ifdef USE_SHM_TRANSPORT
+		shm = NULL;
+		ringChannel = NULL;
+		ringWatchId = 0;
+#endif
 	}
 
 	ClientIPC::~ClientIPC()
@@ -43,10 +52,232 @@ namespace smartcard_service_api
 		return clientIPC;
 	}
 
+	void ClientIPC::insertRequest(const pending_request_t &request)
+	{
+		size_t mask, i;
+
+		if ((requestCount + 1) * 2 > requests.size())
+		{
+			vector<pending_request_t> old(requests.size() * 2);
+
+			/* rehash into the doubled table */
+			old.swap(requests);
+			requestCount = 0;
+
+			for (i = 0; i < old.size(); i++)
+			{
+				if (old[i].id != 0)
+					insertRequest(old[i]);
+			}
+		}
+
+		mask = requests.size() - 1;
+
+		for (i = request.id & mask; requests[i].id != 0; i = (i + 1) & mask);
+
+		requests[i] = request;
+		requestCount++;
+	}
+
+	size_t ClientIPC::findRequest(unsigned int id)
+	{
+		size_t mask = requests.size() - 1;
+		size_t i;
+
+		for (i = id & mask; requests[i].id != 0; i = (i + 1) & mask)
+		{
+			if (requests[i].id == id)
+				return i;
+		}
+
+		return requests.size();
+	}
+
+	void ClientIPC::eraseRequest(size_t index)
+	{
+		size_t mask = requests.size() - 1;
+		size_t i = index, j = index, home;
+
+		requests[i].id = 0;
+		requestCount--;
+
+		/* pull back the entries of the probe chain, no tombstones */
+		while (true)
+		{
+			j = (j + 1) & mask;
+			if (requests[j].id == 0)
+				break;
+
+			home = requests[j].id & mask;
+
+			if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j))
+			{
+				requests[i] = requests[j];
+				requests[j].id = 0;
+				i = j;
+			}
+		}
+	}
+
+	bool ClientIPC::sendRequest(Message *msg)
+	{
+		pending_request_t request;
+		unsigned int id;
+		bool result;
+
+		/* the daemon would drop the connection */
+		if (msg->data.getLength() > Message::getMaxDataLength(msg->message))
+		{
+			SCARD_DEBUG_ERR("request is too long, length [%d]", msg->data.getLength());
+
+			return false;
+		}
+
+		/* 0 is reserved for notifications */
+		while ((id = __sync_add_and_fetch(&lastRequestId, 1)) == 0);
+
+		request.id = id;
+		request.caller = msg->caller;
+		request.callback = msg->callback;
+		request.userParam = msg->userParam;
+
+		/* registered first, the reply may be read before sendMessage returns */
+		SCOPE_LOCK(requestLock)
+		{
+			insertRequest(request);
+		}
+
+		msg->requestId = id;
+
+		if ((result = sendMessage(msg)) == false)
+		{
+			SCARD_DEBUG_ERR("send failed, request [%u]", id);
+
+			cancelRequest(id);
+		}
+
+		return result;
+	}
+
+	int ClientIPC::sendRequestSync(Message *msg, Future *future, int timeout)
+	{
+		int result;
+
+		/* if callback is class instance, it means synchronized call */
+		msg->callback = msg->caller;
+		msg->userParam = future;
+
+		if (sendRequest(msg) == false)
+			return Future::WAIT_CANCELLED;
+
+		if (timeout < 0)
+			timeout = syncTimeout;
+
+		result = future->wait(timeout);
+		if (result == Future::WAIT_TIMEOUT)
+		{
+			if (cancelRequest(msg->requestId) == true)
+			{
+				SCARD_DEBUG_ERR("request [%u] timed out, [%d] ms", msg->requestId, timeout);
+			}
+			else
+			{
+				/* completed under requestLock while we were timing out */
+				result = future->wait(0);
+			}
+		}
+
+		return result;
+	}
+
+	bool ClientIPC::resolveRequest(Message *msg)
+	{
+		bool result = false;
+		size_t index;
+
+		SCOPE_LOCK(requestLock)
+		{
+			if ((index = findRequest(msg->requestId)) < requests.size())
+			{
+				pending_request_t &request = requests[index];
+
+				if (request.callback == request.caller)
+				{
+					/* synchronized call, completed here so a timed out waiter never sees it late */
+					((Future *)request.userParam)->complete(msg);
+				}
+				else
+				{
+					msg->caller = request.caller;
+					msg->callback = request.callback;
+					msg->userParam = request.userParam;
+
+					result = true;
+				}
+
+				eraseRequest(index);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("unknown request [%u]", msg->requestId);
+			}
+		}
+
+		return result;
+	}
+
+	bool ClientIPC::cancelRequest(unsigned int id)
+	{
+		bool result = false;
+		size_t index;
+
+		SCOPE_LOCK(requestLock)
+		{
+			if ((index = findRequest(id)) < requests.size())
+			{
+				eraseRequest(index);
+				result = true;
+			}
+		}
+
+		return result;
+	}
+
+	void ClientIPC::abortRequests()
+	{
+		size_t i;
+
+		SCOPE_LOCK(requestLock)
+		{
+			for (i = 0; i < requests.size(); i++)
+			{
+				if (requests[i].id == 0)
+					continue;
+
+				if (requests[i].callback == requests[i].caller)
+				{
+					/* synchronized call, release the waiter */
+					((Future *)requests[i].userParam)->cancel();
+				}
+				else
+				{
+					SCARD_DEBUG_ERR("request [%u] is dropped", requests[i].id);
+				}
+
+				requests[i].id = 0;
+			}
+
+			requestCount = 0;
+		}
+	}
+
 	int ClientIPC::handleIOErrorCondition(void *channel, GIOCondition condition)
 	{
 		SCARD_BEGIN();
 
+#ifdef USE_SHM_TRANSPORT
+		releaseTransport();
+#endif
 		/* finalize context */
 		if (watchId != 0)
 		{
@@ -101,32 +332,36 @@ namespace smartcard_service_api
 
 		if (channel == ioChannel)
 		{
-			Message *msg = NULL;
+			DispatcherMsg *dispMsg = new DispatcherMsg();
 
 			SCARD_DEBUG("message from server to client socket");
 
 			/* read message */
-			msg = retrieveMessage();
-			if (msg != NULL)
+			if (retrieveMessage(ipcSocket, dispMsg) == true)
 			{
-				DispatcherMsg *dispMsg = new DispatcherMsg(msg);
-
 				/* set peer socket */
 				dispMsg->setPeerSocket(ipcSocket);
 
 				/* push to dispatcher */
 				if (dispatcher != NULL)
 					dispatcher->pushMessage(dispMsg);
+				else
+					delete dispMsg;
 
 				result = TRUE;
 			}
 			else
 			{
 				/* clear client connection */
+				delete dispMsg;
 			}
-
-			delete msg;
 		}
+#ifdef USE_SHM_TRANSPORT
+		else if (channel == ringChannel)
+		{
+			result = handleRingEvent();
+		}
+#endif
 		else
 		{
 			SCARD_DEBUG_ERR("Unknown channel event [%p]", channel);
@@ -137,4 +372,141 @@ namespace smartcard_service_api
 		return result;
 	}
 
+#ifdef USE_SHM_TRANSPORT
+	void ClientIPC::negotiateTransport()
+	{
+		Message msg;
+		int fds[IPCSharedMemory::DESCRIPTOR_COUNT];
+
+		SCARD_BEGIN();
+
+		shm = new IPCSharedMemory();
+		if (shm == NULL || shm->create() == false)
+		{
+			SCARD_DEBUG_ERR("shared memory is not available, socket only");
+			goto ERROR;
+		}
+
+		/* ring is empty, the first response has to ring */
+		shm->prepareWait();
+		shm->getDescriptors(fds);
+
+		msg.message = Message::MSG_OPERATION_ATTACH_SHM;
+
+		/* nothing else is on the socket yet, so the reply is the next frame */
+		if (sendFrame(ipcSocket, &msg, fds, IPCSharedMemory::DESCRIPTOR_COUNT) == false ||
+			recvFrame(ipcSocket, &msg) == false ||
+			msg.message != (unsigned int)Message::MSG_OPERATION_ATTACH_SHM || msg.error != 0)
+		{
+			SCARD_DEBUG_ERR("server refused shared memory, socket only");
+			goto ERROR;
+		}
+
+		if ((ringChannel = g_io_channel_unix_new(shm->getReceiveDoorbell())) == NULL ||
+			(ringWatchId = g_io_add_watch(ringChannel, G_IO_IN, &IPCHelper::channelCallbackFunc, this)) < 1)
+		{
+			/* server already writes to the ring, keep the connection consistent by failing it */
+			SCARD_DEBUG_ERR("g_io_add_watch is failed");
+			shutdown(ipcSocket, SHUT_RDWR);
+			goto ERROR;
+		}
+
+		SCARD_DEBUG("shared memory transport is attached");
+
+		SCARD_END();
+
+		return;
+
+ERROR :
+		releaseTransport();
+
+		SCARD_END();
+	}
+
+	void ClientIPC::releaseTransport()
+	{
+		if (ringWatchId != 0)
+		{
+			g_source_remove(ringWatchId);
+			ringWatchId = 0;
+		}
+
+		if (ringChannel != NULL)
+		{
+			g_io_channel_unref(ringChannel);
+			ringChannel = NULL;
+		}
+
+		pthread_mutex_lock(&ipcLock);
+		if (shm != NULL)
+		{
+			delete shm;
+			shm = NULL;
+		}
+		pthread_mutex_unlock(&ipcLock);
+	}
+
+	int ClientIPC::handleRingEvent()
+	{
+		DispatcherMsg *dispMsg;
+		int ret;
+
+		shm->clearDoorbell();
+
+		do
+		{
+			dispMsg = new DispatcherMsg();
+
+			while ((ret = shm->receiveMessage(dispMsg)) > 0)
+			{
+				dispMsg->setPeerSocket(ipcSocket);
+
+				if (dispatcher != NULL)
+					dispatcher->pushMessage(dispMsg);
+				else
+					delete dispMsg;
+
+				dispMsg = new DispatcherMsg();
+			}
+
+			delete dispMsg;
+		}
+		while (ret == 0 && shm->prepareWait() == false);
+
+		if (ret < 0)
+		{
+			SCARD_DEBUG_ERR("response ring is corrupted");
+
+			/* socket error path finalizes everything */
+			shutdown(ipcSocket, SHUT_RDWR);
+		}
+
+		return TRUE;
+	}
+
+	bool ClientIPC::sendMessage(int socket, Message *msg)
+	{
+		bool result = false;
+		int ret = 1;
+
+		pthread_mutex_lock(&ipcLock);
+		if (shm != NULL && socket == ipcSocket)
+		{
+			ret = shm->sendMessage(msg);
+		}
+
+		if (ret == 0)
+		{
+			result = true;
+		}
+		else if (ret > 0)
+		{
+			result = sendFrame(socket, msg);
+		}
+		pthread_mutex_unlock(&ipcLock);
+
+		return result;
+	}
+#endif
+
 } /* namespace open_mobile_api */
@@ -28,7 +28,6 @@
 #include "ClientIPC.h"
 #include "Reader.h"
 #include "Session.h"
-#include "SignatureHelper.h"
 
 #ifndef EXTERN_API
 #define EXTERN_API __attribute__((visibility("default")))
@@ -59,8 +58,6 @@ namespace smartcard_service_api
 		length = (length < sizeof(this->name)) ? length : sizeof(this->name);
 		memcpy(this->name, name, length);
 
-		getPackageCert();
-
 		SCARD_END();
 	}
 
@@ -81,30 +78,25 @@ namespace smartcard_service_api
 		sessions.clear();
 	}
 
-	void Reader::getPackageCert()
+	SessionHelper *Reader::openSessionSync()
 	{
-		packageCert = SignatureHelper::getCertificationHash(getpid());
+		return openSessionSync(-1);
 	}
 
-	SessionHelper *Reader::openSessionSync()
+	SessionHelper *Reader::openSessionSync(int timeout)
 	{
 		Message msg;
+		Future future;
+		Session *session = NULL;
 		int rv;
 
 		/* request channel handle from server */
 		msg.message = Message::MSG_REQUEST_OPEN_SESSION;
 		msg.param1 = (unsigned int)handle;
-		msg.data = packageCert;
 		msg.error = (unsigned int)context; /* using error to context */
 		msg.caller = (void *)this;
-		msg.callback = (void *)this; /* if callback is class instance, it means synchronized call */
-
-		ClientIPC::getInstance().sendMessage(&msg);
-
-		syncLock();
-		rv = waitTimedCondition(0);
-		syncUnlock();
 
+		rv = ClientIPC::getInstance().sendRequestSync(&msg, &future, timeout);
 		if (rv != 0)
 		{
 			SCARD_DEBUG_ERR("time over");
@@ -112,7 +104,21 @@ namespace smartcard_service_api
 			return NULL;
 		}
 
-		return (Session *)openedSession;
+		/* the instance is made by the waiter */
+		if (future.param1 != 0)
+		{
+			session = new Session(context, this, (void *)future.param1);
+			if (session != NULL)
+			{
+				sessions.push_back(session);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("Session creating instance failed");
+			}
+		}
+
+		return session;
 	}
 
 	int Reader::openSession(openSessionCallback callback, void *userData)
@@ -122,13 +128,12 @@ namespace smartcard_service_api
 		/* request channel handle from server */
 		msg.message = Message::MSG_REQUEST_OPEN_SESSION;
 		msg.param1 = (unsigned int)handle;
-		msg.data = packageCert;
 		msg.error = (unsigned int)context; /* using error to context */
 		msg.caller = (void *)this;
 		msg.callback = (void *)callback;
 		msg.userParam = userData;
 
-		ClientIPC::getInstance().sendMessage(&msg);
+		ClientIPC::getInstance().sendRequest(&msg);
 
 		return 0;
 	}
@@ -161,29 +166,19 @@ namespace smartcard_service_api
 				{
 					/* create new instance of channel */
 					session = new Session(reader->context, reader, (void *)msg->param1);
-					if (session == NULL)
+					if (session != NULL)
+					{
+						reader->sessions.push_back(session);
+					}
+					else
 					{
 						SCARD_DEBUG_ERR("Session creating instance failed");
 
-						return session;
+						msg->error = -1;
 					}
-
-					reader->sessions.push_back(session);
 				}
 
-				if (msg->callback == (void *)reader) /* synchronized call */
-				{
-					/* sync call */
-					reader->syncLock();
-
-					/* copy result */
-					reader->error = msg->error;
-					reader->openedSession = session;
-					reader->signalCondition();
-
-					reader->syncUnlock();
-				}
-				else if (msg->callback != NULL)
+				if (msg->callback != NULL)
 				{
 					openSessionCallback cb = (openSessionCallback)msg->callback;
 
@@ -29,6 +29,7 @@
 #include "SEService.h"
 #include "Reader.h"
 #include "Message.h"
+#include "SignatureHelper.h"
 
 #ifndef EXTERN_API
 #define EXTERN_API __attribute__((visibility("default")))
@@ -36,6 +37,32 @@
 
 namespace smartcard_service_api
 {
+	pthread_once_t SEService::certHashOnce = PTHREAD_ONCE_INIT;
+	ByteArray SEService::certHash;
+
+	PMutex SEService::readersLock;
+	ByteArray SEService::readersInfo;
+	unsigned int SEService::readersCount = 0;
+	unsigned int SEService::readersVersion = 0;
+	bool SEService::readersValid = false;
+
+	void SEService::loadCertificationHash()
+	{
+		/* package database and hashing are touched once per process */
+		certHash = SignatureHelper::getCertificationHash(getpid());
+
+		SCARD_DEBUG("certification hash [%d]", certHash.getLength());
+	}
+
+	void SEService::invalidateReaders()
+	{
+		SCOPE_LOCK(readersLock)
+		{
+			/* snapshot is kept, a reply crossing the event may still refer to it */
+			readersValid = false;
+		}
+	}
+
 	SEService::SEService():SEServiceHelper()
 	{
 		pid = -1;
@@ -152,12 +179,22 @@ namespace smartcard_service_api
 			/* send message to load se */
 			Message msg;
 
+			pthread_once(&certHashOnce, &SEService::loadCertificationHash);
+
 			msg.message = Message::MSG_REQUEST_READERS;
+			msg.param1 = (unsigned int)context;
 			msg.error = pid; /* using error to pid */
+			msg.data = certHash; /* kept by the daemon for the sessions of this client */
+
+			/* daemon replies without data if this snapshot is still current */
+			SCOPE_LOCK(readersLock)
+			{
+				msg.param2 = readersValid ? readersVersion : 0;
+			}
 			msg.caller = (void *)this;
 			msg.userParam = context;
 
-			result = clientIPC->sendMessage(&msg);
+			result = clientIPC->sendRequest(&msg);
 		}
 
 		SCARD_END();
@@ -252,8 +289,32 @@ namespace smartcard_service_api
 		case Message::MSG_REQUEST_READERS :
 			SCARD_DEBUG("[MSG_REQUEST_READERS]");
 
-			/* parse message data */
-			service->parseReaderInformation(msg->param1, msg->data);
+			if (msg->error == 0)
+			{
+				SCOPE_LOCK(readersLock)
+				{
+					if (msg->data.isEmpty() == true && msg->param2 == readersVersion)
+					{
+						SCARD_DEBUG("readers unchanged, version [%u]", readersVersion);
+					}
+					else
+					{
+						readersInfo = msg->data;
+						readersCount = msg->param1;
+						readersVersion = msg->param2;
+					}
+
+					readersValid = true;
+
+					/* parse message data */
+					service->parseReaderInformation(readersCount, readersInfo);
+				}
+			}
+			else
+			{
+				/* parse message data */
+				service->parseReaderInformation(msg->param1, msg->data);
+			}
 
 			/* call callback function */
 			if (service->listener != NULL)
@@ -269,6 +330,8 @@ namespace smartcard_service_api
 		case Message::MSG_NOTIFY_SE_INSERTED :
 			SCARD_DEBUG("[MSG_NOTIFY_SE_INSERTED]");
 
+			invalidateReaders();
+
 			if (service->listener != NULL)
 			{
 				service->listener->eventHandler(service, (char *)msg->data.getBuffer(), 1, service->context);
@@ -282,6 +345,8 @@ namespace smartcard_service_api
 		case Message::MSG_NOTIFY_SE_REMOVED :
 			SCARD_DEBUG("[MSG_NOTIFY_SE_REMOVED]");
 
+			invalidateReaders();
+
 			if (service->listener != NULL)
 			{
 				service->listener->eventHandler(service, (char *)msg->data.getBuffer(), 2, service->context);
@@ -295,6 +360,9 @@ namespace smartcard_service_api
 		case Message::MSG_OPERATION_RELEASE_CLIENT :
 			SCARD_DEBUG("[MSG_OPERATION_RELEASE_CLIENT]");
 
+			/* next daemon has its own snapshots */
+			invalidateReaders();
+
 			if (service->listener != NULL)
 			{
 				service->listener->errorHandler(service, msg->error, service->context);
@@ -405,3 +473,15 @@ EXTERN_API void se_service_destroy_instance(se_service_h handle)
 	delete service;
 	SE_SERVICE_EXTERN_END;
 }
+
+EXTERN_API void se_service_set_sync_timeout(int timeout)
+{
+	if (timeout >= 0)
+	{
+		ClientIPC::getInstance().setSyncTimeout(timeout);
+	}
+	else
+	{
+		SCARD_DEBUG_ERR("Invalid param");
+	}
+}
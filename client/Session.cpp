@@ -55,21 +55,46 @@ namespace smartcard_service_api
 		close(NULL, this);
 	}
 
-	void Session::closeChannels()
+	void Session::detachChannels()
 	{
 		size_t i;
 
+		/* server side channels are closed by the request of the caller */
 		for (i = 0; i < channels.size(); i++)
 		{
-			channels[i]->close(NULL, this);
+			((ClientChannel *)channels[i])->channelNum = -1;
 		}
 
 		channels.clear();
 	}
 
+	void Session::closeChannels()
+	{
+		Message msg;
+
+		if (channels.size() == 0)
+			return;
+
+		detachChannels();
+
+		/* one request, the server closes all channels of the session in one go */
+		msg.message = Message::MSG_REQUEST_CLOSE_CHANNELS;
+		msg.param1 = (unsigned int)handle;
+		msg.error = (unsigned int)context; /* using error to context */
+		msg.caller = (void *)this;
+
+		ClientIPC::getInstance().sendRequest(&msg);
+	}
+
 	ByteArray Session::getATRSync()
+	{
+		return getATRSync(-1);
+	}
+
+	ByteArray Session::getATRSync(int timeout)
 	{
 		Message msg;
+		Future future;
 		int rv;
 
 		/* request channel handle from server */
@@ -77,20 +102,18 @@ namespace smartcard_service_api
 		msg.param1 = (unsigned int)handle;
 		msg.error = (unsigned int)context; /* using error to context */
 		msg.caller = (void *)this;
-		msg.callback = (void *)this; /* if callback is class instance, it means synchronized call */
-
-		ClientIPC::getInstance().sendMessage(&msg);
-
-		syncLock();
-		rv = waitTimedCondition(0);
-		syncUnlock();
 
+		rv = ClientIPC::getInstance().sendRequestSync(&msg, &future, timeout);
 		if (rv != 0)
 		{
 			SCARD_DEBUG_ERR("time over");
 
 			atr.releaseBuffer();
 		}
+		else
+		{
+			atr = future.data;
+		}
 
 		return atr;
 	}
@@ -107,34 +130,36 @@ namespace smartcard_service_api
 		msg.callback = (void *)callback;
 		msg.userParam = userData;
 
-		ClientIPC::getInstance().sendMessage(&msg);
+		ClientIPC::getInstance().sendRequest(&msg);
 
 		return 0;
 	}
 
 	void Session::closeSync()
+	{
+		closeSync(-1);
+	}
+
+	void Session::closeSync(int timeout)
 	{
 		Message msg;
+		Future future;
 		int rv;
 
 		if (isClosed() == false)
 		{
 			closed = true;
-			closeChannels();
+
+			/* channels are closed with the session on server */
+			detachChannels();
 
 			/* request channel handle from server */
 			msg.message = Message::MSG_REQUEST_CLOSE_SESSION;
 			msg.param1 = (unsigned int)handle;
 			msg.error = (unsigned int)context; /* using error to context */
 			msg.caller = (void *)this;
-			msg.callback = (void *)this; /* if callback is class instance, it means synchronized call */
-
-			ClientIPC::getInstance().sendMessage(&msg);
-
-			syncLock();
-			rv = waitTimedCondition(0);
-			syncUnlock();
 
+			rv = ClientIPC::getInstance().sendRequestSync(&msg, &future, timeout);
 			if (rv != 0)
 			{
 				SCARD_DEBUG_ERR("time over");
@@ -149,7 +174,9 @@ namespace smartcard_service_api
 		if (isClosed() == false)
 		{
 			closed = true;
-			closeChannels();
+
+			/* channels are closed with the session on server */
+			detachChannels();
 
 			/* request channel handle from server */
 			msg.message = Message::MSG_REQUEST_CLOSE_SESSION;
@@ -159,7 +186,7 @@ namespace smartcard_service_api
 			msg.callback = (void *)callback;
 			msg.userParam = userData;
 
-			ClientIPC::getInstance().sendMessage(&msg);
+			ClientIPC::getInstance().sendRequest(&msg);
 		}
 
 		return 0;
@@ -176,14 +203,20 @@ namespace smartcard_service_api
 		msg.callback = (void *)callback;
 		msg.userParam = userData;
 
-		ClientIPC::getInstance().sendMessage(&msg);
+		ClientIPC::getInstance().sendRequest(&msg);
 
 		return 0;
 	}
 
 	unsigned int Session::getChannelCountSync()
+	{
+		return getChannelCountSync(-1);
+	}
+
+	unsigned int Session::getChannelCountSync(int timeout)
 	{
 		Message msg;
+		Future future;
 		int rv;
 
 		/* request channel handle from server */
@@ -191,14 +224,8 @@ namespace smartcard_service_api
 		msg.param1 = (unsigned int)handle;
 		msg.error = (unsigned int)context; /* using error to context */
 		msg.caller = (void *)this;
-		msg.callback = (void *)this; /* if callback is class instance, it means synchronized call */
-
-		ClientIPC::getInstance().sendMessage(&msg);
-
-		syncLock();
-		rv = waitTimedCondition(0);
-		syncUnlock();
 
+		rv = ClientIPC::getInstance().sendRequestSync(&msg, &future, timeout);
 		if (rv != 0)
 		{
 			SCARD_DEBUG_ERR("time over");
@@ -206,12 +233,14 @@ namespace smartcard_service_api
 			return -1;
 		}
 
-		return channelCount;
+		return future.param1;
 	}
 
-	Channel *Session::openChannelSync(int id, ByteArray aid)
+	Channel *Session::openChannelSync(int id, ByteArray aid, int timeout)
 	{
 		Message msg;
+		Future future;
+		ClientChannel *channel = NULL;
 		int rv;
 
 		/* request channel handle from server */
@@ -221,14 +250,8 @@ namespace smartcard_service_api
 		msg.data = aid;
 		msg.error = (unsigned int)context; /* using error to context */
 		msg.caller = (void *)this;
-		msg.callback = (void *)this; /* if callback is class instance, it means synchronized call */
-
-		ClientIPC::getInstance().sendMessage(&msg);
-
-		syncLock();
-		rv = waitTimedCondition(0);
-		syncUnlock();
 
+		rv = ClientIPC::getInstance().sendRequestSync(&msg, &future, timeout);
 		if (rv != 0)
 		{
 			SCARD_DEBUG_ERR("time over");
@@ -236,7 +259,21 @@ namespace smartcard_service_api
 			return NULL;
 		}
 
-		return (Channel *)openedChannel;
+		/* reply carries handle and channel number, the instance is made by the waiter */
+		if (future.param1 != 0)
+		{
+			channel = new ClientChannel(context, this, future.param2, future.data, (void *)future.param1);
+			if (channel != NULL)
+			{
+				channels.push_back(channel);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("alloc failed");
+			}
+		}
+
+		return (Channel *)channel;
 	}
 
 	int Session::openChannel(int id, ByteArray aid, openChannelCallback callback, void *userData)
@@ -253,14 +290,19 @@ namespace smartcard_service_api
 		msg.callback = (void *)callback;
 		msg.userParam = userData;
 
-		ClientIPC::getInstance().sendMessage(&msg);
+		ClientIPC::getInstance().sendRequest(&msg);
 
 		return 0;
 	}
 
 	Channel *Session::openBasicChannelSync(ByteArray aid)
 	{
-		return openChannelSync(0, aid);
+		return openChannelSync(0, aid, -1);
+	}
+
+	Channel *Session::openBasicChannelSync(ByteArray aid, int timeout)
+	{
+		return openChannelSync(0, aid, timeout);
 	}
 
 	Channel *Session::openBasicChannelSync(unsigned char *aid, unsigned int length)
@@ -280,7 +322,12 @@ namespace smartcard_service_api
 
 	Channel *Session::openLogicalChannelSync(ByteArray aid)
 	{
-		return openChannelSync(1, aid);
+		return openChannelSync(1, aid, -1);
+	}
+
+	Channel *Session::openLogicalChannelSync(ByteArray aid, int timeout)
+	{
+		return openChannelSync(1, aid, timeout);
 	}
 
 	Channel *Session::openLogicalChannelSync(unsigned char *aid, unsigned int length)
@@ -336,19 +383,7 @@ namespace smartcard_service_api
 					}
 				}
 
-				if (msg->callback == (void *)session) /* synchronized call */
-				{
-					/* sync call */
-					session->syncLock();
-
-					/* copy result */
-					session->error = msg->error;
-					session->openedChannel = channel;
-
-					session->signalCondition();
-					session->syncUnlock();
-				}
-				else if (msg->callback != NULL)
+				if (msg->callback != NULL)
 				{
 					openChannelCallback cb = (openChannelCallback)msg->callback;
 
@@ -362,18 +397,7 @@ namespace smartcard_service_api
 			{
 				SCARD_DEBUG("MSG_REQUEST_GET_ATR");
 
-				if (msg->callback == (void *)session) /* synchronized call */
-				{
-					/* sync call */
-					session->syncLock();
-
-					session->error = msg->error;
-					session->atr = msg->data;
-
-					session->signalCondition();
-					session->syncUnlock();
-				}
-				else if (msg->callback != NULL)
+				if (msg->callback != NULL)
 				{
 					getATRCallback cb = (getATRCallback)msg->callback;
 
@@ -387,17 +411,7 @@ namespace smartcard_service_api
 			{
 				SCARD_DEBUG("MSG_REQUEST_CLOSE_SESSION");
 
-				if (msg->callback == (void *)session) /* synchronized call */
-				{
-					/* sync call */
-					session->syncLock();
-
-					session->error = msg->error;
-
-					session->signalCondition();
-					session->syncUnlock();
-				}
-				else if (msg->callback != NULL)
+				if (msg->callback != NULL)
 				{
 					closeSessionCallback cb = (closeSessionCallback)msg->callback;
 
@@ -411,18 +425,7 @@ namespace smartcard_service_api
 			{
 				SCARD_DEBUG("MSG_REQUEST_GET_CHANNEL_COUNT");
 
-				if (msg->callback == (void *)session) /* synchronized call */
-				{
-					/* sync call */
-					session->syncLock();
-
-					session->error = msg->error;
-					session->channelCount = msg->param1;
-
-					session->signalCondition();
-					session->syncUnlock();
-				}
-				else if (msg->callback != NULL)
+				if (msg->callback != NULL)
 				{
 					getChannelCountCallback cb = (getChannelCountCallback)msg->callback;
 
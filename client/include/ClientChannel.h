@@ -25,6 +25,8 @@
 /* local header */
 #include "smartcard-types.h"
 #ifdef __cplusplus
+#include <vector>
+
 #include "Channel.h"
 #include "Session.h"
 #endif /* __cplusplus */
@@ -35,24 +37,46 @@ namespace smartcard_service_api
 	class ClientChannel: public Channel
 	{
 	private:
+		/* user callback of an async transmit which wants the chained count */
+		typedef struct _chained_context_t
+		{
+			transmitChainedCallback callback;
+			void *userParam;
+		}
+		chained_context_t;
+
 		void *context;
 		void *handle;
-		/* temporary data for sync function */
-		int error;
-		ByteArray response;
+		bool autoGetResponse;
 
 		ClientChannel(void *context, Session *session, int channelNum, ByteArray selectResponse, void *handle);
 
 		static bool dispatcherCallback(void *message);
+		static void chainedCallback(unsigned char *buffer, unsigned int length, int error, void *userParam);
 
 		void closeSync();
-		int transmitSync(ByteArray command, ByteArray &result);
+		int transmitSync(const ByteArray &command, ByteArray &result);
+		/* one round trip to the daemon for all commands */
+		int transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results);
 
 	public:
 		~ClientChannel();
 
+		/* timeout in ms, 0 waits forever, negative uses the default of the process */
+		void closeSync(int timeout);
+		int transmitSync(const ByteArray &command, ByteArray &result, int timeout);
+		/* chainedCount is given per request, other requests on the channel may run meanwhile */
+		int transmitSync(const ByteArray &command, ByteArray &result, int timeout, unsigned int &chainedCount);
+		int transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results, unsigned int &chainedCount);
+
 		int close(closeCallback callback, void *userParam);
-		int transmit(ByteArray command, transmitCallback callback, void *userParam);
+		int transmit(const ByteArray &command, transmitCallback callback, void *userParam);
+		int transmit(const ByteArray &command, transmitChainedCallback callback, void *userParam);
+		/* up to Message::MAX_BATCH_COUNT commands, -1 for more */
+		int transmitBatch(vector<ByteArray> &commands, bool stopOnError, transmitBatchCallback callback, void *userParam);
+
+		/* 61xx and 6Cxx are completed by the daemon, responses come in one piece */
+		inline void setAutoGetResponse(bool enable) { autoGetResponse = enable; }
 
 		friend class ClientDispatcher;
 		friend class Session;
@@ -69,8 +93,11 @@ extern "C"
 
 int channel_close(channel_h handle, channel_close_cb callback, void *userParam);
 int channel_transmit(channel_h handle, unsigned char *command, unsigned int length, channel_transmit_cb callback, void *userParam);
+int channel_transmit_chained(channel_h handle, unsigned char *command, unsigned int length, channel_transmit_chained_cb callback, void *userParam);
+int channel_transmit_batch(channel_h handle, unsigned char **commands, unsigned int *lengths, unsigned int count, bool stopOnError, channel_transmit_batch_cb callback, void *userParam);
 bool channel_is_basic_channel(channel_h handle);
 bool channel_is_closed(channel_h handle);
+void channel_set_auto_get_response(channel_h handle, bool enable);
 
 unsigned int channel_get_select_response_length(channel_h handle);
 bool channel_get_select_response(channel_h handle, unsigned char *buffer, unsigned int length);
@@ -18,18 +18,58 @@
 #define CLIENTIPC_H_
 
 /* standard library header */
+#include <vector>
 
 /* SLP library header */
 
 /* local header */
 #include "IPCHelper.h"
+#include "Lock.h"
+#include "Future.h"
 #include "SEServiceListener.h"
+#ifdef USE_SHM_TRANSPORT
+#include "IPCSharedMemory.h"
+#endif
+
+using namespace std;
 
 namespace smartcard_service_api
 {
+	/* what a reply is matched back to, the wire carries only the request id */
+	typedef struct _pending_request_t
+	{
+		unsigned int id; /* 0 : empty slot */
+		void *caller;
+		void *callback;
+		void *userParam;
+	} pending_request_t;
+
 	class ClientIPC: public IPCHelper
 	{
 	private:
+		static const size_t REQUEST_TABLE_SIZE = 64; /* grows, never shrinks */
+		static const int SYNC_TIMEOUT_DEFAULT = 30000; /* ms */
+
+		unsigned int lastRequestId;
+		int syncTimeout;
+		PMutex requestLock;
+		/* open addressing on the id, no allocation per request */
+		vector<pending_request_t> requests;
+		size_t requestCount;
+
+		void insertRequest(const pending_request_t &request);
+		size_t findRequest(unsigned int id);
+		void eraseRequest(size_t index);
+
+#ifdef USE_SHM_TRANSPORT
+		IPCSharedMemory *shm;
+		GIOChannel *ringChannel;
+		unsigned int ringWatchId;
+
+		void negotiateTransport();
+		void releaseTransport();
+		int handleRingEvent();
+#endif
 		ClientIPC();
 		~ClientIPC();
 
@@ -39,6 +79,22 @@ namespace smartcard_service_api
 
 	public:
 		static ClientIPC &getInstance();
+
+		bool sendRequest(Message *msg);
+		/* timeout in ms, 0 waits forever, negative uses the default */
+		int sendRequestSync(Message *msg, Future *future, int timeout);
+		/* false if the reply is consumed by a synchronous waiter or is unknown */
+		bool resolveRequest(Message *msg);
+		bool cancelRequest(unsigned int id);
+		void abortRequests();
+
+		inline void setSyncTimeout(int timeout) { syncTimeout = timeout; }
+		inline int getSyncTimeout() const { return syncTimeout; }
+
+#ifdef USE_SHM_TRANSPORT
+		using IPCHelper::sendMessage;
+		bool sendMessage(int socket, Message *msg);
+#endif
 	};
 
 } /* namespace open_mobile_api */
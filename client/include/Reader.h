@@ -37,20 +37,18 @@ namespace smartcard_service_api
 	private:
 		void *context;
 		void *handle;
-		ByteArray packageCert;
-		/* temporary data for sync function */
-		int error;
-		Session *openedSession;
 
 		Reader(void *context, char *name, void *handle);
 
 		SessionHelper *openSessionSync();
 		static bool dispatcherCallback(void *message);
-		void getPackageCert();
 
 	public:
 		~Reader();
 
+		/* timeout in ms, 0 waits forever, negative uses the default of the process */
+		SessionHelper *openSessionSync(int timeout);
+
 		int openSession(openSessionCallback callback, void *userData);
 		void closeSessions();
 
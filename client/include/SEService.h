@@ -19,6 +19,7 @@
 #define SESERVICE_H_
 
 /* standard library header */
+#include <pthread.h>
 
 /* SLP library header */
 
@@ -27,6 +28,7 @@
 #ifdef __cplusplus
 #include "SEServiceListener.h"
 #include "SEServiceHelper.h"
+#include "Lock.h"
 #endif /* __cplusplus */
 
 #ifdef __cplusplus
@@ -46,7 +48,19 @@ namespace smartcard_service_api
 
 		SEService();
 
+		static pthread_once_t certHashOnce;
+		static ByteArray certHash;
+
+		/* last readers snapshot of the daemon, shared by the services of this process */
+		static PMutex readersLock;
+		static ByteArray readersInfo;
+		static unsigned int readersCount;
+		static unsigned int readersVersion;
+		static bool readersValid; /* false after se events, the version is not offered */
+
 		static bool dispatcherCallback(void *message);
+		static void loadCertificationHash();
+		static void invalidateReaders();
 		bool parseReaderInformation(unsigned int count, ByteArray data);
 
 		bool _initialize();
@@ -80,6 +94,8 @@ bool se_service_get_readers(se_service_h handle, reader_h *readers, int count);
 bool se_service_is_connected(se_service_h handle);
 void se_service_shutdown(se_service_h handle);
 void se_service_destroy_instance(se_service_h handle);
+/* default timeout of synchronous calls in ms, 0 waits forever */
+void se_service_set_sync_timeout(int timeout);
 
 #ifdef __cplusplus
 }
@@ -38,17 +38,14 @@ namespace smartcard_service_api
 	private:
 		void *context;
 		void *handle;
-		/* temporary data for sync function */
-		int error;
-		Channel *openedChannel;
-		unsigned int channelCount;
 
 		Session(void *context, Reader *reader, void *handle);
 
 		int openChannel(int id, ByteArray aid, openChannelCallback callback, void *userData);
 		static bool dispatcherCallback(void *message);
+		void detachChannels();
 
-		Channel *openChannelSync(int id, ByteArray aid);
+		Channel *openChannelSync(int id, ByteArray aid, int timeout);
 
 		ByteArray getATRSync();
 		void closeSync();
@@ -62,6 +59,13 @@ namespace smartcard_service_api
 	public:
 		~Session();
 
+		/* timeout in ms, 0 waits forever, negative uses the default of the process */
+		ByteArray getATRSync(int timeout);
+		void closeSync(int timeout);
+		Channel *openBasicChannelSync(ByteArray aid, int timeout);
+		Channel *openLogicalChannelSync(ByteArray aid, int timeout);
+		unsigned int getChannelCountSync(int timeout);
+
 		int getATR(getATRCallback callback, void *userData);
 		int close(closeSessionCallback callback, void *userData);
 
@@ -194,7 +194,7 @@ namespace smartcard_service_api
 	{
 	}
 
-	bool APDUCommand::setCommand(unsigned char cla, unsigned char ins, unsigned char p1, unsigned char p2, ByteArray commandData, unsigned int maxResponseSize)
+	bool APDUCommand::setCommand(unsigned char cla, unsigned char ins, unsigned char p1, unsigned char p2, const ByteArray &commandData, unsigned int maxResponseSize)
 	{
 		setCLA(cla);
 		setINS(ins);
@@ -208,9 +208,10 @@ namespace smartcard_service_api
 
 	bool APDUCommand::setCommand(const ByteArray &command)
 	{
-		bool result = false;
 		uint32_t offset = 0;
-		uint32_t lengthSize = 1;
+		uint32_t body;
+		uint32_t lc = 0;
+		uint32_t le = 0;
 
 		if (command.getLength() < sizeof(header))
 		{
@@ -220,55 +221,80 @@ namespace smartcard_service_api
 		memcpy(&header, command.getBuffer(offset), sizeof(header));
 		offset += sizeof(header);
 
-		if (isExtendedLength)
+		body = command.getLength() - offset;
+		isExtendedLength = (body >= 3 && command.getAt(offset) == 0);
+
+		if (body == 0)
 		{
-			lengthSize = 2;
+			/* case 1 */
 		}
-
-		if (command.getLength() - offset > lengthSize)
+		else if (isExtendedLength == false)
 		{
-			unsigned int length = 0;
-
-			/* data exist */
-			if (isExtendedLength)
+			if (body == 1)
 			{
-				/* TODO */
-				offset += 2;
+				/* case 2 */
+				le = command.getAt(offset);
+				le = (le == 0) ? 256 : le;
 			}
 			else
 			{
-				length = command.getAt(offset);
+				/* case 3, 4 */
+				lc = command.getAt(offset);
 				offset += 1;
-			}
 
-			setCommandData(ByteArray(command.getBuffer(offset), length));
-			offset += length;
-		}
+				if (body == 2 + lc)
+				{
+					le = command.getAt(command.getLength() - 1);
+					le = (le == 0) ? 256 : le;
+				}
+				else if (body != 1 + lc)
+				{
+					SCARD_DEBUG_ERR("command stream is not correct, length [%d], lc [%d]", command.getLength(), lc);
 
-		if (command.getLength() - offset == lengthSize)
+					return false;
+				}
+			}
+		}
+		else
 		{
-			if (isExtendedLength)
+			if (body == 3)
 			{
-				/* TODO */
-				offset += 2;
+				/* case 2 extended */
+				le = (command.getAt(offset + 1) << 8) | command.getAt(offset + 2);
+				le = (le == 0) ? 65536 : le;
 			}
 			else
 			{
-				setMaxResponseSize(command.getAt(offset));
-				offset += 1;
+				/* case 3, 4 extended */
+				lc = (command.getAt(offset + 1) << 8) | command.getAt(offset + 2);
+				offset += 3;
+
+				if (lc > 0 && body == 5 + lc)
+				{
+					le = (command.getAt(command.getLength() - 2) << 8) | command.getAt(command.getLength() - 1);
+					le = (le == 0) ? 65536 : le;
+				}
+				else if (lc == 0 || body != 3 + lc)
+				{
+					SCARD_DEBUG_ERR("command stream is not correct, length [%d], lc [%d]", command.getLength(), lc);
+
+					return false;
+				}
 			}
 		}
 
-		if (command.getLength() == offset)
+		if (lc > 0)
 		{
-			result = true;
+			setCommandData(ByteArray(command.getBuffer(offset), lc));
 		}
 		else
 		{
-			SCARD_DEBUG_ERR("command stream is not correct, command.getLength() [%d], offset [%d]", command.getLength(), offset);
+			commandData.releaseBuffer();
 		}
 
-		return result;
+		setMaxResponseSize(le);
+
+		return true;
 	}
 
 	bool APDUCommand::setChannel(int type, int channelNum)
@@ -291,6 +317,17 @@ namespace smartcard_service_api
 
 					result = true;
 				}
+				else if (channelNum >= 4 && channelNum < 20)
+				{
+					unsigned char temp;
+
+					/* further interindustry class, chaining and secure messaging bits are kept */
+					temp = getCLA();
+					temp = 0x40 | ((temp & 0x0C) ? 0x20 : 0x00) | (temp & 0x10) | ((channelNum - 4) & 0x0F);
+					setCLA(temp);
+
+					result = true;
+				}
 				break;
 
 			default :
@@ -366,11 +403,21 @@ namespace smartcard_service_api
 		this->maxResponseSize = maxResponseSize;
 	}
 
-	unsigned int APDUCommand::setMaxResponseSize()
+	unsigned int APDUCommand::getMaxResponseSize()
 	{
 		return maxResponseSize;
 	}
 
+	unsigned int APDUCommand::setMaxResponseSize()
+	{
+		return getMaxResponseSize();
+	}
+
+	void APDUCommand::setExtendedLength(bool extended)
+	{
+		isExtendedLength = extended;
+	}
+
 	bool APDUCommand::getBuffer(ByteArray &array)
 	{
 		unsigned char *temp_buffer = NULL;
@@ -380,14 +427,18 @@ namespace smartcard_service_api
 		unsigned char le[3] = { 0, };
 		unsigned int le_len = 0;
 		unsigned int offset = 0;
+		bool extended;
 
 		/* */
 		temp_len += sizeof(header);
 
+		/* extended fields when asked or when short ones are too small */
+		extended = (isExtendedLength || commandData.getLength() > 255 || maxResponseSize > 256);
+
 		/* calculate lc length */
 		if (commandData.getLength() > 0)
 		{
-			if (isExtendedLength/*commandData.getLength() > 255*/)
+			if (extended)
 			{
 				lc[1] = (commandData.getLength() >> 8) & 0x000000FF;
 				lc[2] = commandData.getLength() & 0x000000FF;
@@ -407,22 +458,19 @@ namespace smartcard_service_api
 		/* add command data length */
 		temp_len += commandData.getLength();
 
-		/* calculate le length */
+		/* calculate le length, the maximum is encoded as zero */
 		if (maxResponseSize > 0)
 		{
-			if (isExtendedLength/*commandData.getLength() > 255*/)
+			if (extended)
 			{
 				if (maxResponseSize < 65536)
 				{
-					le[1] = (maxResponseSize >> 8) & 0x000000FF;
-					le[2] = maxResponseSize & 0x000000FF;
-
-					le_len = 3;
-				}
-				else if (maxResponseSize == 65536)
-				{
-					le_len = 2;
+					le[lc_len > 0 ? 0 : 1] = (maxResponseSize >> 8) & 0x000000FF;
+					le[lc_len > 0 ? 1 : 2] = maxResponseSize & 0x000000FF;
 				}
+
+				/* lc has the leading zero already */
+				le_len = (lc_len > 0) ? 2 : 3;
 			}
 			else
 			{
@@ -435,10 +483,12 @@ namespace smartcard_service_api
 
 		temp_len += le_len;
 
-		temp_buffer = new unsigned char[temp_len];
-		if (temp_buffer == NULL)
+		/* short commands are built in place, without a temporary buffer */
+		if (array.allocBuffer(temp_len) == false)
 			return false;
 
+		temp_buffer = array.getBuffer();
+
 		/* fill data */
 		offset = 0;
 
@@ -460,18 +510,118 @@ namespace smartcard_service_api
 			offset += le_len;
 		}
 
-		array.setBuffer(temp_buffer, temp_len);
-		delete []temp_buffer;
+		return true;
+	}
+
+	/* ATRHelper class */
+	bool ATRHelper::getHistoricalBytes(const ByteArray &atr, ByteArray &historical)
+	{
+		uint32_t offset = 2;
+		uint32_t count;
+		unsigned char y;
+
+		if (atr.getLength() < 2)
+		{
+			return false;
+		}
+
+		/* T0 has the presence of TA1..TD1 and the count of historical bytes */
+		y = atr[1] >> 4;
+		count = atr[1] & 0x0F;
+
+		while (offset <= atr.getLength())
+		{
+			offset += ((y & 0x01) ? 1 : 0) + ((y & 0x02) ? 1 : 0) + ((y & 0x04) ? 1 : 0);
+
+			if ((y & 0x08) == 0 || offset >= atr.getLength())
+			{
+				break;
+			}
+
+			y = atr[offset] >> 4;
+			offset++;
+		}
+
+		if (offset + count > atr.getLength())
+		{
+			SCARD_DEBUG_ERR("invalid atr : %s", atr.toString());
+
+			return false;
+		}
+
+		if (count > 0)
+		{
+			historical.setBuffer(atr.getBuffer(offset), count);
+		}
+		else
+		{
+			historical.releaseBuffer();
+		}
 
 		return true;
 	}
 
+	bool ATRHelper::isExtendedLengthSupported(const ByteArray &atr)
+	{
+		ByteArray historical;
+		uint32_t offset = 1;
+		uint32_t end;
+		unsigned char tag, length;
+
+		if (getHistoricalBytes(atr, historical) == false || historical.getLength() < 2)
+		{
+			return false;
+		}
+
+		/* compact-tlv objects, with three status bytes at the end for category 0x00 */
+		if (historical[0] == 0x80)
+		{
+			end = historical.getLength();
+		}
+		else if (historical[0] == 0x00 && historical.getLength() >= 4)
+		{
+			end = historical.getLength() - 3;
+		}
+		else
+		{
+			return false;
+		}
+
+		while (offset < end)
+		{
+			tag = historical[offset] >> 4;
+			length = historical[offset] & 0x0F;
+			offset++;
+
+			if (offset + length > end)
+			{
+				break;
+			}
+
+			/* card capabilities, third software function table */
+			if (tag == 0x07 && length >= 3)
+			{
+				return ((historical[offset + 2] & 0x40) != 0);
+			}
+
+			offset += length;
+		}
+
+		return false;
+	}
+
+	unsigned int ATRHelper::getMaxResponseSize(const ByteArray &atr)
+	{
+		return isExtendedLengthSupported(atr) ? 65536 : 256;
+	}
+
 	/* APDUHelper class */
-	ByteArray APDUHelper::generateAPDU(int command, int channel, ByteArray data)
+	ByteArray APDUHelper::generateAPDU(int command, int channel, const ByteArray &data)
 	{
 		ByteArray result;
 		APDUCommand apdu;
 
+		/* empty result if the channel can not be encoded */
 		switch (command)
 		{
 		case COMMAND_OPEN_LOGICAL_CHANNEL :
@@ -486,27 +636,42 @@ namespace smartcard_service_api
 
 		case COMMAND_SELECT_BY_ID :
 			apdu.setCommand(0, APDUCommand::INS_SELECT_FILE, APDUCommand::P1_SELECT_BY_ID, APDUCommand::P2_SELECT_GET_FCP, data, 0);
-			apdu.getBuffer(result);
+			if (channel == 0 || apdu.setChannel(0, channel) == true)
+			{
+				apdu.getBuffer(result);
+			}
 			break;
 
 		case COMMAND_SELECT_PARENT_DF :
 			apdu.setCommand(0, APDUCommand::INS_SELECT_FILE, APDUCommand::P1_SELECT_PARENT_DF, APDUCommand::P2_SELECT_GET_FCP, data, 0);
-			apdu.getBuffer(result);
+			if (channel == 0 || apdu.setChannel(0, channel) == true)
+			{
+				apdu.getBuffer(result);
+			}
 			break;
 
 		case COMMAND_SELECT_BY_DF_NAME :
 			apdu.setCommand(0, APDUCommand::INS_SELECT_FILE, APDUCommand::P1_SELECT_BY_DF_NAME, APDUCommand::P2_SELECT_GET_FCP, data, 0);
-			apdu.getBuffer(result);
+			if (channel == 0 || apdu.setChannel(0, channel) == true)
+			{
+				apdu.getBuffer(result);
+			}
 			break;
 
 		case COMMAND_SELECT_BY_PATH :
 			apdu.setCommand(0, APDUCommand::INS_SELECT_FILE, APDUCommand::P1_SELECT_BY_PATH, APDUCommand::P2_SELECT_GET_FCP, data, 0);
-			apdu.getBuffer(result);
+			if (channel == 0 || apdu.setChannel(0, channel) == true)
+			{
+				apdu.getBuffer(result);
+			}
 			break;
 
 		case COMMAND_SELECT_BY_PATH_FROM_CURRENT_DF :
 			apdu.setCommand(0, APDUCommand::INS_SELECT_FILE, APDUCommand::P1_SELECT_BY_PATH_FROM_CURRENT_DF, APDUCommand::P2_SELECT_GET_FCP, data, 0);
-			apdu.getBuffer(result);
+			if (channel == 0 || apdu.setChannel(0, channel) == true)
+			{
+				apdu.getBuffer(result);
+			}
 			break;
 
 		default :
@@ -45,7 +45,7 @@ namespace smartcard_service_api
 				{
 					if (tlv.getTag() == 0x04) /* OCTET STRING */
 					{
-						ByteArray apdu, mask, value;
+						ByteArray value;
 
 						value = tlv.getValue();
 
@@ -53,12 +53,10 @@ namespace smartcard_service_api
 
 						if (value.getLength() == 8) /* apdu 4 bytes + mask 4 bytes */
 						{
-							apdu.setBuffer(value.getBuffer(), 4);
-							mask.setBuffer(value.getBuffer(4), 4);
+							uint32_t mask = getHeader(value.getBuffer(4));
 
-							pair<ByteArray, ByteArray> newItem(apdu, mask);
-
-							mapApduFilters.insert(newItem);
+							apduFilters.push_back(getHeader(value.getBuffer()) & mask);
+							apduFilters.push_back(mask);
 						}
 						else
 						{
@@ -80,13 +78,50 @@ namespace smartcard_service_api
 		}
 	}
 
-	bool APDUAccessRule::isAuthorizedAccess(const ByteArray &command)
+	uint32_t APDUAccessRule::getHeader(const uint8_t *apdu)
+	{
+		return ((uint32_t)apdu[0] << 24) | ((uint32_t)apdu[1] << 16) |
+			((uint32_t)apdu[2] << 8) | (uint32_t)apdu[3];
+	}
+
+	bool APDUAccessRule::isAuthorizedAccess(const ByteArray &command) const
 	{
 		bool result = false;
 
-		if (mapApduFilters.size() > 0)
+		if (apduFilters.size() > 0)
 		{
-			/* TODO : search command and check validity */
+			uint32_t header;
+			uint8_t cla;
+			size_t i;
+
+			if (command.getLength() < 4)
+			{
+				return false;
+			}
+
+			header = getHeader(command.getBuffer());
+
+			/* filters are written for the basic channel, remove channel number from CLA */
+			cla = header >> 24;
+			if ((cla & 0xC0) == 0x40) /* further interindustry class, to first one */
+			{
+				cla = (cla & 0x10) | ((cla & 0x20) ? 0x08 : 0x00);
+			}
+			else if ((cla & 0x80) == 0) /* first interindustry class */
+			{
+				cla &= ~0x03;
+			}
+
+			header = (header & 0x00FFFFFF) | ((uint32_t)cla << 24);
+
+			for (i = 0; i < apduFilters.size(); i += 2)
+			{
+				if ((header & apduFilters[i + 1]) == apduFilters[i])
+				{
+					result = true;
+					break;
+				}
+			}
 		}
 		else
 		{
@@ -101,13 +136,13 @@ namespace smartcard_service_api
 	{
 		SCARD_DEBUG("  +-- APDU Access Rule");
 
-		if (mapApduFilters.size() > 0)
+		if (apduFilters.size() > 0)
 		{
-			map<ByteArray, ByteArray>::iterator iterMap;
+			size_t i;
 
-			for (iterMap = mapApduFilters.begin(); iterMap != mapApduFilters.end(); iterMap++)
+			for (i = 0; i < apduFilters.size(); i += 2)
 			{
-				SCARD_DEBUG("  +--- APDU : %s, Mask : %s", ((ByteArray)(iterMap->first)).toString(), iterMap->second.toString());
+				SCARD_DEBUG("  +--- APDU : %08X, Mask : %08X", apduFilters[i], apduFilters[i + 1]);
 			}
 		}
 		else
@@ -212,7 +247,7 @@ namespace smartcard_service_api
 		}
 	}
 
-	bool AccessCondition::isAuthorizedAccess(ByteArray &certHash)
+	bool AccessCondition::isAuthorizedAccess(const ByteArray &certHash)
 	{
 		bool result = false;
 
@@ -237,7 +272,7 @@ namespace smartcard_service_api
 		return result;
 	}
 
-	bool AccessCondition::isAuthorizedAPDUAccess(ByteArray &command)
+	bool AccessCondition::isAuthorizedAPDUAccess(const ByteArray &command)
 	{
 		bool result = false;
 
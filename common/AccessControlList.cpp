@@ -38,6 +38,8 @@ namespace smartcard_service_api
 	{
 		channel = NULL;
 		terminal = NULL;
+
+		initIndex();
 	}
 
 	AccessControlList::AccessControlList(Channel *channel)
@@ -45,6 +47,8 @@ namespace smartcard_service_api
 		channel = NULL;
 		terminal = NULL;
 
+		initIndex();
+
 		setChannel(channel);
 	}
 
@@ -53,6 +57,8 @@ namespace smartcard_service_api
 		channel = NULL;
 		terminal = NULL;
 
+		initIndex();
+
 		setTerminal(terminal);
 	}
 
@@ -83,12 +89,171 @@ namespace smartcard_service_api
 	void AccessControlList::releaseACL()
 	{
 		mapConditions.clear();
+
+		invalidateIndex();
 	}
 
-	bool AccessControlList::isAuthorizedAccess(ByteArray aid, ByteArray certHash)
+	void AccessControlList::initIndex()
+	{
+		unsigned int i;
+
+		indexMask = 0;
+		indexGeneration = 0;
+		generation = 1;
+
+		for (i = 0; i < DECISION_CACHE_SIZE; i++)
+		{
+			decisions[i].generation = 0;
+			decisions[i].permission = false;
+		}
+	}
+
+	void AccessControlList::invalidateIndex()
+	{
+		SCOPE_LOCK(indexLock)
+		{
+			/* generation 0 marks unused decision cache entries */
+			if (++generation == 0)
+				generation = 1;
+		}
+	}
+
+	unsigned int AccessControlList::hashKey(const ByteArray &aid, const ByteArray &certHash)
+	{
+		unsigned int key = 2166136261U; /* FNV-1a */
+		uint32_t i;
+
+		for (i = 0; i < aid.getLength(); i++)
+		{
+			key = (key ^ aid[i]) * 16777619U;
+		}
+
+		key = (key ^ aid.getLength()) * 16777619U;
+
+		for (i = 0; i < certHash.getLength(); i++)
+		{
+			key = (key ^ certHash[i]) * 16777619U;
+		}
+
+		return key;
+	}
+
+	void AccessControlList::insertIndex(const ByteArray &aid, const ByteArray &certHash, bool permission, const AccessCondition *condition)
+	{
+		unsigned int key = hashKey(aid, certHash);
+		unsigned int i;
+
+		for (i = key & indexMask; index[i].used == true; i = (i + 1) & indexMask)
+		{
+			if (index[i].key == key && index[i].aid == aid && index[i].certHash == certHash)
+			{
+				/* duplicated hash, keep first one */
+				return;
+			}
+		}
+
+		index[i].key = key;
+		index[i].used = true;
+		index[i].permission = permission;
+		index[i].aid = aid;
+		index[i].certHash = certHash;
+		index[i].condition = condition;
+	}
+
+	const AccessControlList::index_entry_t *AccessControlList::findIndex(const ByteArray &aid, const ByteArray &certHash) const
+	{
+		unsigned int key;
+		unsigned int i;
+
+		if (index.size() == 0)
+			return NULL;
+
+		key = hashKey(aid, certHash);
+
+		for (i = key & indexMask; index[i].used == true; i = (i + 1) & indexMask)
+		{
+			if (index[i].key == key && index[i].aid == aid && index[i].certHash == certHash)
+			{
+				return &index[i];
+			}
+		}
+
+		return NULL;
+	}
+
+	void AccessControlList::compileIndex()
 	{
-		bool result = false;
 		map<ByteArray, AccessCondition>::iterator iterMap;
+		index_entry_t empty = { 0, false, false, ByteArray(), ByteArray(), NULL };
+		size_t count = 0;
+		size_t size = 8;
+		size_t i;
+
+		for (iterMap = mapConditions.begin(); iterMap != mapConditions.end(); iterMap++)
+		{
+			count += iterMap->second.hashes.size() + 1;
+		}
+
+		/* keep load factor under 0.5 */
+		while (size < count * 2)
+			size <<= 1;
+
+		index.assign(size, empty);
+		indexMask = size - 1;
+
+		for (iterMap = mapConditions.begin(); iterMap != mapConditions.end(); iterMap++)
+		{
+			AccessCondition &condition = iterMap->second;
+
+			if (condition.hashes.size() > 0)
+			{
+				for (i = 0; i < condition.hashes.size(); i++)
+				{
+					if (condition.hashes[i].isEmpty() == false)
+					{
+						insertIndex(iterMap->first, condition.hashes[i], true, &condition);
+					}
+				}
+
+				/* hashes are listed, any other one is denied */
+				insertIndex(iterMap->first, ByteArray::EMPTY, false, &condition);
+			}
+			else
+			{
+				insertIndex(iterMap->first, ByteArray::EMPTY, condition.permission, &condition);
+			}
+		}
+
+		indexGeneration = generation;
+
+		SCARD_DEBUG("access control index compiled, conditions [%d], entries [%d], slots [%d]", mapConditions.size(), count, size);
+	}
+
+	const AccessControlList::index_entry_t *AccessControlList::lookupIndex(const ByteArray &aid, const ByteArray &certHash)
+	{
+		const index_entry_t *entry;
+
+		/* first.. find hashes matched with aid */
+		if ((entry = findIndex(aid, certHash)) != NULL ||
+			(entry = findIndex(aid, ByteArray::EMPTY)) != NULL)
+		{
+			return entry;
+		}
+
+		/* finally.. find hashes in 'all' list */
+		if ((entry = findIndex(AID_ALL, certHash)) != NULL ||
+			(entry = findIndex(AID_ALL, ByteArray::EMPTY)) != NULL)
+		{
+			return entry;
+		}
+
+		return NULL;
+	}
+
+	bool AccessControlList::isAuthorizedAccess(const ByteArray &aid, const ByteArray &certHash)
+	{
+		bool result = false;
+		const ByteArray *key = &aid;
 
 		SCARD_DEBUG("aid : %s", aid.toString());
 		SCARD_DEBUG("hash : %s", certHash.toString());
@@ -96,18 +261,64 @@ namespace smartcard_service_api
 		/* null aid means default applet */
 		if (aid.isEmpty() == true)
 		{
-			aid = AID_DEFAULT;
+			key = &AID_DEFAULT;
 		}
 
-		/* first.. find hashes matched with aid */
-		if ((iterMap = mapConditions.find(aid)) != mapConditions.end())
+		SCOPE_LOCK(indexLock)
 		{
-			result = iterMap->second.isAuthorizedAccess(certHash);
+			decision_entry_t *decision;
+
+			if (indexGeneration != generation)
+			{
+				compileIndex();
+			}
+
+			/* decisions depend on the hash only, so caching by pid is not needed
+			 * and would be wrong once a pid is reused */
+			decision = &decisions[hashKey(*key, certHash) % DECISION_CACHE_SIZE];
+
+			if (decision->generation == generation &&
+				decision->aid == *key && decision->certHash == certHash)
+			{
+				result = decision->permission;
+			}
+			else
+			{
+				const index_entry_t *entry = lookupIndex(*key, certHash);
+
+				result = (entry != NULL && entry->permission == true);
+
+				decision->generation = generation;
+				decision->permission = result;
+				decision->aid = *key;
+				decision->certHash = certHash;
+			}
 		}
-		/* finally.. find hashes in 'all' list */
-		else if ((iterMap = mapConditions.find(AID_ALL)) != mapConditions.end())
+
+		return result;
+	}
+
+	bool AccessControlList::getAPDUAccessRule(const ByteArray &aid, const ByteArray &certHash, APDUAccessRule &rule)
+	{
+		bool result = false;
+
+		SCOPE_LOCK(indexLock)
 		{
-			result = iterMap->second.isAuthorizedAccess(certHash);
+			const index_entry_t *entry;
+
+			if (indexGeneration != generation)
+			{
+				compileIndex();
+			}
+
+			/* null aid means default applet */
+			entry = lookupIndex(aid.isEmpty() ? AID_DEFAULT : aid, certHash);
+			if (entry != NULL && entry->permission == true && entry->condition != NULL)
+			{
+				/* copied, list may be replaced while the channel is alive */
+				rule = entry->condition->getAPDUAccessRule();
+				result = true;
+			}
 		}
 
 		return result;
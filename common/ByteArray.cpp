@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <new>
 
 /* SLP library header */
 
@@ -27,8 +28,50 @@
 
 namespace smartcard_service_api
 {
+	/* heap storage is [refcount][data], buffer points to data */
+	typedef struct _storage_header_t
+	{
+		volatile int refCount;
+		uint32_t reserved;
+	}
+	storage_header_t;
+
+#define STORAGE_HEADER(x)	((storage_header_t *)((x) - sizeof(storage_header_t)))
+#define TO_STRING_SLOTS		8
+#define TO_STRING_LENGTH	100
+
 	ByteArray ByteArray::EMPTY = ByteArray();
 
+	ByteArrayView ByteArrayView::subView(uint32_t offset, uint32_t subLength) const
+	{
+		if (offset >= length)
+			return ByteArrayView();
+
+		if (subLength > length - offset)
+			subLength = length - offset;
+
+		return ByteArrayView(buffer + offset, subLength);
+	}
+
+	bool ByteArrayView::operator ==(const ByteArrayView &T) const
+	{
+		if (length != T.length)
+			return false;
+
+		return (length == 0 || memcmp(buffer, T.buffer, length) == 0);
+	}
+
+	uint8_t ByteArrayView::operator [](uint32_t index) const
+	{
+		if (index >= length)
+		{
+			SCARD_DEBUG_ERR("buffer overflow, index [%d], length [%d]", index, length);
+			return (length > 0) ? buffer[length - 1] : 0;
+		}
+
+		return buffer[index];
+	}
+
 	ByteArray::ByteArray()
 	{
 		buffer = NULL;
@@ -48,46 +91,154 @@ namespace smartcard_service_api
 		buffer = NULL;
 		length = 0;
 
-		setBuffer(T.buffer, T.length);
+		attach(T);
 	}
 
+	ByteArray::ByteArray(const ByteArrayView &T)
+	{
+		buffer = NULL;
+		length = 0;
+
+		setBuffer(T.getBuffer(), T.getLength());
+	}
+
+#if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
+	ByteArray::ByteArray(ByteArray &&T)
+	{
+		if (T.isInline() == true)
+		{
+			memcpy(inlineBuffer, T.buffer, T.length);
+			buffer = inlineBuffer;
+		}
+		else
+		{
+			buffer = T.buffer;
+		}
+		length = T.length;
+
+		T.buffer = NULL;
+		T.length = 0;
+	}
+#endif
+
 	ByteArray::~ByteArray()
 	{
 		releaseBuffer();
 	}
 
-	bool ByteArray::setBuffer(uint8_t *array, uint32_t bufferLen)
+	uint8_t *ByteArray::allocStorage(uint32_t bufferLen)
+	{
+		uint8_t *temp;
+
+		temp = new (std::nothrow) uint8_t[sizeof(storage_header_t) + bufferLen];
+		if (temp == NULL)
+		{
+			SCARD_DEBUG_ERR("alloc failed");
+			return NULL;
+		}
+
+		((storage_header_t *)temp)->refCount = 1;
+
+		return temp + sizeof(storage_header_t);
+	}
+
+	void ByteArray::attach(const ByteArray &T)
+	{
+		if (T.isInline() == true)
+		{
+			releaseBuffer();
+
+			memcpy(inlineBuffer, T.buffer, T.length);
+			buffer = inlineBuffer;
+			length = T.length;
+
+			return;
+		}
+
+		/* take the reference first, T may share storage with this */
+		if (T.buffer != NULL)
+		{
+			__sync_add_and_fetch(&STORAGE_HEADER(T.buffer)->refCount, 1);
+		}
+
+		releaseBuffer();
+
+		buffer = T.buffer;
+		length = T.length;
+	}
+
+	bool ByteArray::setBuffer(const uint8_t *array, uint32_t bufferLen)
 	{
+		uint8_t *temp;
+
 		if (array == NULL || bufferLen == 0)
 		{
 			return false;
 		}
 
-		releaseBuffer();
+		if (bufferLen <= INLINE_LENGTH)
+		{
+			/* array may point into our own storage */
+			if (isInline() == true)
+			{
+				memmove(inlineBuffer, array, bufferLen);
+			}
+			else
+			{
+				memcpy(inlineBuffer, array, bufferLen);
+				releaseBuffer();
+			}
 
-		buffer = new uint8_t[bufferLen];
-		if (buffer == NULL)
+			buffer = inlineBuffer;
+			length = bufferLen;
+
+			return true;
+		}
+
+		temp = allocStorage(bufferLen);
+		if (temp == NULL)
 		{
-			SCARD_DEBUG_ERR("alloc failed");
 			return false;
 		}
 
-		memcpy(buffer, array, bufferLen);
+		/* array may point into our own storage, copy before releasing */
+		memcpy(temp, array, bufferLen);
+
+		releaseBuffer();
+
+		buffer = temp;
 		length = bufferLen;
 
 		return true;
 	}
 
-	bool ByteArray::_setBuffer(uint8_t *array, uint32_t bufferLen)
+	bool ByteArray::allocBuffer(uint32_t bufferLen)
 	{
-		if (array == NULL || bufferLen == 0)
+		uint8_t *temp = NULL;
+
+		releaseBuffer();
+
+		if (bufferLen == 0)
 		{
-			return false;
+			return true;
 		}
 
-		releaseBuffer();
+		/* contents are left uninitialized, caller fills them through getBuffer() */
+		if (bufferLen <= INLINE_LENGTH)
+		{
+			buffer = inlineBuffer;
+			length = bufferLen;
 
-		buffer = array;
+			return true;
+		}
+
+		temp = allocStorage(bufferLen);
+		if (temp == NULL)
+		{
+			return false;
+		}
+
+		buffer = temp;
 		length = bufferLen;
 
 		return true;
@@ -160,7 +311,11 @@ namespace smartcard_service_api
 	{
 		if (buffer != NULL)
 		{
-			delete []buffer;
+			if (isInline() == false &&
+				__sync_sub_and_fetch(&STORAGE_HEADER(buffer)->refCount, 1) == 0)
+			{
+				delete [](uint8_t *)STORAGE_HEADER(buffer);
+			}
 			buffer = NULL;
 		}
 		length = 0;
@@ -170,7 +325,6 @@ namespace smartcard_service_api
 	ByteArray ByteArray::operator +(const ByteArray &T)
 	{
 		uint32_t newLen;
-		uint8_t *newBuffer;
 		ByteArray newArray;
 
 		if (length == 0)
@@ -187,19 +341,14 @@ namespace smartcard_service_api
 
 		newLen += length;
 
-		newBuffer = new uint8_t[newLen];
-		if (newBuffer == NULL)
+		if (newArray.allocBuffer(newLen) == false)
 		{
 			/* assert.... */
-			SCARD_DEBUG_ERR("alloc failed");
-
 			return *this;
 		}
 
-		memcpy(newBuffer, buffer, length);
-		memcpy(newBuffer + length, T.buffer, T.length);
-
-		newArray._setBuffer(newBuffer, newLen);
+		memcpy(newArray.buffer, buffer, length);
+		memcpy(newArray.buffer + length, T.buffer, T.length);
 
 		return newArray;
 	}
@@ -208,11 +357,37 @@ namespace smartcard_service_api
 	{
 		if (this != &T)
 		{
-			setBuffer(T.buffer, T.length);
+			attach(T);
+		}
+
+		return *this;
+	}
+
+#if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
+	ByteArray &ByteArray::operator =(ByteArray &&T)
+	{
+		if (this != &T)
+		{
+			if (T.isInline() == true)
+			{
+				attach(T);
+				T.releaseBuffer();
+
+				return *this;
+			}
+
+			releaseBuffer();
+
+			buffer = T.buffer;
+			length = T.length;
+
+			T.buffer = NULL;
+			T.length = 0;
 		}
 
 		return *this;
 	}
+#endif
 
 	ByteArray &ByteArray::operator +=(const ByteArray &T)
 	{
@@ -226,6 +401,9 @@ namespace smartcard_service_api
 		if (length != T.length)
 			return false;
 
+		if (buffer == T.buffer)
+			return true;
+
 		return (memcmp(buffer, T.buffer, length) == 0);
 	}
 
@@ -236,15 +414,18 @@ namespace smartcard_service_api
 
 	bool ByteArray::operator <(const ByteArray &T) const
 	{
-		return (memcmp(buffer, T.buffer, (length < T.length) ? length : T.length) < 0);
+		int result = memcmp(buffer, T.buffer, (length < T.length) ? length : T.length);
+
+		/* shorter one is less when common part is same */
+		return (result < 0 || (result == 0 && length < T.length));
 	}
 
 	bool ByteArray::operator >(const ByteArray &T) const
 	{
-		return (memcmp(buffer, T.buffer, (length < T.length) ? length : T.length) > 0);
+		return (T < *this);
 	}
 
-	uint8_t &ByteArray::operator [](uint32_t index) const
+	uint8_t ByteArray::operator [](uint32_t index) const
 	{
 		if (index >= length)
 		{
@@ -255,13 +436,19 @@ namespace smartcard_service_api
 		return buffer[index];
 	}
 
-	const char *ByteArray::toString()
+	const char *ByteArray::toString() const
 	{
-		memset(strBuffer, 0, sizeof(strBuffer));
+		static __thread char strBuffer[TO_STRING_SLOTS][TO_STRING_LENGTH];
+		static __thread unsigned int slot;
+		char *result;
+
+		/* rotate, so that several calls may appear in one log statement */
+		result = strBuffer[slot++ % TO_STRING_SLOTS];
+		memset(result, 0, TO_STRING_LENGTH);
 
 		if (length == 0)
 		{
-			snprintf(strBuffer, sizeof(strBuffer), "buffer is empty");
+			snprintf(result, TO_STRING_LENGTH, "buffer is empty");
 		}
 		else
 		{
@@ -276,26 +463,26 @@ namespace smartcard_service_api
 				ellipsis = true;
 			}
 
-			snprintf(strBuffer + offset, sizeof(strBuffer) - offset, "{ ");
+			snprintf(result + offset, TO_STRING_LENGTH - offset, "{ ");
 			offset += 2;
 
 			for (i = 0; i < count; i++)
 			{
-				snprintf(strBuffer + offset, sizeof(strBuffer) - offset, "%02X ", buffer[i]);
+				snprintf(result + offset, TO_STRING_LENGTH - offset, "%02X ", buffer[i]);
 				offset += 3;
 			}
 
 			if (ellipsis)
 			{
-				snprintf(strBuffer + offset, sizeof(strBuffer) - offset, "... }");
+				snprintf(result + offset, TO_STRING_LENGTH - offset, "... }");
 			}
 			else
 			{
-				snprintf(strBuffer + offset, sizeof(strBuffer) - offset, "}");
+				snprintf(result + offset, TO_STRING_LENGTH - offset, "}");
 			}
 		}
 
-		return (const char *)strBuffer;
+		return (const char *)result;
 	}
 
 	void ByteArray::save(const char *filePath)
@@ -29,6 +29,7 @@ namespace smartcard_service_api
 	DispatcherHelper::DispatcherHelper()
 	{
 		dispatcherThread = 0;
+		stopping = false;
 	}
 
 	DispatcherHelper::~DispatcherHelper()
@@ -60,6 +61,30 @@ namespace smartcard_service_api
 		}
 	}
 
+	void DispatcherHelper::removeMessages(int peerSocket)
+	{
+		queue<DispatcherMsg *> temp;
+		DispatcherMsg *msg = NULL;
+
+		syncLock();
+
+		while ((msg = fetchMessage()) != NULL)
+		{
+			if (msg->getPeerSocket() == peerSocket)
+			{
+				delete msg;
+			}
+			else
+			{
+				temp.push(msg);
+			}
+		}
+
+		messageQ = temp;
+
+		syncUnlock();
+	}
+
 	void DispatcherHelper::pushMessage(DispatcherMsg *msg)
 	{
 		syncLock();
@@ -78,6 +103,12 @@ namespace smartcard_service_api
 		while (1)
 		{
 			helper->syncLock();
+			if (helper->stopping == true)
+			{
+				helper->syncUnlock();
+				break;
+			}
+
 			if ((msg = helper->fetchMessage()) == NULL)
 			{
 				helper->waitTimedCondition(0);
@@ -104,12 +135,17 @@ namespace smartcard_service_api
 		{
 			int ret;
 
+			stopping = false;
+
+			/* joined by stopDispatcherThread */
 			pthread_attr_init(&attr);
-			pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+			pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 
 			if ((ret = pthread_create(&dispatcherThread, &attr, &DispatcherHelper::_dispatcherThreadFunc, this)) != 0)
 			{
 				SCARD_DEBUG_ERR("pthread_create failed [%d]", ret);
+
+				dispatcherThread = 0;
 			}
 			else
 			{
@@ -130,7 +166,22 @@ namespace smartcard_service_api
 	{
 		if (dispatcherThread != 0)
 		{
-			pthread_cancel(dispatcherThread);
+			/* the message in progress is finished, the queued ones are left to the owner */
+			syncLock();
+			stopping = true;
+			signalCondition();
+			syncUnlock();
+
+			if (pthread_equal(dispatcherThread, pthread_self()) != 0)
+			{
+				/* stopped from a callback, the thread exits when it returns */
+				pthread_detach(dispatcherThread);
+			}
+			else
+			{
+				pthread_join(dispatcherThread, NULL);
+			}
+
 			dispatcherThread = 0;
 		}
 	}
@@ -24,6 +24,7 @@
 #include "Debug.h"
 #include "FileObject.h"
 #include "APDUHelper.h"
+#include "Message.h"
 
 namespace smartcard_service_api
 {
@@ -331,38 +332,124 @@ namespace smartcard_service_api
 
 	int FileObject::readBinary(unsigned int sfi, unsigned int offset, unsigned int length, ByteArray &result)
 	{
-		ByteArray command, response;
-		APDUCommand apdu;
-		int ret;
+		vector<ByteArray> commands, responses;
+		unsigned int chunk, position, size;
+		size_t i, first, last;
+		int ret = 0;
 
-		apdu.setCommand(0, APDUCommand::INS_READ_BINARY, offset, 0, ByteArray::EMPTY, length);
-		apdu.getBuffer(command);
-		SCARD_DEBUG("command : %s", command.toString());
+		/* offsets beyond 15 bits can not be addressed by read binary */
+		if ((sfi > 0 && offset > 0xFF) || offset + length > 0x8000)
+		{
+			SCARD_DEBUG_ERR("invalid parameter, sfi [%d], offset [%d], length [%d]", sfi, offset, length);
 
-		ret = channel->transmitSync(command, response);
-		if (ret == 0 && response.getLength() >= 2)
+			return ERROR_ILLEGAL_PARAMETER;
+		}
+
+		/* one command for each chunk the card can return at once */
+		chunk = channel->getMaxResponseSize();
+		position = offset;
+
+		do
 		{
-			ResponseHelper resp(response);
+			ByteArray command;
+			APDUCommand apdu;
+			unsigned int p1, p2;
 
-			if (resp.getStatus() == 0)
+			size = (length == 0) ? chunk : length - (position - offset);
+			if (size > chunk)
 			{
-				SCARD_DEBUG("response [%d] : %s", response.getLength(), response.toString());
+				size = chunk;
+			}
 
-				result = resp.getDataField();
+			if (sfi > 0 && position == offset)
+			{
+				/* the file becomes the current ef for the next chunks */
+				p1 = 0x80 | (sfi & 0x1F);
+				p2 = position;
+			}
+			else
+			{
+				p1 = (position >> 8) & 0x7F;
+				p2 = position & 0xFF;
+			}
 
-				ret = SUCCESS;
+			apdu.setCommand(0, APDUCommand::INS_READ_BINARY, p1, p2, ByteArray::EMPTY, size);
+			apdu.getBuffer(command);
+			SCARD_DEBUG("command : %s", command.toString());
+
+			commands.push_back(command);
+			position += size;
+		}
+		while (length > 0 && position < offset + length);
+
+		/* chunks are sent in batches, without waiting for the caller in between */
+		for (first = 0; first < commands.size() && ret == 0; first = last)
+		{
+			vector<ByteArray> batch, partial;
+
+			last = first + Message::MAX_BATCH_COUNT;
+			if (last > commands.size())
+			{
+				last = commands.size();
+			}
+
+			batch.assign(commands.begin() + first, commands.begin() + last);
+
+			ret = channel->transmitSync(batch, partial);
+			responses.insert(responses.end(), partial.begin(), partial.end());
+
+			/* stopped at an error or at the end of file */
+			if (partial.size() != batch.size() || ResponseHelper::getStatus(partial.back()) != 0)
+			{
+				break;
+			}
+		}
+
+		result.releaseBuffer();
+
+		for (i = 0; i < responses.size(); i++)
+		{
+			ByteArray &response = responses[i];
+			unsigned char sw1, sw2;
+
+			if (response.getLength() < 2)
+			{
+				SCARD_DEBUG_ERR("invalid response, length [%d]", response.getLength());
+
+				return ERROR_IO;
+			}
+
+			SCARD_DEBUG("response [%d] : %s", response.getLength(), response.toString());
+
+			sw1 = response[response.getLength() - 2];
+			sw2 = response[response.getLength() - 1];
+
+			if (ResponseHelper::getStatus(response) == 0 || (sw1 == 0x62 && sw2 == 0x82))
+			{
+				result += ResponseHelper::getDataField(response);
+
+				/* end of file reached before the requested length */
+				if (sw1 == 0x62 && sw2 == 0x82)
+				{
+					return SUCCESS;
+				}
 			}
 			else
 			{
-				SCARD_DEBUG_ERR("status word [%d][ 0x%02X 0x%02X ]", resp.getStatus(), response[response.getLength() - 2], response[response.getLength() - 1]);
+				SCARD_DEBUG_ERR("status word [%d][ 0x%02X 0x%02X ]", ResponseHelper::getStatus(response), sw1, sw2);
+
+				return ERROR_IO;
 			}
 		}
-		else
+
+		if (ret != 0 || responses.size() != commands.size())
 		{
-			SCARD_DEBUG_ERR("select apdu is failed, rv [%d], length [%d]", ret, response.getLength());
+			SCARD_DEBUG_ERR("read binary apdu is failed, rv [%d], responses [%d/%d]", ret, responses.size(), commands.size());
+
+			return ERROR_IO;
 		}
 
-		return ret;
+		return SUCCESS;
 	}
 
 	int FileObject::writeBinary(unsigned int sfi, ByteArray data, unsigned int offset, unsigned int length)
@@ -0,0 +1,183 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <errno.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Future.h"
+
+namespace smartcard_service_api
+{
+	Future::Future()
+	{
+		pthread_condattr_t attr;
+
+		pthread_mutex_init(&mutex, NULL);
+
+		/* deadlines don't move with the wall clock */
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&condition, &attr);
+		pthread_condattr_destroy(&attr);
+
+		state = STATE_PENDING;
+		error = 0;
+		param1 = 0;
+		param2 = 0;
+	}
+
+	Future::~Future()
+	{
+		pthread_cond_destroy(&condition);
+		pthread_mutex_destroy(&mutex);
+	}
+
+	void Future::reset()
+	{
+		pthread_mutex_lock(&mutex);
+
+		state = STATE_PENDING;
+		error = 0;
+		param1 = 0;
+		param2 = 0;
+		data.releaseBuffer();
+
+		pthread_mutex_unlock(&mutex);
+	}
+
+	bool Future::complete(Message *msg)
+	{
+		bool result = false;
+
+		pthread_mutex_lock(&mutex);
+
+		if (state == STATE_PENDING)
+		{
+			error = msg->error;
+			param1 = msg->param1;
+			param2 = msg->param2;
+			data = msg->data;
+
+			state = STATE_COMPLETED;
+			pthread_cond_broadcast(&condition);
+
+			result = true;
+		}
+
+		pthread_mutex_unlock(&mutex);
+
+		return result;
+	}
+
+	bool Future::cancel()
+	{
+		bool result = false;
+
+		pthread_mutex_lock(&mutex);
+
+		if (state == STATE_PENDING)
+		{
+			error = -1;
+
+			state = STATE_CANCELLED;
+			pthread_cond_broadcast(&condition);
+
+			result = true;
+		}
+
+		pthread_mutex_unlock(&mutex);
+
+		return result;
+	}
+
+	int Future::getState()
+	{
+		int result;
+
+		pthread_mutex_lock(&mutex);
+		result = state;
+		pthread_mutex_unlock(&mutex);
+
+		return result;
+	}
+
+	int Future::waitUntil(const struct timespec *deadline)
+	{
+		int result = WAIT_TIMEOUT;
+		int ret = 0;
+
+		pthread_mutex_lock(&mutex);
+
+		/* the state is the predicate, spurious and early wakeups just loop */
+		while (state == STATE_PENDING && ret != ETIMEDOUT)
+		{
+			if (deadline != NULL)
+			{
+				ret = pthread_cond_timedwait(&condition, &mutex, deadline);
+			}
+			else
+			{
+				pthread_cond_wait(&condition, &mutex);
+			}
+		}
+
+		if (state == STATE_COMPLETED)
+		{
+			result = WAIT_COMPLETED;
+		}
+		else if (state == STATE_CANCELLED)
+		{
+			result = WAIT_CANCELLED;
+		}
+
+		pthread_mutex_unlock(&mutex);
+
+		return result;
+	}
+
+	int Future::wait(int timeout)
+	{
+		struct timespec deadline;
+
+		if (timeout <= 0)
+		{
+			return waitUntil(NULL);
+		}
+
+		getDeadline(timeout, &deadline);
+
+		return waitUntil(&deadline);
+	}
+
+	void Future::getDeadline(int timeout, struct timespec *deadline)
+	{
+		clock_gettime(CLOCK_MONOTONIC, deadline);
+
+		deadline->tv_sec += timeout / 1000;
+		deadline->tv_nsec += (timeout % 1000) * 1000000L;
+
+		if (deadline->tv_nsec >= 1000000000L)
+		{
+			deadline->tv_sec++;
+			deadline->tv_nsec -= 1000000000L;
+		}
+	}
+
+} /* namespace smartcard_service_api */
@@ -16,12 +16,20 @@
 
 
 /* standard library header */
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 /* SLP library header */
 
 /* local header */
 #include "Debug.h"
 #include "GPSEACL.h"
+#include "Terminal.h"
+#include "Message.h"
 #include "PKCS15ODF.h"
 #include "PKCS15DODF.h"
 #include "NumberStream.h"
@@ -32,11 +40,16 @@
 #define EXTERN_API __attribute__((visibility("default")))
 #endif
 
+#define ACL_CACHE_DIR "/opt/share/smartcard-service"
+
 namespace smartcard_service_api
 {
 	static unsigned char oid_globalplatform[] = { 0x2A, 0x86, 0x48, 0x86, 0xFC, 0x6B, 0x81, 0x48, 0x01, 0x01 };
 	ByteArray GPSEACL::OID_GLOBALPLATFORM(ARRAY_AND_SIZE(oid_globalplatform));
 
+	static unsigned char acl_cache_version[] = { 'A', 'C', 'L', 0x01 };
+	static ByteArray ACL_CACHE_VERSION(ARRAY_AND_SIZE(acl_cache_version));
+
 	GPSEACL::GPSEACL(Channel *channel):AccessControlList(channel)
 	{
 		this->channel = channel;
@@ -64,6 +77,12 @@ namespace smartcard_service_api
 		ByteArray aid, certHash;
 		PKCS15ODF *odf;
 
+		/* skip reading whole pkcs15 tree if the card is not changed */
+		if (loadCache() == 0)
+		{
+			return 0;
+		}
+
 		if ((odf = pkcs15->getODF()) != NULL)
 		{
 			PKCS15DODF *dodf;
@@ -87,53 +106,98 @@ namespace smartcard_service_api
 		return 0;
 	}
 
-	int GPSEACL::loadAccessControl(PKCS15DODF *dodf)
+	bool GPSEACL::isChanged()
 	{
-		ByteArray path;
+		ByteArray refreshTag, rulesPath;
 
-		if (dodf->searchOID(OID_GLOBALPLATFORM, path) == 0)
+		if (mainFilePath.isEmpty() == true || mapConditions.size() == 0)
 		{
-			ByteArray data;
-			FileObject file(channel);
+			return true;
+		}
 
-			SCARD_DEBUG("oid path : %s", path.toString());
+		/* the basic channel may be elsewhere, go back to the application first */
+		if (pkcs15->select(PKCS15::PKCS15_AID) != FileObject::SUCCESS ||
+			readMainFile(mainFilePath, refreshTag, rulesPath) != 0)
+		{
+			SCARD_DEBUG_ERR("refresh tag is not readable");
 
-			file.select(NumberStream::getLittleEndianNumber(path));
-			file.readBinary(0, 0, file.getFCP()->getFileSize(), data);
+			return true;
+		}
 
-			SCARD_DEBUG("data : %s", data.toString());
+		return (this->refreshTag != refreshTag);
+	}
 
-			SimpleTLV tlv(data);
+	int GPSEACL::readMainFile(const ByteArray &path, ByteArray &refreshTag, ByteArray &rulesPath)
+	{
+		ByteArray data;
+		FileObject file(channel);
+		int result = -1;
 
-			if (tlv.decodeTLV() == true && tlv.getTag() == 0x30) /* SEQUENCE : AccessControlMainFile */
+		SCARD_DEBUG("oid path : %s", path.toString());
+
+		file.select(NumberStream::getLittleEndianNumber(path));
+		file.readBinary(0, 0, file.getFCP()->getFileSize(), data);
+
+		SCARD_DEBUG("data : %s", data.toString());
+
+		SimpleTLV tlv(data);
+
+		if (tlv.decodeTLV() == true && tlv.getTag() == 0x30) /* SEQUENCE : AccessControlMainFile */
+		{
+			tlv.enterToValueTLV();
+
+			/* refresh Tag */
+			refreshTag = SimpleTLV::getOctetString(tlv);
+			SCARD_DEBUG("current refresh tag : %s", refreshTag.toString());
+
+			/* access control rule path */
+			if (tlv.decodeTLV() == true && tlv.getTag() == 0x30) /* SEQUENCE : Path */
 			{
-				tlv.enterToValueTLV();
+				/* TODO : parse path */
+				/* OCTET STRING */
+				rulesPath = SimpleTLV::getOctetString(tlv.getValue());
+				SCARD_DEBUG("access control rule path : %s", rulesPath.toString());
+			}
+
+			tlv.returnToParentTLV();
 
-				/* refresh Tag */
-				ByteArray refreshTag;
+			result = 0;
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("tlv.decodeTLV failed");
+		}
 
-				refreshTag = SimpleTLV::getOctetString(tlv);
-				SCARD_DEBUG("current refresh tag : %s", refreshTag.toString());
+		return result;
+	}
 
-				if (this->refreshTag != refreshTag) /* need to update access control list */
+	int GPSEACL::loadAccessControl(PKCS15DODF *dodf)
+	{
+		ByteArray path;
+
+		if (dodf->searchOID(OID_GLOBALPLATFORM, path) == 0)
+		{
+			ByteArray refreshTag, rulesPath;
+
+			if (readMainFile(path, refreshTag, rulesPath) == 0)
+			{
+				/* need to update access control list */
+				if (this->refreshTag != refreshTag || mapConditions.size() == 0)
 				{
 					this->refreshTag = refreshTag;
 
+					/* drops the compiled index and cached decisions too */
 					releaseACL();
+					conditionFiles.clear();
 
-					/* access control rule path */
-					if (tlv.decodeTLV() == true && tlv.getTag() == 0x30) /* SEQUENCE : Path */
+					if (rulesPath.isEmpty() == false)
 					{
-						/* TODO : parse path */
-						ByteArray path;
-
-						/* OCTET STRING */
-						path = SimpleTLV::getOctetString(tlv.getValue());
-						SCARD_DEBUG("access control rule path : %s", path.toString());
-
-						if (loadRules(path) == 0)
+						if (loadRules(rulesPath) == 0)
 						{
 							SCARD_DEBUG("loadRules success");
+
+							mainFilePath = path;
+							saveCache();
 						}
 						else
 						{
@@ -141,11 +205,6 @@ namespace smartcard_service_api
 						}
 					}
 				}
-				tlv.returnToParentTLV();
-			}
-			else
-			{
-				SCARD_DEBUG_ERR("tlv.decodeTLV failed");
 			}
 		}
 		else
@@ -235,6 +294,13 @@ namespace smartcard_service_api
 
 		SCARD_DEBUG("data : %s", data.toString());
 
+		addAccessCondition(aid, data);
+
+		return 0;
+	}
+
+	void GPSEACL::addAccessCondition(ByteArray &aid, ByteArray &data)
+	{
 		AccessCondition condition;
 
 		condition.loadAccessCondition(aid, data);
@@ -242,10 +308,150 @@ namespace smartcard_service_api
 		pair<ByteArray, AccessCondition> newItem(aid, condition);
 
 		mapConditions.insert(newItem);
+		invalidateIndex();
+
+		conditionFiles.push_back(aid);
+		conditionFiles.push_back(data);
+	}
+
+	void GPSEACL::getCacheFilePath(char *filePath, size_t length)
+	{
+		char name[64] = { 0, };
+		size_t i;
+
+		snprintf(name, sizeof(name), "%s", terminal->getName());
+
+		/* terminal name is used as a part of file name */
+		for (i = 0; name[i] != '\0'; i++)
+		{
+			if (isalnum(name[i]) == 0)
+				name[i] = '_';
+		}
+
+		snprintf(filePath, length, "%s/acl-%s.cache", ACL_CACHE_DIR, name);
+	}
+
+	int GPSEACL::loadCache()
+	{
+		char filePath[256] = { 0, };
+		FILE *file = NULL;
+		long fileSize = 0;
+		ByteArray data, refreshTag, rulesPath;
+		vector<ByteArray> items;
+		size_t i;
+
+		if (terminal == NULL || terminal->getName() == NULL)
+			return -1;
+
+		getCacheFilePath(filePath, sizeof(filePath));
+
+		if ((file = fopen(filePath, "r")) == NULL)
+		{
+			SCARD_DEBUG("no cache file, [%s]", filePath);
+			return -1;
+		}
+
+		if (fseek(file, 0, SEEK_END) == 0 && (fileSize = ftell(file)) > 0 &&
+			fseek(file, 0, SEEK_SET) == 0 && data.allocBuffer(fileSize) == true &&
+			fread(data.getBuffer(), 1, fileSize, file) != (size_t)fileSize)
+		{
+			data.releaseBuffer();
+		}
+
+		fclose(file);
+
+		/* version, terminal name, refresh tag, main file path, { aid, condition }... */
+		if (Message::deserializeList(data, items) == false || items.size() < 4 ||
+			(items.size() % 2) != 0 || items[0] != ACL_CACHE_VERSION ||
+			items[1] != ByteArray((uint8_t *)terminal->getName(), strlen(terminal->getName())))
+		{
+			SCARD_DEBUG_ERR("invalid cache file, [%s]", filePath);
+			return -1;
+		}
+
+		/* read refresh tag only */
+		if (readMainFile(items[3], refreshTag, rulesPath) != 0 || refreshTag != items[2])
+		{
+			SCARD_DEBUG("refresh tag is changed, cached %s", items[2].toString());
+			return -1;
+		}
+
+		if (this->refreshTag == refreshTag && mapConditions.size() > 0)
+		{
+			SCARD_DEBUG("access control list is not changed");
+			return 0;
+		}
+
+		this->refreshTag = refreshTag;
+		mainFilePath = items[3];
+
+		releaseACL();
+		conditionFiles.clear();
+
+		for (i = 4; i < items.size(); i += 2)
+		{
+			addAccessCondition(items[i], items[i + 1]);
+		}
+
+		SCARD_DEBUG("access control list is loaded from cache, [%s]", filePath);
+
+		printAccessControlList();
 
 		return 0;
 	}
 
+	void GPSEACL::saveCache()
+	{
+		char filePath[256] = { 0, };
+		char tempPath[260] = { 0, };
+		FILE *file = NULL;
+		vector<ByteArray> items;
+		ByteArray data;
+
+		if (terminal == NULL || terminal->getName() == NULL)
+			return;
+
+		items.push_back(ACL_CACHE_VERSION);
+		items.push_back(ByteArray((uint8_t *)terminal->getName(), strlen(terminal->getName())));
+		items.push_back(refreshTag);
+		items.push_back(mainFilePath);
+		items.insert(items.end(), conditionFiles.begin(), conditionFiles.end());
+
+		data = Message::serializeList(items);
+
+		getCacheFilePath(filePath, sizeof(filePath));
+		snprintf(tempPath, sizeof(tempPath), "%s.tmp", filePath);
+
+		if (mkdir(ACL_CACHE_DIR, 0700) != 0 && errno != EEXIST)
+		{
+			SCARD_DEBUG_ERR("mkdir failed, [%d]", errno);
+			return;
+		}
+
+		/* write to another file and rename, not to leave a broken cache */
+		if ((file = fopen(tempPath, "w")) != NULL)
+		{
+			size_t written = fwrite(data.getBuffer(), 1, data.getLength(), file);
+
+			fflush(file);
+			fclose(file);
+
+			if (written == data.getLength() && rename(tempPath, filePath) == 0)
+			{
+				SCARD_DEBUG("cache file has written, [%s], length [%d]", filePath, data.getLength());
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("cache file write failed, [%d]", errno);
+				unlink(tempPath);
+			}
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("file open failed, [%d]", errno);
+		}
+	}
+
 } /* namespace smartcard_service_api */
 
 /* export C API */
@@ -27,6 +27,9 @@
 #include <netinet/in.h>
 #endif /* USE_UNIX_DOMAIN */
 #include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
 
 /* SLP library header */
 
@@ -38,6 +41,8 @@
 #define OMAPI_SERVER_DOMAIN "/tmp/omapi-server-domain"
 #endif /* USE_UNIX_DOMAIN */
 
+#define IPC_WAIT_TIMEOUT 3000 /* ms, wait for the rest of a frame */
+
 static void setNonBlockSocket(int socket)
 {
 	int flags;
@@ -52,6 +57,57 @@ static void setNonBlockSocket(int socket)
 	}
 }
 
+static bool waitSocket(int socket, short events)
+{
+	struct pollfd fds;
+	int ret;
+
+	fds.fd = socket;
+	fds.events = events;
+	fds.revents = 0;
+
+	do
+	{
+		ret = poll(&fds, 1, IPC_WAIT_TIMEOUT);
+	}
+	while (ret < 0 && errno == EINTR);
+
+	return (ret > 0 && (fds.revents & events) != 0);
+}
+
+static bool recvFully(int socket, void *buffer, size_t length)
+{
+	size_t current = 0;
+	ssize_t readBytes;
+
+	while (current < length)
+	{
+		readBytes = recv(socket, (char *)buffer + current, length - current, 0);
+		if (readBytes > 0)
+		{
+			current += readBytes;
+		}
+		else if (readBytes < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (readBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			if (waitSocket(socket, POLLIN) == false)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			/* closed by peer or error */
+			return false;
+		}
+	}
+
+	return true;
+}
+
 namespace smartcard_service_api
 {
 	IPCHelper::IPCHelper()
@@ -96,9 +152,8 @@ namespace smartcard_service_api
 		return result;
 	}
 
-	bool IPCHelper::createListenSocket()
+	bool IPCHelper::openListenSocket()
 	{
-		GIOCondition condition = (GIOCondition)(G_IO_ERR | G_IO_HUP | G_IO_IN);
 		struct sockaddr_un saddrun_rv;
 
 		if (ipcSocket >= 0)
@@ -138,20 +193,6 @@ namespace smartcard_service_api
 			goto ERROR;
 		}
 
-		if ((ioChannel = g_io_channel_unix_new(ipcSocket)) != NULL)
-		{
-			if ((watchId = g_io_add_watch(ioChannel, condition, &IPCHelper::channelCallbackFunc, this)) < 1)
-			{
-				SCARD_DEBUG_ERR(" g_io_add_watch is failed \n");
-				goto ERROR;
-			}
-		}
-		else
-		{
-			SCARD_DEBUG_ERR(" g_io_channel_unix_new is failed \n");
-			goto ERROR;
-		}
-
 #ifdef SECURITY_SERVER
 		gid = security_server_get_gid(NET_NFC_MANAGER_OBJECT);
 		if(gid == 0)
@@ -169,6 +210,49 @@ namespace smartcard_service_api
 		}
 #endif
 
+		return true;
+
+ERROR :
+		closeListenSocket();
+
+		return false;
+	}
+
+	void IPCHelper::closeListenSocket()
+	{
+		if (ipcSocket != -1)
+		{
+			shutdown(ipcSocket, SHUT_RDWR);
+			close(ipcSocket);
+
+			ipcSocket = -1;
+		}
+	}
+
+	bool IPCHelper::createListenSocket()
+	{
+		GIOCondition condition = (GIOCondition)(G_IO_ERR | G_IO_HUP | G_IO_IN);
+
+		if (ioChannel != NULL)
+			return true;
+
+		if (openListenSocket() == false)
+			return false;
+
+		if ((ioChannel = g_io_channel_unix_new(ipcSocket)) != NULL)
+		{
+			if ((watchId = g_io_add_watch(ioChannel, condition, &IPCHelper::channelCallbackFunc, this)) < 1)
+			{
+				SCARD_DEBUG_ERR(" g_io_add_watch is failed \n");
+				goto ERROR;
+			}
+		}
+		else
+		{
+			SCARD_DEBUG_ERR(" g_io_channel_unix_new is failed \n");
+			goto ERROR;
+		}
+
 		SCARD_DEBUG("server ipc is initialized");
 
 		return true;
@@ -185,13 +269,7 @@ ERROR :
 			ioChannel = NULL;
 		}
 
-		if (ipcSocket != -1)
-		{
-			shutdown(ipcSocket, SHUT_RDWR);
-			close(ipcSocket);
-
-			ipcSocket = -1;
-		}
+		closeListenSocket();
 
 		return false;
 	}
@@ -241,6 +319,8 @@ ERROR :
 
 		pthread_mutex_unlock(&ipcLock);
 
+		negotiateTransport();
+
 		if ((ioChannel = g_io_channel_unix_new(ipcSocket)) != NULL)
 		{
 			if ((watchId = g_io_add_watch(ioChannel, condition, &IPCHelper::channelCallbackFunc, this)) < 1)
@@ -299,50 +379,98 @@ ERROR :
 	bool IPCHelper::sendMessage(int socket, Message *msg)
 	{
 		bool result = false;
-		ByteArray stream;
-		unsigned int length = 0;
 
-		stream = msg->serialize();
-		length = stream.getLength();
+		pthread_mutex_lock(&ipcLock);
+		result = sendFrame(socket, msg);
+		pthread_mutex_unlock(&ipcLock);
+
+		return result;
+	}
+
+	bool IPCHelper::sendFrame(int socket, Message *msg, int *fds, int count)
+	{
+		message_header_t header;
+		struct iovec iov[2];
+		struct msghdr mh;
+		struct cmsghdr *cmsg;
+		char control[CMSG_SPACE(sizeof(int) * 4)];
+		size_t remain;
+		ssize_t sentBytes;
+
+		msg->getHeader(&header);
+
+		SCARD_DEBUG(">>>[SEND]>>> socket [%d], msg [%d], length [%d]", socket, msg->message, header.dataLength);
+
+		/* header and payload leave in one syscall */
+		iov[0].iov_base = &header;
+		iov[0].iov_len = sizeof(header);
+		iov[1].iov_base = msg->data.getBuffer();
+		iov[1].iov_len = header.dataLength;
 
-		SCARD_DEBUG(">>>[SEND]>>> socket [%d], msg [%d], length [%d]", socket, msg->message, length);
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = iov;
+		mh.msg_iovlen = (header.dataLength > 0) ? 2 : 1;
 
-		if (length > 0)
+		if (count > 0 && (size_t)count * sizeof(int) <= sizeof(control) - CMSG_SPACE(0))
 		{
-			int sentBytes = 0;
+			/* descriptors go with the first byte of the frame */
+			memset(control, 0, sizeof(control));
+			mh.msg_control = control;
+			mh.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+			cmsg = CMSG_FIRSTHDR(&mh);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+			memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+		}
 
-			/* send 4 bytes (length) */
-			pthread_mutex_lock(&ipcLock);
-			sentBytes = send(socket, &length, sizeof(length), 0);
-			pthread_mutex_unlock(&ipcLock);
-			if (sentBytes == sizeof(length))
+		remain = sizeof(header) + header.dataLength;
+
+		while (remain > 0)
+		{
+			sentBytes = sendmsg(socket, &mh, MSG_NOSIGNAL);
+			if (sentBytes > 0)
 			{
-				unsigned int current = 0;
+				remain -= sentBytes;
+
+				mh.msg_control = NULL;
+				mh.msg_controllen = 0;
 
-				/* send message */
-				pthread_mutex_lock(&ipcLock);
-				do
+				/* skip what has been sent */
+				while (mh.msg_iovlen > 0 && (size_t)sentBytes >= mh.msg_iov->iov_len)
 				{
-					sentBytes = send(socket, stream.getBuffer(current), length - current, 0);
-					if (sentBytes > 0)
-						current += sentBytes;
+					sentBytes -= mh.msg_iov->iov_len;
+					mh.msg_iov++;
+					mh.msg_iovlen--;
 				}
-				while (current < length);
-				pthread_mutex_unlock(&ipcLock);
 
-				result = true;
+				if (mh.msg_iovlen > 0)
+				{
+					mh.msg_iov->iov_base = (char *)mh.msg_iov->iov_base + sentBytes;
+					mh.msg_iov->iov_len -= sentBytes;
+				}
+			}
+			else if (sentBytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			else if (sentBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				if (waitSocket(socket, POLLOUT) == false)
+				{
+					SCARD_DEBUG_ERR("send timeout, socket [%d], remain [%d]", socket, remain);
+					break;
+				}
 			}
 			else
 			{
-				SCARD_DEBUG_ERR("send failed, sentBytes [%d]", sentBytes);
+				SCARD_DEBUG_ERR("send failed, socket [%d], errno [%d]", socket, errno);
+				break;
 			}
 		}
-		else
-		{
-			SCARD_DEBUG_ERR("stream length is zero");
-		}
 
-		return result;
+		return (remain == 0);
 	}
 
 	Message *IPCHelper::retrieveMessage()
@@ -353,73 +481,73 @@ ERROR :
 	Message *IPCHelper::retrieveMessage(int socket)
 	{
 		Message *msg = NULL;
-		unsigned int length = 0;
-		int readBytes = 0;
+
+		msg = new Message();
+		if (msg != NULL)
+		{
+			if (retrieveMessage(socket, msg) == false)
+			{
+				delete msg;
+				msg = NULL;
+			}
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("alloc failed");
+		}
+
+		return msg;
+	}
+
+	bool IPCHelper::retrieveMessage(int socket, Message *msg)
+	{
+		bool result = false;
 
 		SCARD_BEGIN();
 
-		/* read 4 bytes (length) */
 		pthread_mutex_lock(&ipcLock);
-		readBytes = recv(socket, &length, sizeof(length), 0);
+		result = recvFrame(socket, msg);
 		pthread_mutex_unlock(&ipcLock);
-		if (readBytes == sizeof(length))
+
+		SCARD_END();
+
+		return result;
+	}
+
+	bool IPCHelper::recvFrame(int socket, Message *msg)
+	{
+		bool result = false;
+		message_header_t header;
+
+		if (recvFully(socket, &header, sizeof(header)) == true)
 		{
-			if (length > 0)
-			{
-				unsigned char *buffer = NULL;
+			msg->setHeader(&header);
 
-				/* prepare buffer */
-				buffer = new unsigned char[length];
-				if (buffer != NULL)
+			/* payload is read straight into the message */
+			if (msg->data.allocBuffer(header.dataLength) == true)
+			{
+				if (header.dataLength == 0 || recvFully(socket, msg->data.getBuffer(), header.dataLength) == true)
 				{
-					int retry = 0;
-					unsigned int current = 0;
-
-					/* read message */
-					pthread_mutex_lock(&ipcLock);
-					do
-					{
-						readBytes = recv(socket, buffer + current, length - current, 0);
-						if (readBytes > 0)
-							current += readBytes;
-						retry++;
-					}
-					while (current < length);
-					pthread_mutex_unlock(&ipcLock);
-
-					msg = new Message();
-					if (msg != NULL)
-					{
-						msg->deserialize(buffer, length);
-
-						SCARD_DEBUG("<<<[RETRIEVE]<<< socket [%d], msg_length [%d]", socket, length);
-					}
-					else
-					{
-						SCARD_DEBUG_ERR("alloc failed");
-					}
-
-					delete []buffer;
+					SCARD_DEBUG("<<<[RETRIEVE]<<< socket [%d], msg [%d], length [%d]", socket, header.message, header.dataLength);
+
+					result = true;
 				}
 				else
 				{
-					SCARD_DEBUG_ERR("allocation failed");
+					SCARD_DEBUG_ERR("failed to recv data, socket [%d], length [%d]", socket, header.dataLength);
 				}
 			}
 			else
 			{
-				SCARD_DEBUG_ERR("invalid length, socket = [%d], msg_length = [%d]", socket, length);
+				SCARD_DEBUG_ERR("allocation failed, length [%d]", header.dataLength);
 			}
 		}
 		else
 		{
-			SCARD_DEBUG_ERR("failed to recv length, socket = [%d], readBytes [%d]", socket, readBytes);
+			SCARD_DEBUG_ERR("failed to recv header, socket [%d]", socket);
 		}
 
-
-		SCARD_END();
-
-		return msg;
+		return result;
 	}
 
 	void IPCHelper::setDispatcher(DispatcherHelper *dispatcher)
@@ -0,0 +1,234 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "IPCRing.h"
+
+namespace smartcard_service_api
+{
+	IPCRing::IPCRing()
+	{
+		header = NULL;
+		buffer = NULL;
+		size = 0;
+		doorbell = -1;
+	}
+
+	IPCRing::~IPCRing()
+	{
+		detach();
+	}
+
+	void IPCRing::attach(void *base, unsigned int size, int doorbell, bool initialize)
+	{
+		header = (ipc_ring_header_t *)base;
+		buffer = (unsigned char *)base + sizeof(ipc_ring_header_t);
+		this->size = size;
+		this->doorbell = doorbell;
+
+		if (initialize == true)
+		{
+			memset(header, 0, sizeof(*header));
+		}
+	}
+
+	void IPCRing::detach()
+	{
+		/* memory and doorbell are owned by IPCSharedMemory */
+		header = NULL;
+		buffer = NULL;
+		size = 0;
+		doorbell = -1;
+	}
+
+	void IPCRing::copyIn(unsigned int position, const void *data, unsigned int length)
+	{
+		unsigned int offset = position & (size - 1);
+		unsigned int first = size - offset;
+
+		if (first >= length)
+		{
+			memcpy(buffer + offset, data, length);
+		}
+		else
+		{
+			memcpy(buffer + offset, data, first);
+			memcpy(buffer, (const unsigned char *)data + first, length - first);
+		}
+	}
+
+	void IPCRing::copyOut(unsigned int position, void *data, unsigned int length)
+	{
+		unsigned int offset = position & (size - 1);
+		unsigned int first = size - offset;
+
+		if (first >= length)
+		{
+			memcpy(data, buffer + offset, length);
+		}
+		else
+		{
+			memcpy(data, buffer + offset, first);
+			memcpy((unsigned char *)data + first, buffer, length - first);
+		}
+	}
+
+	unsigned int IPCRing::getFrameLength(Message *msg)
+	{
+		return sizeof(message_header_t) + msg->data.getLength();
+	}
+
+	unsigned int IPCRing::getFreeSpace() const
+	{
+		unsigned int used;
+
+		used = header->head - header->tail;
+		__sync_synchronize();
+
+		return (used < size) ? size - used : 0;
+	}
+
+	bool IPCRing::isEmpty() const
+	{
+		return (header->head == header->tail);
+	}
+
+	bool IPCRing::pushMessage(Message *msg)
+	{
+		message_header_t frame;
+		unsigned int head;
+
+		msg->getHeader(&frame);
+
+		if (getFreeSpace() < sizeof(frame) + frame.dataLength)
+			return false;
+
+		/* only the producer moves head */
+		head = header->head;
+
+		copyIn(head, &frame, sizeof(frame));
+		if (frame.dataLength > 0)
+		{
+			copyIn(head + sizeof(frame), msg->data.getBuffer(), frame.dataLength);
+		}
+
+		/* frame is visible before head moves */
+		__sync_synchronize();
+		header->head = head + sizeof(frame) + frame.dataLength;
+		__sync_synchronize();
+
+		SCARD_DEBUG(">>>[RING]>>> msg [%d], length [%d]", frame.message, frame.dataLength);
+
+		/* the doorbell rings only for a sleeping consumer */
+		if (__sync_bool_compare_and_swap(&header->sleeping, 1, 0) == true)
+		{
+			ringDoorbell();
+		}
+
+		return true;
+	}
+
+	int IPCRing::popMessage(Message *msg)
+	{
+		message_header_t frame;
+		unsigned int head, tail, used;
+
+		/* positions are read once, the peer may write anything in there */
+		tail = header->tail;
+		head = header->head;
+		__sync_synchronize();
+
+		used = head - tail;
+		if (used == 0)
+			return 0;
+
+		if (used > size || used < sizeof(frame))
+		{
+			SCARD_DEBUG_ERR("invalid ring positions, head [%u], tail [%u]", head, tail);
+			return -1;
+		}
+
+		copyOut(tail, &frame, sizeof(frame));
+
+		if (frame.dataLength > used - sizeof(frame))
+		{
+			SCARD_DEBUG_ERR("invalid frame length [%u], used [%u]", frame.dataLength, used);
+			return -1;
+		}
+
+		msg->setHeader(&frame);
+
+		if (msg->data.allocBuffer(frame.dataLength) == false)
+		{
+			SCARD_DEBUG_ERR("allocation failed, length [%d]", frame.dataLength);
+			return -1;
+		}
+
+		if (frame.dataLength > 0)
+		{
+			copyOut(tail + sizeof(frame), msg->data.getBuffer(), frame.dataLength);
+		}
+
+		/* frame is copied out before the producer can reuse it */
+		__sync_synchronize();
+		header->tail = tail + sizeof(frame) + frame.dataLength;
+
+		SCARD_DEBUG("<<<[RING]<<< msg [%d], length [%d]", frame.message, frame.dataLength);
+
+		return 1;
+	}
+
+	bool IPCRing::prepareWait()
+	{
+		header->sleeping = 1;
+		__sync_synchronize();
+
+		/* a frame pushed before the flag was seen doesn't ring */
+		if (isEmpty() == false)
+		{
+			__sync_bool_compare_and_swap(&header->sleeping, 1, 0);
+
+			return false;
+		}
+
+		return true;
+	}
+
+	void IPCRing::clearDoorbell()
+	{
+		uint64_t count;
+
+		while (read(doorbell, &count, sizeof(count)) < 0 && errno == EINTR);
+	}
+
+	void IPCRing::ringDoorbell()
+	{
+		uint64_t count = 1;
+
+		while (write(doorbell, &count, sizeof(count)) < 0 && errno == EINTR);
+	}
+
+} /* namespace smartcard_service_api */
@@ -0,0 +1,272 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "IPCSharedMemory.h"
+
+/* older headers don't know about memfd and seals */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_GET_SEALS 1034
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+#define IPC_RING_RETRY 100 /* us, producer waits for the consumer */
+#define IPC_RING_TIMEOUT 3000 /* ms */
+
+namespace smartcard_service_api
+{
+	IPCSharedMemory::IPCSharedMemory()
+	{
+		memoryFd = -1;
+		doorbells[0] = -1;
+		doorbells[1] = -1;
+		base = MAP_FAILED;
+		length = 2 * (sizeof(ipc_ring_header_t) + RING_SIZE);
+		sendRing = NULL;
+		receiveRing = NULL;
+	}
+
+	IPCSharedMemory::~IPCSharedMemory()
+	{
+		release();
+	}
+
+	bool IPCSharedMemory::mapMemory()
+	{
+		base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+		if (base == MAP_FAILED)
+		{
+			SCARD_DEBUG_ERR("mmap failed, [%d]", errno);
+			return false;
+		}
+
+		return true;
+	}
+
+	void IPCSharedMemory::setRings(bool client, bool initialize)
+	{
+		unsigned char *position = (unsigned char *)base;
+		int i;
+
+		for (i = 0; i < 2; i++)
+		{
+			rings[i].attach(position, RING_SIZE, doorbells[i], initialize);
+			position += sizeof(ipc_ring_header_t) + RING_SIZE;
+		}
+
+		/* rings[0] carries requests, rings[1] responses and notifications */
+		sendRing = client ? &rings[0] : &rings[1];
+		receiveRing = client ? &rings[1] : &rings[0];
+	}
+
+	bool IPCSharedMemory::create()
+	{
+#ifdef SYS_memfd_create
+		memoryFd = syscall(SYS_memfd_create, "smartcard-ipc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#endif
+		if (memoryFd < 0)
+		{
+			SCARD_DEBUG_ERR("memfd is not supported");
+			return false;
+		}
+
+		if (ftruncate(memoryFd, length) < 0)
+		{
+			SCARD_DEBUG_ERR("ftruncate failed, [%d]", errno);
+			goto ERROR;
+		}
+
+		/* server refuses a segment which can be shrunk under it */
+		if (fcntl(memoryFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+		{
+			SCARD_DEBUG_ERR("sealing failed, [%d]", errno);
+			goto ERROR;
+		}
+
+		doorbells[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		doorbells[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (doorbells[0] < 0 || doorbells[1] < 0)
+		{
+			SCARD_DEBUG_ERR("eventfd failed, [%d]", errno);
+			goto ERROR;
+		}
+
+		if (mapMemory() == false)
+			goto ERROR;
+
+		setRings(true, true);
+
+		return true;
+
+ERROR :
+		release();
+
+		return false;
+	}
+
+	bool IPCSharedMemory::attach(int *fds, int count)
+	{
+		struct stat st;
+		int seals;
+
+		if (count != DESCRIPTOR_COUNT)
+		{
+			SCARD_DEBUG_ERR("invalid descriptors, count [%d]", count);
+
+			while (count > 0)
+				close(fds[--count]);
+
+			return false;
+		}
+
+		memoryFd = fds[0];
+		doorbells[0] = fds[1];
+		doorbells[1] = fds[2];
+
+		if (fstat(memoryFd, &st) < 0 || (size_t)st.st_size != length)
+		{
+			SCARD_DEBUG_ERR("invalid segment");
+			goto ERROR;
+		}
+
+		seals = fcntl(memoryFd, F_GET_SEALS);
+		if (seals < 0 || (seals & F_SEAL_SHRINK) == 0)
+		{
+			SCARD_DEBUG_ERR("segment is not sealed");
+			goto ERROR;
+		}
+
+		if (mapMemory() == false)
+			goto ERROR;
+
+		setRings(false, false);
+
+		return true;
+
+ERROR :
+		release();
+
+		return false;
+	}
+
+	void IPCSharedMemory::release()
+	{
+		int i;
+
+		rings[0].detach();
+		rings[1].detach();
+		sendRing = NULL;
+		receiveRing = NULL;
+
+		if (base != MAP_FAILED)
+		{
+			munmap(base, length);
+			base = MAP_FAILED;
+		}
+
+		if (memoryFd >= 0)
+		{
+			close(memoryFd);
+			memoryFd = -1;
+		}
+
+		for (i = 0; i < 2; i++)
+		{
+			if (doorbells[i] >= 0)
+			{
+				close(doorbells[i]);
+				doorbells[i] = -1;
+			}
+		}
+	}
+
+	void IPCSharedMemory::getDescriptors(int *fds)
+	{
+		fds[0] = memoryFd;
+		fds[1] = doorbells[0];
+		fds[2] = doorbells[1];
+	}
+
+	int IPCSharedMemory::sendMessage(Message *msg)
+	{
+		bool fit = (IPCRing::getFrameLength(msg) <= sendRing->getCapacity());
+		int retry = IPC_RING_TIMEOUT * 1000 / IPC_RING_RETRY;
+
+		while (true)
+		{
+			if (fit == true)
+			{
+				if (sendRing->pushMessage(msg) == true)
+					return 0;
+			}
+			else if (sendRing->isEmpty() == true)
+			{
+				/* nothing queued before it is left, order is kept on the socket */
+				return 1;
+			}
+
+			if (--retry < 0)
+			{
+				SCARD_DEBUG_ERR("ring is full, msg [%d]", msg->message);
+				return -1;
+			}
+
+			usleep(IPC_RING_RETRY);
+		}
+	}
+
+	int IPCSharedMemory::receiveMessage(Message *msg)
+	{
+		return receiveRing->popMessage(msg);
+	}
+
+	bool IPCSharedMemory::prepareWait()
+	{
+		return receiveRing->prepareWait();
+	}
+
+	void IPCSharedMemory::clearDoorbell()
+	{
+		receiveRing->clearDoorbell();
+	}
+
+	void IPCSharedMemory::rearmDoorbell()
+	{
+		receiveRing->ringDoorbell();
+	}
+
+} /* namespace smartcard_service_api */
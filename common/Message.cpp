@@ -33,6 +33,7 @@ namespace smartcard_service_api
 		param1 = 0;
 		param2 = 0;
 		error = 0;
+		requestId = 0;
 		caller = NULL;
 		callback = NULL;
 		userParam = NULL;
@@ -42,60 +43,40 @@ namespace smartcard_service_api
 	{
 	}
 
+	void Message::getHeader(message_header_t *header)
+	{
+		header->message = message;
+		header->param1 = param1;
+		header->param2 = param2;
+		header->error = error;
+		header->requestId = requestId;
+		header->dataLength = data.getLength();
+	}
+
+	void Message::setHeader(message_header_t *header)
+	{
+		message = header->message;
+		param1 = header->param1;
+		param2 = header->param2;
+		error = header->error;
+		requestId = header->requestId;
+	}
+
 	ByteArray Message::serialize()
 	{
 		ByteArray result;
-		unsigned int length = 0;
-		unsigned int dataLength = 0;
-		unsigned char *buffer = NULL;
+		message_header_t header;
 
-		length = sizeof(message) + sizeof(param1) + sizeof(param2) + sizeof(error) + sizeof(caller) + sizeof(callback) + sizeof(userParam);
-		if (data.getLength() > 0)
-		{
-			dataLength = data.getLength();
-			length += sizeof(dataLength) + data.getLength();
-		}
+		getHeader(&header);
 
-		buffer = new unsigned char[length];
-		if (buffer != NULL)
+		if (result.allocBuffer(sizeof(header) + header.dataLength) == true)
 		{
-			unsigned int current = 0;
-
-			memset(buffer, 0, length);
+			memcpy(result.getBuffer(), &header, sizeof(header));
 
-			memcpy(buffer + current, &message, sizeof(message));
-			current += sizeof(message);
-
-			memcpy(buffer + current, &param1, sizeof(param1));
-			current += sizeof(param1);
-
-			memcpy(buffer + current, &param2, sizeof(param2));
-			current += sizeof(param2);
-
-			memcpy(buffer + current, &error, sizeof(error));
-			current += sizeof(error);
-
-			memcpy(buffer + current, &caller, sizeof(caller));
-			current += sizeof(caller);
-
-			memcpy(buffer + current, &callback, sizeof(callback));
-			current += sizeof(callback);
-
-			memcpy(buffer + current, &userParam, sizeof(userParam));
-			current += sizeof(userParam);
-
-			if (data.getLength() > 0)
+			if (header.dataLength > 0)
 			{
-				memcpy(buffer + current, &dataLength, sizeof(dataLength));
-				current += sizeof(dataLength);
-
-				memcpy(buffer + current, data.getBuffer(), dataLength);
-				current += data.getLength();
+				memcpy(result.getBuffer(sizeof(header)), data.getBuffer(), header.dataLength);
 			}
-
-			result.setBuffer(buffer, length);
-
-			delete []buffer;
 		}
 		else
 		{
@@ -112,49 +93,25 @@ namespace smartcard_service_api
 
 	void Message::deserialize(unsigned char *buffer, unsigned int length)
 	{
-		unsigned int current = 0;
-		unsigned int dataLength = 0;
+		message_header_t header;
 
-//		SCARD_DEBUG("buffer [%p], length [%d]", buffer, length);
-
-		memcpy(&message, buffer + current, sizeof(message));
-		current += sizeof(message);
-
-//		SCARD_DEBUG("message [%d]", message);
-
-		memcpy(&param1, buffer + current, sizeof(param1));
-		current += sizeof(param1);
-
-//		SCARD_DEBUG("param1 [%d]", param1);
-
-		memcpy(&param2, buffer + current, sizeof(param2));
-		current += sizeof(param2);
-
-//		SCARD_DEBUG("param2 [%d]", param2);
-
-		memcpy(&error, buffer + current, sizeof(error));
-		current += sizeof(error);
-
-		memcpy(&caller, buffer + current, sizeof(caller));
-		current += sizeof(caller);
-
-		memcpy(&callback, buffer + current, sizeof(callback));
-		current += sizeof(callback);
+		if (buffer == NULL || length < sizeof(header))
+		{
+			SCARD_DEBUG_ERR("invalid buffer, length [%d]", length);
+			return;
+		}
 
-		memcpy(&userParam, buffer + current, sizeof(userParam));
-		current += sizeof(userParam);
+		memcpy(&header, buffer, sizeof(header));
 
-//		SCARD_DEBUG("userContext [%p]", userContext);
+		setHeader(&header);
 
-		if (current + sizeof(dataLength) < length)
+		if (header.dataLength > 0 && header.dataLength <= length - sizeof(header))
 		{
-			memcpy(&dataLength, buffer + current, sizeof(dataLength));
-			current += sizeof(dataLength);
-
-//			SCARD_DEBUG("dataLength [%d]", dataLength);
-
-			data.setBuffer(buffer + current, dataLength);
-			current += dataLength;
+			data.setBuffer(buffer + sizeof(header), header.dataLength);
+		}
+		else
+		{
+			data.releaseBuffer();
 		}
 	}
 
@@ -202,14 +159,118 @@ namespace smartcard_service_api
 			msg = "MSG_REQUEST_GET_CHANNEL_COUNT";
 			break;
 
+		case MSG_REQUEST_TRANSMIT_BATCH :
+			msg = "MSG_REQUEST_TRANSMIT_BATCH";
+			break;
+
+		case MSG_REQUEST_CLOSE_CHANNELS :
+			msg = "MSG_REQUEST_CLOSE_CHANNELS";
+			break;
+
 		default :
 			msg = "Unknown";
 			break;
 		}
 
-		snprintf(text, sizeof(text), "Message [%s, %d], param1 [%d], param2 [%d], error [%d], caller [%p], callback [%p], userParam [%p], data length [%d]", msg, message, param1, param2, error, caller, callback, userParam, data.getLength());
+		snprintf(text, sizeof(text), "Message [%s, %d], param1 [%d], param2 [%d], error [%d], request [%u], caller [%p], callback [%p], userParam [%p], data length [%d]", msg, message, param1, param2, error, requestId, caller, callback, userParam, data.getLength());
 
 		return (const char *)text;
 	}
 
+	unsigned int Message::getMaxDataLength(unsigned int message)
+	{
+		switch (message)
+		{
+		case MSG_REQUEST_TRANSMIT_BATCH :
+			/* each apdu of the list has its length in front */
+			return MAX_BATCH_COUNT * (sizeof(unsigned int) + MAX_APDU_LENGTH);
+
+		default :
+			/* one apdu or aid, with room for a length */
+			return sizeof(unsigned int) + MAX_APDU_LENGTH;
+		}
+	}
+
+	ByteArray Message::serializeList(vector<ByteArray> &list)
+	{
+		ByteArray result;
+		unsigned int length = 0;
+		unsigned char *buffer = NULL;
+		size_t i;
+
+		for (i = 0; i < list.size(); i++)
+		{
+			length += sizeof(unsigned int) + list[i].getLength();
+		}
+
+		if (length == 0)
+			return result;
+
+		buffer = new unsigned char[length];
+		if (buffer != NULL)
+		{
+			unsigned int current = 0;
+			unsigned int itemLength = 0;
+
+			for (i = 0; i < list.size(); i++)
+			{
+				itemLength = list[i].getLength();
+
+				memcpy(buffer + current, &itemLength, sizeof(itemLength));
+				current += sizeof(itemLength);
+
+				if (itemLength > 0)
+				{
+					memcpy(buffer + current, list[i].getBuffer(), itemLength);
+					current += itemLength;
+				}
+			}
+
+			result.setBuffer(buffer, length);
+
+			delete []buffer;
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("allocation failed");
+		}
+
+		return result;
+	}
+
+	bool Message::deserializeList(ByteArray &buffer, vector<ByteArray> &list)
+	{
+		unsigned int current = 0;
+		unsigned int itemLength = 0;
+
+		list.clear();
+
+		while (current + sizeof(itemLength) <= buffer.getLength())
+		{
+			memcpy(&itemLength, buffer.getBuffer(current), sizeof(itemLength));
+			current += sizeof(itemLength);
+
+			if (itemLength > buffer.getLength() - current)
+			{
+				SCARD_DEBUG_ERR("invalid item length [%d], remain [%d]", itemLength, buffer.getLength() - current);
+
+				list.clear();
+
+				return false;
+			}
+
+			if (itemLength > 0)
+			{
+				list.push_back(ByteArray(buffer.getBuffer(current), itemLength));
+				current += itemLength;
+			}
+			else
+			{
+				list.push_back(ByteArray());
+			}
+		}
+
+		return (current == buffer.getLength());
+	}
+
 } /* namespace smartcard_service_api */
@@ -111,7 +111,7 @@ namespace smartcard_service_api
 		APDUCommand();
 		~APDUCommand();
 
-		bool setCommand(unsigned char cla, unsigned char ins, unsigned char p1, unsigned char p2, ByteArray commandData, unsigned int maxResponseSize);
+		bool setCommand(unsigned char cla, unsigned char ins, unsigned char p1, unsigned char p2, const ByteArray &commandData, unsigned int maxResponseSize);
 		bool setCommand(const ByteArray &command);
 
 		bool setChannel(int type, int channelNum);
@@ -131,12 +131,27 @@ namespace smartcard_service_api
 		void setCommandData(const ByteArray &data);
 		ByteArray getCommandData();
 
+		/* 256 and 65536 are sent as zero */
 		void setMaxResponseSize(unsigned int maxResponseSize);
-		unsigned int setMaxResponseSize();
+		unsigned int getMaxResponseSize();
+		unsigned int setMaxResponseSize(); /* old name of getMaxResponseSize */
+
+		/* extended fields are also used without it when the lengths need them */
+		void setExtendedLength(bool extended);
 
 		bool getBuffer(ByteArray &array);
 	};
 
+	/* card capabilities from the historical bytes of the answer to reset */
+	class ATRHelper
+	{
+	public:
+		static bool getHistoricalBytes(const ByteArray &atr, ByteArray &historical);
+		static bool isExtendedLengthSupported(const ByteArray &atr);
+		/* largest le which may be asked at once */
+		static unsigned int getMaxResponseSize(const ByteArray &atr);
+	};
+
 	class APDUHelper
 	{
 	public:
@@ -152,7 +167,7 @@ namespace smartcard_service_api
 		static const int COMMAND_WRITE_BINARY = 10;
 		static const int COMMAND_WRITE_RECORD = 11;
 
-		static ByteArray generateAPDU(int command, int channel, ByteArray data);
+		static ByteArray generateAPDU(int command, int channel, const ByteArray &data);
 	};
 
 } /* namespace smartcard_service_api */
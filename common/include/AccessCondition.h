@@ -35,7 +35,10 @@ namespace smartcard_service_api
 	{
 	private :
 		bool permission;
-		map<ByteArray, ByteArray> mapApduFilters;
+		/* packed (header & mask, mask) pairs, header is CLA|INS|P1|P2 in big endian */
+		vector<uint32_t> apduFilters;
+
+		static uint32_t getHeader(const uint8_t *apdu);
 
 	public :
 		APDUAccessRule()
@@ -44,7 +47,7 @@ namespace smartcard_service_api
 		}
 
 		void loadAPDUAccessRule(const ByteArray &data);
-		bool isAuthorizedAccess(const ByteArray &command);
+		bool isAuthorizedAccess(const ByteArray &command) const;
 
 		void printAPDUAccessRules();
 	};
@@ -66,6 +69,8 @@ namespace smartcard_service_api
 		void printNFCAccessRules();
 	};
 
+	class AccessControlList;
+
 	class AccessCondition
 	{
 	private :
@@ -76,14 +81,17 @@ namespace smartcard_service_api
 		NFCAccessRule nfcRule;
 
 	public :
+		friend class AccessControlList;
+
 		AccessCondition() : permission(false)
 		{
 		}
 
 		void loadAccessCondition(ByteArray &aid, ByteArray &data);
-		bool isAuthorizedAccess(ByteArray &certHash);
-		bool isAuthorizedAPDUAccess(ByteArray &command);
+		bool isAuthorizedAccess(const ByteArray &certHash);
+		bool isAuthorizedAPDUAccess(const ByteArray &command);
 		bool isAuthorizedNFCAccess();
+		inline const APDUAccessRule &getAPDUAccessRule() const { return apduRule; }
 
 		void printAccessConditions();
 	};
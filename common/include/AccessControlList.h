@@ -27,6 +27,7 @@
 /* local header */
 #include "ByteArray.h"
 #include "Channel.h"
+#include "Lock.h"
 
 using namespace std;
 
@@ -34,15 +35,59 @@ namespace smartcard_service_api
 {
 	class Terminal;
 	class AccessCondition;
+	class APDUAccessRule;
 
 	class AccessControlList
 	{
+	private:
+		/* flat open addressing index of (aid, hash) -> decision,
+		 * an empty hash stands for "any other hash" of that aid */
+		typedef struct _index_entry_t
+		{
+			unsigned int key;
+			bool used;
+			bool permission;
+			ByteArray aid;
+			ByteArray certHash;
+			const AccessCondition *condition;
+		}
+		index_entry_t;
+
+		/* direct mapped cache of final decisions */
+		typedef struct _decision_entry_t
+		{
+			unsigned int generation;
+			bool permission;
+			ByteArray aid;
+			ByteArray certHash;
+		}
+		decision_entry_t;
+
+		static const unsigned int DECISION_CACHE_SIZE = 64;
+
+		PMutex indexLock;
+		vector<index_entry_t> index;
+		unsigned int indexMask;
+		unsigned int indexGeneration;
+		unsigned int generation;
+		decision_entry_t decisions[DECISION_CACHE_SIZE];
+
+		void initIndex();
+		static unsigned int hashKey(const ByteArray &aid, const ByteArray &certHash);
+
+		void compileIndex();
+		void insertIndex(const ByteArray &aid, const ByteArray &certHash, bool permission, const AccessCondition *condition);
+		const index_entry_t *findIndex(const ByteArray &aid, const ByteArray &certHash) const;
+		const index_entry_t *lookupIndex(const ByteArray &aid, const ByteArray &certHash);
+
 	protected:
 		map<ByteArray, AccessCondition> mapConditions;
 		Channel *channel;
 		Terminal *terminal;
 
 		void printAccessControlList();
+		/* must be called whenever mapConditions changes */
+		void invalidateIndex();
 
 	public:
 		static ByteArray AID_ALL;
@@ -57,12 +102,15 @@ namespace smartcard_service_api
 		virtual int setTerminal(Terminal *terminal) { this->terminal = terminal; return 0; }
 
 		virtual int loadACL() = 0;
+		/* false only if the rules on the card are known to be the loaded ones */
+		virtual bool isChanged() { return true; }
 
 		int updateACL();
 		void releaseACL();
 
-		bool isAuthorizedAccess(ByteArray aid, ByteArray certHash);
+		bool isAuthorizedAccess(const ByteArray &aid, const ByteArray &certHash);
 		bool isAuthorizedAccess(unsigned char *aidBuffer, unsigned int aidLength, unsigned char *certHashBuffer, unsigned int certHashLength);
+		bool getAPDUAccessRule(const ByteArray &aid, const ByteArray &certHash, APDUAccessRule &rule);
 	};
 
 } /* namespace smartcard_service_api */
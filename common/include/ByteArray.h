@@ -30,28 +30,69 @@
 
 namespace smartcard_service_api
 {
+	class ByteArray;
+
+	/* non-owning read-only window, valid while the source buffer is alive */
+	class ByteArrayView
+	{
+	private:
+		const uint8_t *buffer;
+		uint32_t length;
+
+	public:
+		ByteArrayView() : buffer(0), length(0) {}
+		ByteArrayView(const uint8_t *array, uint32_t bufferLen) : buffer(array), length(bufferLen) {}
+		ByteArrayView(const ByteArray &T);
+
+		inline uint32_t getLength() const { return length; }
+		inline const uint8_t *getBuffer() const { return buffer; }
+		inline bool isEmpty() const { return (buffer == 0 || length == 0); }
+
+		ByteArrayView subView(uint32_t offset, uint32_t subLength) const;
+
+		bool operator ==(const ByteArrayView &T) const;
+		inline bool operator !=(const ByteArrayView &T) const { return !(*this == T); }
+		uint8_t operator [](uint32_t index) const;
+	};
+
 	class ByteArray //: public Serializable
 	{
+	public:
+		/* short APDUs and status words are kept inline without heap allocation */
+		static const uint32_t INLINE_LENGTH = 48;
+
 	protected:
+		/* heap buffers are shared between copies and must not be modified,
+		 * allocBuffer() returns a private buffer which may be filled */
 		uint8_t *buffer;
 		uint32_t length;
-		char strBuffer[100];
 
-		bool _setBuffer(uint8_t *array, uint32_t bufferLen);
 		void save(const char *filePath);
 
+	private:
+		uint8_t inlineBuffer[INLINE_LENGTH];
+
+		static uint8_t *allocStorage(uint32_t bufferLen);
+		inline bool isInline() const { return (buffer == inlineBuffer); }
+		void attach(const ByteArray &T);
+
 	public:
 		static ByteArray EMPTY;
 
 		ByteArray();
 		ByteArray(uint8_t *array, uint32_t bufferLen);
 		ByteArray(const ByteArray &T);
+		explicit ByteArray(const ByteArrayView &T);
+#if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
+		ByteArray(ByteArray &&T);
+#endif
 		~ByteArray();
 
 //		ByteArray serialize();
 //		void deserialize(ByteArray buffer);
 
-		bool setBuffer(uint8_t *array, uint32_t bufferLen);
+		bool setBuffer(const uint8_t *array, uint32_t bufferLen);
+		bool allocBuffer(uint32_t bufferLen);
 		void releaseBuffer();
 
 		uint32_t getLength() const;
@@ -65,17 +106,24 @@ namespace smartcard_service_api
 
 		/* operator overloading */
 		ByteArray &operator =(const ByteArray &T);
+#if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
+		ByteArray &operator =(ByteArray &&T);
+#endif
 		ByteArray operator +(const ByteArray &T);
 		ByteArray &operator +=(const ByteArray &T);
 		bool operator ==(const ByteArray &T) const;
 		bool operator !=(const ByteArray &T) const;
 		bool operator <(const ByteArray &T) const;
 		bool operator >(const ByteArray &T) const;
-		uint8_t &operator [](uint32_t index) const;
+		uint8_t operator [](uint32_t index) const;
 
-		inline bool isEmpty() { return (buffer == (void *)0 || length == 0); }
-		const char *toString();
+		inline bool isEmpty() const { return (buffer == (void *)0 || length == 0); }
+
+		/* returns a per-thread rotating buffer, valid for a few following calls */
+		const char *toString() const;
 	};
 
+	inline ByteArrayView::ByteArrayView(const ByteArray &T) : buffer(T.getBuffer()), length(T.getLength()) {}
+
 } /* namespace smartcard_service_api */
 #endif /* BYTEARRAY_H_ */
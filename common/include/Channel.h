@@ -19,6 +19,7 @@
 #define CHANNEL_H_
 
 /* standard library header */
+#include <vector>
 
 /* SLP library header */
 
@@ -26,12 +27,17 @@
 #include "Synchronous.h"
 #include "ByteArray.h"
 
+using namespace std;
+
 namespace smartcard_service_api
 {
 	class SessionHelper;	/* explicit declaration */
 
 	typedef void (*transmitCallback)(unsigned char *buffer, unsigned int length, int error, void *userParam);
 	typedef void (*closeCallback)(int error, void *userParam);
+	/* chainedCount is the number of apdus the daemon added to complete 61xx and 6Cxx */
+	typedef void (*transmitChainedCallback)(unsigned char *buffer, unsigned int length, unsigned int chainedCount, int error, void *userParam);
+	typedef void (*transmitBatchCallback)(unsigned char **buffers, unsigned int *lengths, unsigned int count, unsigned int chainedCount, int error, void *userParam);
 
 	class Channel : public Synchronous
 	{
@@ -39,18 +45,46 @@ namespace smartcard_service_api
 		ByteArray selectResponse;
 		SessionHelper *session;
 		int channelNum;
+		unsigned int maxResponseSize; /* largest le the card takes, short length by default */
 
 		Channel() : Synchronous()
 		{
 			channelNum = -1;
+			maxResponseSize = 256;
 		}
 		Channel(SessionHelper *session) : Synchronous()
 		{
 			this->session = session;
+			maxResponseSize = 256;
 		}
 
 		virtual void closeSync() = 0;
-		virtual int transmitSync(ByteArray command, ByteArray &result) = 0;
+		virtual int transmitSync(const ByteArray &command, ByteArray &result) = 0;
+
+		/* commands run in order until one fails or returns other than 9000,
+		 * results has the responses of executed ones */
+		virtual int transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results)
+		{
+			int rv = 0;
+			size_t i;
+
+			results.clear();
+
+			for (i = 0; i < commands.size(); i++)
+			{
+				ByteArray response;
+
+				if ((rv = transmitSync(commands[i], response)) != 0)
+					break;
+
+				results.push_back(response);
+
+				if (response.getLength() < 2 || response[response.getLength() - 2] != 0x90 || response[response.getLength() - 1] != 0x00)
+					break;
+			}
+
+			return rv;
+		}
 
 	public:
 		virtual ~Channel() {}
@@ -61,7 +95,9 @@ namespace smartcard_service_api
 
 		inline ByteArray getSelectResponse() const { return selectResponse; }
 		inline SessionHelper *getSession() const { return session; }
-		virtual int transmit(ByteArray command, transmitCallback callback, void *userData) = 0;
+		inline unsigned int getMaxResponseSize() const { return maxResponseSize; }
+		inline void setMaxResponseSize(unsigned int size) { maxResponseSize = size; }
+		virtual int transmit(const ByteArray &command, transmitCallback callback, void *userData) = 0;
 
 		friend class FileObject;
 		friend class ServerSession;
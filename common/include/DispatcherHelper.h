@@ -36,23 +36,25 @@ namespace smartcard_service_api
 	{
 	private:
 		pthread_t dispatcherThread;
+		bool stopping; /* under syncLock */
 
 		queue<DispatcherMsg *> messageQ;
 
 		static void *_dispatcherThreadFunc(void *data);
 
-		DispatcherMsg *fetchMessage();
-
 	protected:
+		/* called with syncLock held */
+		virtual DispatcherMsg *fetchMessage();
 		virtual void *dispatcherThreadFunc(DispatcherMsg *msg, void *data) = 0;
 
 	public:
 		DispatcherHelper();
-		~DispatcherHelper();
+		virtual ~DispatcherHelper();
 
 		void clearQueue();
+		void removeMessages(int peerSocket);
 
-		void pushMessage(DispatcherMsg *msg);
+		virtual void pushMessage(DispatcherMsg *msg);
 
 		bool runDispatcherThread();
 		void stopDispatcherThread();
@@ -45,6 +45,7 @@ namespace smartcard_service_api
 			param1 = msg->param1;
 			param2 = msg->param2;
 			error = msg->error;
+			requestId = msg->requestId;
 			data = msg->data;
 			caller = msg->caller;
 			callback = msg->callback;
@@ -58,6 +59,7 @@ namespace smartcard_service_api
 			param1 = msg->param1;
 			param2 = msg->param2;
 			error = msg->error;
+			requestId = msg->requestId;
 			data = msg->data;
 			caller = msg->caller;
 			callback = msg->callback;
@@ -0,0 +1,76 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef FUTURE_H_
+#define FUTURE_H_
+
+/* standard library header */
+#include <pthread.h>
+#include <time.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Message.h"
+
+namespace smartcard_service_api
+{
+	/* one shot result of a request. the requester waits on it, the reply side completes it.
+	 * meant to be embedded in the waiter's frame, nothing is allocated */
+	class Future
+	{
+	private:
+		pthread_mutex_t mutex;
+		pthread_cond_t condition;
+		int state;
+
+	public:
+		static const int STATE_PENDING = 0;
+		static const int STATE_COMPLETED = 1;
+		static const int STATE_CANCELLED = 2;
+
+		static const int WAIT_COMPLETED = 0;
+		static const int WAIT_CANCELLED = -1;
+		static const int WAIT_TIMEOUT = -2;
+
+		/* reply, valid once completed */
+		int error;
+		unsigned int param1;
+		unsigned int param2;
+		ByteArray data;
+
+		Future();
+		~Future();
+
+		void reset();
+
+		/* false if it is completed or cancelled already */
+		bool complete(Message *msg);
+		bool cancel();
+
+		int getState();
+
+		/* deadline on CLOCK_MONOTONIC, NULL waits forever */
+		int waitUntil(const struct timespec *deadline);
+		/* milliseconds, 0 waits forever */
+		int wait(int timeout);
+
+		static void getDeadline(int timeout, struct timespec *deadline);
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* FUTURE_H_ */
@@ -37,18 +37,28 @@ namespace smartcard_service_api
 	private:
 		PKCS15 *pkcs15;
 		ByteArray refreshTag;
+		ByteArray mainFilePath;
+		/* pairs of aid and access condition file, kept for the cache file */
+		vector<ByteArray> conditionFiles;
 
 		static ByteArray OID_GLOBALPLATFORM;
 
 		int loadAccessControl(PKCS15DODF *dodf);
+		int readMainFile(const ByteArray &path, ByteArray &refreshTag, ByteArray &rulesPath);
 		int loadRules(ByteArray path);
 		int loadAccessConditions(ByteArray aid, ByteArray path);
+		void addAccessCondition(ByteArray &aid, ByteArray &data);
+
+		void getCacheFilePath(char *filePath, size_t length);
+		int loadCache();
+		void saveCache();
 
 	public:
 		GPSEACL(Channel *channel);
 		~GPSEACL();
 
 		int loadACL();
+		bool isChanged();
 
 	};
 
@@ -44,21 +44,31 @@ namespace smartcard_service_api
 
 		static gboolean channelCallbackFunc(GIOChannel* channel, GIOCondition condition, gpointer data);
 
+		bool openListenSocket();
+		void closeListenSocket();
+		/* no locking, callers serialize writers and readers of a socket */
+		static bool sendFrame(int socket, Message *msg, int *fds = NULL, int count = 0);
+		static bool recvFrame(int socket, Message *msg);
+
+		/* connected, no watch yet. the socket is not shared with other threads */
+		virtual void negotiateTransport() {}
+
 		virtual int handleIOErrorCondition(void *channel, GIOCondition condition) = 0;
 		virtual int handleInvalidSocketCondition(void *channel, GIOCondition condition) = 0;
 		virtual int handleIncomingCondition(void *channel, GIOCondition condition) = 0;
 
 	public:
 		IPCHelper();
-		~IPCHelper();
+		virtual ~IPCHelper();
 
-		bool createListenSocket();
+		virtual bool createListenSocket();
 		bool createConnectSocket();
 
 		bool sendMessage(Message *msg);
-		bool sendMessage(int socket, Message *msg);
+		virtual bool sendMessage(int socket, Message *msg);
 		Message *retrieveMessage();
 		Message *retrieveMessage(int socket);
+		bool retrieveMessage(int socket, Message *msg);
 
 		void setDispatcher(DispatcherHelper *dispatcher);
 
@@ -0,0 +1,79 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef IPCRING_H_
+#define IPCRING_H_
+
+/* standard library header */
+
+/* SLP library header */
+
+/* local header */
+#include "Message.h"
+
+namespace smartcard_service_api
+{
+	/* control block of a ring, lives in memory shared by both processes */
+	typedef struct _ipc_ring_header_t
+	{
+		volatile unsigned int head; /* written by the producer */
+		unsigned char reserved1[60];
+		volatile unsigned int tail; /* written by the consumer */
+		volatile unsigned int sleeping; /* consumer waits for the doorbell */
+		unsigned char reserved2[56];
+	} ipc_ring_header_t;
+
+	/* single producer, single consumer ring of message frames, framed like the socket */
+	class IPCRing
+	{
+	private:
+		ipc_ring_header_t *header;
+		unsigned char *buffer;
+		unsigned int size;
+		int doorbell;
+
+		void copyIn(unsigned int position, const void *data, unsigned int length);
+		void copyOut(unsigned int position, void *data, unsigned int length);
+
+	public:
+		IPCRing();
+		~IPCRing();
+
+		/* size must be a power of two */
+		void attach(void *base, unsigned int size, int doorbell, bool initialize);
+		void detach();
+		inline bool isAttached() const { return (header != NULL); }
+
+		inline unsigned int getCapacity() const { return size; }
+		inline int getDoorbell() const { return doorbell; }
+		unsigned int getFreeSpace() const;
+		bool isEmpty() const;
+
+		/* producer side, false if the frame doesn't fit now */
+		bool pushMessage(Message *msg);
+
+		/* consumer side, 1 : popped, 0 : empty, -1 : corrupted by the peer */
+		int popMessage(Message *msg);
+		bool prepareWait();
+		void clearDoorbell();
+		void ringDoorbell();
+
+		static unsigned int getFrameLength(Message *msg);
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* IPCRING_H_ */
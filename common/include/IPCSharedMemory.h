@@ -0,0 +1,73 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef IPCSHAREDMEMORY_H_
+#define IPCSHAREDMEMORY_H_
+
+/* standard library header */
+#include <stddef.h>
+
+/* SLP library header */
+
+/* local header */
+#include "IPCRing.h"
+
+namespace smartcard_service_api
+{
+	/* memfd backed ring pair of a connection, request ring is written by the client */
+	class IPCSharedMemory
+	{
+	private:
+		int memoryFd;
+		int doorbells[2]; /* request, response */
+		void *base;
+		size_t length;
+		IPCRing *sendRing;
+		IPCRing *receiveRing;
+		IPCRing rings[2];
+
+		bool mapMemory();
+		void setRings(bool client, bool initialize);
+
+	public:
+		static const unsigned int RING_SIZE = 128 * 1024;
+		static const int DESCRIPTOR_COUNT = 3;
+
+		IPCSharedMemory();
+		~IPCSharedMemory();
+
+		/* client side, new segment and doorbells */
+		bool create();
+		/* server side, takes ownership of the descriptors */
+		bool attach(int *fds, int count);
+		void release();
+
+		void getDescriptors(int *fds);
+		inline int getReceiveDoorbell() const { return receiveRing->getDoorbell(); }
+
+		/* 0 : queued, 1 : too big for the ring, the ring is drained so it may go to the socket, -1 : timeout */
+		int sendMessage(Message *msg);
+		/* 1 : popped, 0 : empty, -1 : corrupted */
+		int receiveMessage(Message *msg);
+
+		bool prepareWait();
+		void clearDoorbell();
+		void rearmDoorbell();
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* IPCSHAREDMEMORY_H_ */
@@ -46,6 +46,28 @@ namespace smartcard_service_api
 		inline void lock() { pthread_mutex_lock(&mutex); }
 		inline void unlock() { pthread_mutex_unlock(&mutex); }
 	};
+
+	class PRecursiveMutex : public Lock
+	{
+	private:
+		pthread_mutex_t mutex;
+
+	public:
+		PRecursiveMutex()
+		{
+			pthread_mutexattr_t attr;
+
+			pthread_mutexattr_init(&attr);
+			pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+			pthread_mutex_init(&mutex, &attr);
+			pthread_mutexattr_destroy(&attr);
+		}
+		~PRecursiveMutex() { pthread_mutex_destroy(&mutex); }
+
+		inline void lock() { pthread_mutex_lock(&mutex); }
+		inline void unlock() { pthread_mutex_unlock(&mutex); }
+	};
+
 #define TOKENPASTE(x, y) x ## y
 #define TOKENPASTE2(x, y) TOKENPASTE(x, y)
 #define SCOPE_LOCK(X) \
@@ -19,14 +19,28 @@
 #define MESSAGE_H_
 
 /* standard library header */
+#include <vector>
 
 /* SLP library header */
 
 /* local header */
 #include "Serializable.h"
 
+using namespace std;
+
 namespace smartcard_service_api
 {
+	/* fixed size header on the wire, followed by dataLength bytes of payload */
+	typedef struct _message_header_t
+	{
+		unsigned int message;
+		unsigned int param1;
+		unsigned int param2;
+		int error;
+		unsigned int requestId; /* echoed in the response, 0 for notifications */
+		unsigned int dataLength;
+	} __attribute__((packed)) message_header_t;
+
 	class Message: public Serializable
 	{
 	private:
@@ -42,17 +56,34 @@ namespace smartcard_service_api
 		static const int MSG_REQUEST_GET_ATR = 0x86;
 		static const int MSG_REQUEST_TRANSMIT = 0x87;
 		static const int MSG_REQUEST_GET_CHANNEL_COUNT = 0x88;
+		static const int MSG_REQUEST_TRANSMIT_BATCH = 0x89;
+		static const int MSG_REQUEST_CLOSE_CHANNELS = 0x8A;
 
 		static const int MSG_NOTIFY_SE_REMOVED = 0x90;
 		static const int MSG_NOTIFY_SE_INSERTED = 0x91;
 
 		static const int MSG_OPERATION_RELEASE_CLIENT = 0xC0;
+		static const int MSG_OPERATION_UPDATE_ACL = 0xC1;
+		static const int MSG_OPERATION_ATTACH_SHM = 0xC2;
+
+		/* MSG_REQUEST_TRANSMIT_BATCH options, param2 */
+		static const unsigned int TRANSMIT_BATCH_STOP_ON_ERROR = 0x01;
+		/* MSG_REQUEST_TRANSMIT and MSG_REQUEST_TRANSMIT_BATCH options, param2.
+		 * 61xx and 6Cxx are completed by the daemon, the reply has the number of extra apdus in param2 */
+		static const unsigned int TRANSMIT_AUTO_GET_RESPONSE = 0x02;
+
+		/* extended case 4 apdu, header, lc, 65535 bytes of data and le */
+		static const unsigned int MAX_APDU_LENGTH = 4 + 3 + 65535 + 2;
+		/* commands in one MSG_REQUEST_TRANSMIT_BATCH, longer lists are refused */
+		static const unsigned int MAX_BATCH_COUNT = 32;
 
 		unsigned int message;
 		unsigned int param1;
 		unsigned int param2;
 		ByteArray data;
 		int error;
+		unsigned int requestId;
+		/* local to a process, never sent */
 		void *caller;
 		void *callback;
 		void *userParam;
@@ -64,7 +95,17 @@ namespace smartcard_service_api
 		void deserialize(unsigned char *buffer, unsigned int length);
 		void deserialize(ByteArray buffer);
 
+		void getHeader(message_header_t *header);
+		void setHeader(message_header_t *header);
+
 		const char *toString();
+
+		/* [length][bytes] list, used for batched apdus */
+		static ByteArray serializeList(vector<ByteArray> &list);
+		static bool deserializeList(ByteArray &buffer, vector<ByteArray> &list);
+
+		/* largest payload of a request of the type, the daemon drops clients sending more */
+		static unsigned int getMaxDataLength(unsigned int message);
 	};
 
 } /* namespace smartcard_service_api */
@@ -61,10 +61,10 @@ namespace smartcard_service_api
 
 		virtual bool isSecureElementPresence() = 0;
 
-		virtual int transmitSync(ByteArray command, ByteArray &result) = 0;
+		virtual int transmitSync(const ByteArray &command, ByteArray &result) = 0;
 		virtual int getATRSync(ByteArray &atr) = 0;
 
-		virtual int transmit(ByteArray command, terminalTransmitCallback callback, void *userData) = 0;
+		virtual int transmit(const ByteArray &command, terminalTransmitCallback callback, void *userData) = 0;
 		virtual int getATR(terminalGetATRCallback callback, void *userData) = 0;
 	};
 
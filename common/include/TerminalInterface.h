@@ -59,4 +59,27 @@ typedef const char *(*terminal_get_name_fn)();
 typedef void *(*terminal_create_instance_fn)();
 typedef void (*terminal_destroy_instance_fn)(void *);
 
+/* plugin abi, version 2 adds the symbols below next to create_instance.
+ * a plugin without get_abi_version is version 1, only transmitSync is used */
+#define TERMINAL_ABI_VERSION			2
+
+#define TERMINAL_SYMBOL_GET_ABI_VERSION		"get_abi_version"
+#define TERMINAL_SYMBOL_GET_CAPABILITIES	"get_capabilities"
+#define TERMINAL_SYMBOL_GET_EVENT_FD		"get_event_fd"
+#define TERMINAL_SYMBOL_PROCESS_EVENTS		"process_events"
+
+/* capabilities of an instance
+ * ASYNC_TRANSMIT : Terminal::transmit returns without waiting for the card,
+ *   the callback is called once with the response, never from inside transmit.
+ *   one command is submitted at a time.
+ * POLLABLE_FD : callbacks are called only from process_events, which the daemon
+ *   calls from its event loop when the fd of get_event_fd is readable */
+#define TERMINAL_CAP_ASYNC_TRANSMIT		0x00000001
+#define TERMINAL_CAP_POLLABLE_FD		0x00000002
+
+typedef int (*terminal_get_abi_version_fn)();
+typedef unsigned int (*terminal_get_capabilities_fn)(void *instance);
+typedef int (*terminal_get_event_fd_fn)(void *instance);
+typedef void (*terminal_process_events_fn)(void *instance);
+
 #endif /* TERMINALINTERFACE_H_ */
@@ -38,6 +38,8 @@ typedef void (*session_close_session_cb)(int error, void *user_data);
 typedef void (*session_get_channel_count_cb)(unsigned count, int error, void *user_data);
 
 typedef void (*channel_transmit_cb)(unsigned char *buffer, unsigned int length, int error, void *user_data);
+typedef void (*channel_transmit_chained_cb)(unsigned char *buffer, unsigned int length, unsigned int chained_count, int error, void *user_data);
+typedef void (*channel_transmit_batch_cb)(unsigned char **buffers, unsigned int *lengths, unsigned int count, unsigned int chained_count, int error, void *user_data);
 typedef void (*channel_close_cb)(int error, void *user_data);
 
 #endif /* SMARTCARD_TYPES_H_ */
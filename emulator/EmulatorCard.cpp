@@ -0,0 +1,776 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <stdio.h>
+#include <string.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "APDUHelper.h"
+#include "EmulatorCard.h"
+
+#define SW_SUCCESS			0x9000
+#define SW_BYTES_REMAINING		0x6100
+#define SW_END_OF_FILE			0x6282
+#define SW_WRONG_LENGTH			0x6700
+#define SW_CHANNEL_NOT_SUPPORTED	0x6881
+#define SW_INCOMPATIBLE_FILE		0x6981
+#define SW_CONDITIONS_NOT_SATISFIED	0x6985
+#define SW_NO_CURRENT_EF		0x6986
+#define SW_FUNCTION_NOT_SUPPORTED	0x6A81
+#define SW_FILE_NOT_FOUND		0x6A82
+#define SW_INCORRECT_P1P2		0x6A86
+#define SW_DATA_NOT_FOUND		0x6A88
+#define SW_WRONG_OFFSET			0x6B00
+#define SW_CORRECT_LENGTH		0x6C00
+#define SW_INS_NOT_SUPPORTED		0x6D00
+#define SW_CLA_NOT_SUPPORTED		0x6E00
+
+namespace smartcard_service_api
+{
+	/* pkcs #15 application, gp secure element access control files.
+	 * paths in the files are fids relative to the pkcs #15 df */
+	static unsigned char aid_pkcs15[] = { 0xA0, 0x00, 0x00, 0x00, 0x63, 0x50, 0x4B, 0x43, 0x53, 0x2D, 0x31, 0x35 };
+
+	static unsigned char ef_dir[] = { 0x61, 0x0E, 0x4F, 0x0C,
+		0xA0, 0x00, 0x00, 0x00, 0x63, 0x50, 0x4B, 0x43, 0x53, 0x2D, 0x31, 0x35 };
+
+	/* DODF path 5207 */
+	static unsigned char ef_odf[] = { 0xA7, 0x06, 0x30, 0x04, 0x04, 0x02, 0x52, 0x07 };
+
+	/* oid 1.2.840.114283.200.1.1, access control main file path 4300 */
+	static unsigned char ef_dodf[] = { 0xA1, 0x18, 0x30, 0x00,
+		0xA1, 0x14, 0x30, 0x12,
+		0x06, 0x0A, 0x2A, 0x86, 0x48, 0x86, 0xFC, 0x6B, 0x81, 0x48, 0x01, 0x01,
+		0x30, 0x04, 0x04, 0x02, 0x43, 0x00 };
+
+	/* refresh tag, access control rules file path 4310 */
+	static unsigned char ef_acmain[] = { 0x30, 0x10,
+		0x04, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+		0x30, 0x04, 0x04, 0x02, 0x43, 0x10 };
+
+	/* any application, access conditions file path 4320 */
+	static unsigned char ef_acrules[] = { 0x30, 0x08, 0x82, 0x00, 0x30, 0x04, 0x04, 0x02, 0x43, 0x20 };
+
+	/* access granted for all applications */
+	static unsigned char ef_acconditions[] = { 0x30, 0x00 };
+
+	/* T=1, no historical bytes */
+	static unsigned char default_atr[] = { 0x3B, 0x80, 0x80, 0x01, 0x01 };
+
+	static ByteArray getAppletFCI(const ByteArray &aid)
+	{
+		ByteArray result;
+		unsigned char buffer[20];
+
+		buffer[0] = 0x6F;
+		buffer[1] = aid.getLength() + 2;
+		buffer[2] = 0x84;
+		buffer[3] = aid.getLength();
+		memcpy(buffer + 4, aid.getBuffer(), aid.getLength());
+
+		result.setBuffer(buffer, aid.getLength() + 4);
+
+		return result;
+	}
+
+	EmulatorFile::EmulatorFile(EmulatorFile *parent, unsigned int fid, bool dedicated)
+	{
+		this->parent = parent;
+		this->fid = fid;
+		this->sfi = 0;
+		this->dedicated = dedicated;
+
+		if (parent != NULL)
+		{
+			parent->children.push_back(this);
+		}
+	}
+
+	EmulatorFile::~EmulatorFile()
+	{
+		size_t i;
+
+		for (i = 0; i < children.size(); i++)
+		{
+			delete children[i];
+		}
+	}
+
+	EmulatorFile *EmulatorFile::getChild(unsigned int fid)
+	{
+		size_t i;
+
+		for (i = 0; i < children.size(); i++)
+		{
+			if (children[i]->fid == fid)
+				return children[i];
+		}
+
+		return NULL;
+	}
+
+	EmulatorFile *EmulatorFile::getChildBySFI(unsigned int sfi)
+	{
+		size_t i;
+
+		for (i = 0; i < children.size(); i++)
+		{
+			if (children[i]->sfi != 0 && children[i]->sfi == sfi)
+				return children[i];
+		}
+
+		return NULL;
+	}
+
+	EmulatorFile *EmulatorFile::findByName(const ByteArray &name)
+	{
+		EmulatorFile *result = NULL;
+		size_t i;
+
+		if (dedicated == true && this->name.isEmpty() == false && this->name == name)
+			return this;
+
+		for (i = 0; i < children.size() && result == NULL; i++)
+		{
+			result = children[i]->findByName(name);
+		}
+
+		return result;
+	}
+
+	ByteArray EmulatorFile::getFCP()
+	{
+		ByteArray result;
+		unsigned char buffer[64];
+		unsigned int length = 2;
+
+		/* file descriptor */
+		buffer[length++] = 0x82;
+		buffer[length++] = 0x01;
+		buffer[length++] = dedicated ? 0x38 : 0x01;
+
+		/* file identifier */
+		buffer[length++] = 0x83;
+		buffer[length++] = 0x02;
+		buffer[length++] = (fid >> 8) & 0xFF;
+		buffer[length++] = fid & 0xFF;
+
+		if (dedicated == true)
+		{
+			if (name.isEmpty() == false && name.getLength() <= 16)
+			{
+				buffer[length++] = 0x84;
+				buffer[length++] = name.getLength();
+				memcpy(buffer + length, name.getBuffer(), name.getLength());
+				length += name.getLength();
+			}
+		}
+		else
+		{
+			/* file size */
+			buffer[length++] = 0x80;
+			buffer[length++] = 0x02;
+			buffer[length++] = (data.getLength() >> 8) & 0xFF;
+			buffer[length++] = data.getLength() & 0xFF;
+
+			if (sfi != 0)
+			{
+				buffer[length++] = 0x88;
+				buffer[length++] = 0x01;
+				buffer[length++] = sfi << 3;
+			}
+		}
+
+		buffer[0] = 0x62;
+		buffer[1] = length - 2;
+
+		result.setBuffer(buffer, length);
+
+		return result;
+	}
+
+	EmulatorCard::EmulatorCard()
+	{
+		masterFile = NULL;
+		maxChannels = 4;
+		atr.setBuffer(ARRAY_AND_SIZE(default_atr));
+
+		buildFileSystem();
+		reset();
+	}
+
+	EmulatorCard::~EmulatorCard()
+	{
+		if (masterFile != NULL)
+		{
+			delete masterFile;
+			masterFile = NULL;
+		}
+	}
+
+	void EmulatorCard::buildFileSystem()
+	{
+		EmulatorFile *df, *ef;
+
+		masterFile = new EmulatorFile(NULL, 0x3F00, true);
+
+		ef = new EmulatorFile(masterFile, 0x2F00, false);
+		ef->sfi = 0x1E;
+		ef->data.setBuffer(ARRAY_AND_SIZE(ef_dir));
+
+		df = new EmulatorFile(masterFile, 0x7F50, true);
+		df->name.setBuffer(ARRAY_AND_SIZE(aid_pkcs15));
+
+		ef = new EmulatorFile(df, 0x5031, false);
+		ef->sfi = 0x11;
+		ef->data.setBuffer(ARRAY_AND_SIZE(ef_odf));
+
+		ef = new EmulatorFile(df, 0x5207, false);
+		ef->data.setBuffer(ARRAY_AND_SIZE(ef_dodf));
+
+		ef = new EmulatorFile(df, 0x4300, false);
+		ef->data.setBuffer(ARRAY_AND_SIZE(ef_acmain));
+
+		ef = new EmulatorFile(df, 0x4310, false);
+		ef->data.setBuffer(ARRAY_AND_SIZE(ef_acrules));
+
+		ef = new EmulatorFile(df, 0x4320, false);
+		ef->data.setBuffer(ARRAY_AND_SIZE(ef_acconditions));
+	}
+
+	void EmulatorCard::setMaxChannels(unsigned int count)
+	{
+		if (count < 1 || count > MAX_CHANNELS)
+		{
+			SCARD_DEBUG_ERR("invalid channel count [%d]", count);
+			return;
+		}
+
+		maxChannels = count;
+		reset();
+	}
+
+	void EmulatorCard::setATR(const ByteArray &atr)
+	{
+		if (atr.getLength() < 2)
+		{
+			SCARD_DEBUG_ERR("invalid atr [%d]", atr.getLength());
+			return;
+		}
+
+		this->atr = atr;
+	}
+
+	void EmulatorCard::addApplet(const ByteArray &aid)
+	{
+		if (aid.getLength() < 5 || aid.getLength() > 16)
+		{
+			SCARD_DEBUG_ERR("invalid aid [%d]", aid.getLength());
+			return;
+		}
+
+		applets.push_back(aid);
+	}
+
+	void EmulatorCard::addBinaryFile(unsigned int fid, unsigned int sfi, const ByteArray &data)
+	{
+		EmulatorFile *ef;
+
+		/* offsets above 32767 can not be addressed by READ BINARY */
+		if (data.getLength() > 0x8000)
+		{
+			SCARD_DEBUG_ERR("invalid file size [%d]", data.getLength());
+			return;
+		}
+
+		if ((ef = masterFile->getChild(fid)) == NULL)
+		{
+			ef = new EmulatorFile(masterFile, fid, false);
+		}
+
+		ef->sfi = sfi;
+		ef->data = data;
+	}
+
+	void EmulatorCard::resetChannel(unsigned int channel)
+	{
+		channels[channel].opened = false;
+		channels[channel].currentDF = masterFile;
+		channels[channel].currentEF = NULL;
+		channels[channel].applet = -1;
+		channels[channel].pending.releaseBuffer();
+	}
+
+	void EmulatorCard::reset()
+	{
+		unsigned int i;
+
+		for (i = 0; i < MAX_CHANNELS; i++)
+		{
+			resetChannel(i);
+		}
+
+		/* basic channel is always open */
+		channels[0].opened = true;
+	}
+
+	int EmulatorCard::getChannelNumber(unsigned char cla)
+	{
+		/* further interindustry class carries channels 4 to 19 */
+		if (cla & 0x40)
+			return 4 + (cla & 0x0F);
+		else
+			return cla & 0x03;
+	}
+
+	void EmulatorCard::setStatus(ByteArray &response, const ByteArray &data, unsigned short sw)
+	{
+		unsigned char *buffer;
+
+		if (response.allocBuffer(data.getLength() + 2) == false)
+			return;
+
+		buffer = response.getBuffer();
+
+		if (data.getLength() > 0)
+		{
+			memcpy(buffer, data.getBuffer(), data.getLength());
+		}
+
+		buffer[data.getLength()] = (sw >> 8) & 0xFF;
+		buffer[data.getLength() + 1] = sw & 0xFF;
+	}
+
+	void EmulatorCard::processCommand(const ByteArray &command, ByteArray &response)
+	{
+		unsigned char cla, ins, p1, p2;
+		unsigned int body, lc = 0, le = 0, offset = 5;
+		ByteArray data;
+		int channel;
+
+		if (command.getLength() < 4)
+		{
+			setStatus(response, ByteArray::EMPTY, SW_WRONG_LENGTH);
+			return;
+		}
+
+		cla = command[0];
+		ins = command[1];
+		p1 = command[2];
+		p2 = command[3];
+
+		/* le is 0 when absent */
+		body = command.getLength() - 4;
+		if (body == 0)
+		{
+			/* case 1 */
+		}
+		else if (body == 1)
+		{
+			/* case 2 short */
+			le = (command[4] == 0) ? 256 : command[4];
+		}
+		else if (command[4] != 0)
+		{
+			/* case 3, 4 short */
+			lc = command[4];
+			if (body == 2 + lc)
+			{
+				le = (command[command.getLength() - 1] == 0) ? 256 : command[command.getLength() - 1];
+			}
+			else if (body != 1 + lc)
+			{
+				setStatus(response, ByteArray::EMPTY, SW_WRONG_LENGTH);
+				return;
+			}
+		}
+		else if (body == 3)
+		{
+			/* case 2 extended */
+			le = (command[5] << 8) | command[6];
+			if (le == 0)
+				le = 65536;
+		}
+		else
+		{
+			/* case 3, 4 extended */
+			lc = (command[5] << 8) | command[6];
+			offset = 7;
+			if (body == 5 + lc)
+			{
+				le = (command[command.getLength() - 2] << 8) | command[command.getLength() - 1];
+				if (le == 0)
+					le = 65536;
+			}
+			else if (lc == 0 || body != 3 + lc)
+			{
+				setStatus(response, ByteArray::EMPTY, SW_WRONG_LENGTH);
+				return;
+			}
+		}
+
+		if (lc > 0)
+		{
+			data.setBuffer(command.getBuffer(offset), lc);
+		}
+
+		if (cla == 0xFF)
+		{
+			setStatus(response, ByteArray::EMPTY, SW_CLA_NOT_SUPPORTED);
+			return;
+		}
+
+		channel = getChannelNumber(cla);
+		if (channel >= (int)maxChannels || channels[channel].opened == false)
+		{
+			setStatus(response, ByteArray::EMPTY, SW_CHANNEL_NOT_SUPPORTED);
+			return;
+		}
+
+		/* left data is lost unless it is taken right away */
+		if (ins != APDUCommand::INS_GET_RESPONSE)
+		{
+			channels[channel].pending.releaseBuffer();
+		}
+
+		switch (ins)
+		{
+		case APDUCommand::INS_MANAGE_CHANNEL :
+			manageChannel(channel, p1, p2, response);
+			break;
+
+		case APDUCommand::INS_SELECT_FILE :
+			selectFile(channel, p1, p2, data, response);
+			break;
+
+		case APDUCommand::INS_GET_RESPONSE :
+			getResponse(channel, le, response);
+			break;
+
+		default :
+			if (channels[channel].applet >= 0 && le == 0 && data.getLength() > 0)
+			{
+				/* no le, as a t=0 card the response waits for GET RESPONSE */
+				channels[channel].pending = data;
+				setStatus(response, ByteArray::EMPTY, SW_BYTES_REMAINING | (data.getLength() > 255 ? 0 : data.getLength()));
+			}
+			else if (channels[channel].applet >= 0)
+			{
+				/* applets return the command data */
+				setStatus(response, data, SW_SUCCESS);
+			}
+			else if (ins == APDUCommand::INS_READ_BINARY)
+			{
+				readBinary(channel, p1, p2, le, response);
+			}
+			else
+			{
+				setStatus(response, ByteArray::EMPTY, SW_INS_NOT_SUPPORTED);
+			}
+			break;
+		}
+	}
+
+	void EmulatorCard::getResponse(unsigned int channel, unsigned int le, ByteArray &response)
+	{
+		ByteArray &pending = channels[channel].pending;
+		unsigned int left;
+
+		if (pending.isEmpty() == true)
+		{
+			setStatus(response, ByteArray::EMPTY, SW_CONDITIONS_NOT_SATISFIED);
+			return;
+		}
+
+		if (le == 0 || le > pending.getLength())
+		{
+			setStatus(response, ByteArray::EMPTY, SW_CORRECT_LENGTH | (pending.getLength() > 255 ? 0 : pending.getLength()));
+			return;
+		}
+
+		left = pending.getLength() - le;
+		if (left > 0)
+		{
+			setStatus(response, ByteArray(pending.getBuffer(), le), SW_BYTES_REMAINING | (left > 255 ? 0 : left));
+			pending = ByteArray(pending.getBuffer(le), left);
+		}
+		else
+		{
+			setStatus(response, pending, SW_SUCCESS);
+			pending.releaseBuffer();
+		}
+	}
+
+	void EmulatorCard::manageChannel(unsigned int channel, unsigned char p1, unsigned char p2, ByteArray &response)
+	{
+		unsigned int i;
+
+		switch (p1)
+		{
+		case 0x00 : /* open */
+			if (p2 == 0)
+			{
+				for (i = 1; i < maxChannels; i++)
+				{
+					if (channels[i].opened == false)
+						break;
+				}
+
+				if (i < maxChannels)
+				{
+					unsigned char number = i;
+
+					resetChannel(i);
+					channels[i].opened = true;
+
+					setStatus(response, ByteArray(&number, 1), SW_SUCCESS);
+				}
+				else
+				{
+					setStatus(response, ByteArray::EMPTY, SW_FUNCTION_NOT_SUPPORTED);
+				}
+			}
+			else if (p2 < maxChannels && channels[p2].opened == false)
+			{
+				resetChannel(p2);
+				channels[p2].opened = true;
+
+				setStatus(response, ByteArray::EMPTY, SW_SUCCESS);
+			}
+			else
+			{
+				setStatus(response, ByteArray::EMPTY, SW_INCORRECT_P1P2);
+			}
+			break;
+
+		case 0x80 : /* close */
+			i = (p2 == 0) ? channel : p2;
+
+			if (i == 0)
+			{
+				setStatus(response, ByteArray::EMPTY, SW_INCORRECT_P1P2);
+			}
+			else if (i >= maxChannels || channels[i].opened == false)
+			{
+				setStatus(response, ByteArray::EMPTY, SW_DATA_NOT_FOUND);
+			}
+			else
+			{
+				resetChannel(i);
+
+				setStatus(response, ByteArray::EMPTY, SW_SUCCESS);
+			}
+			break;
+
+		default :
+			setStatus(response, ByteArray::EMPTY, SW_INCORRECT_P1P2);
+			break;
+		}
+	}
+
+	void EmulatorCard::selected(unsigned int channel, EmulatorFile *file, unsigned char p2, ByteArray &response)
+	{
+		if (file->dedicated == true)
+		{
+			channels[channel].currentDF = file;
+			channels[channel].currentEF = NULL;
+		}
+		else
+		{
+			channels[channel].currentDF = file->parent;
+			channels[channel].currentEF = file;
+		}
+		channels[channel].applet = -1;
+
+		if ((p2 & 0x0C) == 0x0C)
+		{
+			setStatus(response, ByteArray::EMPTY, SW_SUCCESS);
+		}
+		else
+		{
+			setStatus(response, file->getFCP(), SW_SUCCESS);
+		}
+	}
+
+	void EmulatorCard::selectFile(unsigned int channel, unsigned char p1, unsigned char p2, const ByteArray &data, ByteArray &response)
+	{
+		EmulatorFile *currentDF = channels[channel].currentDF;
+		EmulatorFile *file = NULL;
+		unsigned int i, fid;
+
+		switch (p1)
+		{
+		case APDUCommand::P1_SELECT_BY_ID :
+			if (data.getLength() == 0)
+			{
+				file = masterFile;
+			}
+			else if (data.getLength() == 2)
+			{
+				fid = (data[0] << 8) | data[1];
+
+				if (fid == masterFile->fid)
+					file = masterFile;
+				else if (fid == currentDF->fid)
+					file = currentDF;
+				else if ((file = currentDF->getChild(fid)) == NULL && currentDF->parent != NULL)
+				{
+					/* parent df or its children */
+					if (fid == currentDF->parent->fid)
+						file = currentDF->parent;
+					else
+						file = currentDF->parent->getChild(fid);
+				}
+			}
+			break;
+
+		case APDUCommand::P1_SELECT_PARENT_DF :
+			file = (currentDF->parent != NULL) ? currentDF->parent : masterFile;
+			break;
+
+		case APDUCommand::P1_SELECT_BY_DF_NAME :
+			if (data.isEmpty() == true)
+			{
+				/* no name, back to the default application */
+				file = masterFile;
+			}
+			else if ((file = masterFile->findByName(data)) == NULL)
+			{
+				for (i = 0; i < applets.size(); i++)
+				{
+					if (applets[i] == data)
+					{
+						channels[channel].currentEF = NULL;
+						channels[channel].applet = i;
+
+						if ((p2 & 0x0C) == 0x0C)
+						{
+							setStatus(response, ByteArray::EMPTY, SW_SUCCESS);
+						}
+						else
+						{
+							setStatus(response, getAppletFCI(data), SW_SUCCESS);
+						}
+
+						return;
+					}
+				}
+			}
+			break;
+
+		case APDUCommand::P1_SELECT_BY_PATH :
+		case APDUCommand::P1_SELECT_BY_PATH_FROM_CURRENT_DF :
+			if (data.getLength() == 0 || (data.getLength() & 1) != 0)
+			{
+				setStatus(response, ByteArray::EMPTY, SW_WRONG_LENGTH);
+				return;
+			}
+
+			file = (p1 == APDUCommand::P1_SELECT_BY_PATH) ? masterFile : currentDF;
+
+			for (i = 0; i < data.getLength() && file != NULL; i += 2)
+			{
+				fid = (data[i] << 8) | data[i + 1];
+
+				/* path from the mf may start with the mf itself */
+				if (i == 0 && file == masterFile && fid == masterFile->fid)
+					continue;
+
+				if (file->dedicated == false)
+					file = NULL;
+				else
+					file = file->getChild(fid);
+			}
+			break;
+
+		default :
+			setStatus(response, ByteArray::EMPTY, SW_INCORRECT_P1P2);
+			return;
+		}
+
+		if (file != NULL)
+		{
+			selected(channel, file, p2, response);
+		}
+		else
+		{
+			setStatus(response, ByteArray::EMPTY, SW_FILE_NOT_FOUND);
+		}
+	}
+
+	void EmulatorCard::readBinary(unsigned int channel, unsigned char p1, unsigned char p2, unsigned int le, ByteArray &response)
+	{
+		EmulatorFile *file;
+		unsigned int offset, available;
+
+		if (p1 & 0x80)
+		{
+			/* short ef identifier, the file becomes the current ef */
+			if ((file = channels[channel].currentDF->getChildBySFI(p1 & 0x1F)) == NULL)
+			{
+				setStatus(response, ByteArray::EMPTY, SW_FILE_NOT_FOUND);
+				return;
+			}
+
+			channels[channel].currentEF = file;
+			offset = p2;
+		}
+		else
+		{
+			if ((file = channels[channel].currentEF) == NULL)
+			{
+				setStatus(response, ByteArray::EMPTY, SW_NO_CURRENT_EF);
+				return;
+			}
+
+			offset = ((p1 & 0x7F) << 8) | p2;
+		}
+
+		if (file->dedicated == true)
+		{
+			setStatus(response, ByteArray::EMPTY, SW_INCOMPATIBLE_FILE);
+			return;
+		}
+
+		if (offset > file->data.getLength())
+		{
+			setStatus(response, ByteArray::EMPTY, SW_WRONG_OFFSET);
+			return;
+		}
+
+		available = file->data.getLength() - offset;
+
+		if (le == 0)
+		{
+			/* no le, tell the length to retry with */
+			setStatus(response, ByteArray::EMPTY, SW_CORRECT_LENGTH | ((available > 255) ? 0 : available));
+		}
+		else if (le > available)
+		{
+			setStatus(response, ByteArray(file->data.getBuffer(offset), available), SW_END_OF_FILE);
+		}
+		else
+		{
+			setStatus(response, ByteArray(file->data.getBuffer(offset), le), SW_SUCCESS);
+		}
+	}
+
+} /* namespace smartcard_service_api */
@@ -0,0 +1,381 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "TerminalInterface.h"
+#include "EmulatorTerminal.h"
+
+#ifndef EXTERN_API
+#define EXTERN_API __attribute__((visibility("default")))
+#endif
+
+#define DEFAULT_NAME		"Emulator"
+
+namespace smartcard_service_api
+{
+	/* echo applet selectable by default */
+	static unsigned char default_applet[] = { 0xA0, 0x00, 0x00, 0x00, 0x00, 0x45, 0x4D, 0x55, 0x4C, 0x00, 0x01 };
+
+	EmulatorTerminal::EmulatorTerminal():Terminal()
+	{
+		latency = 0;
+		capabilities = TERMINAL_CAP_ASYNC_TRANSMIT | TERMINAL_CAP_POLLABLE_FD;
+		eventFd = -1;
+	}
+
+	EmulatorTerminal::~EmulatorTerminal()
+	{
+		finalize();
+
+		if (name != NULL)
+		{
+			free(name);
+			name = NULL;
+		}
+	}
+
+	bool EmulatorTerminal::parseHexString(const char *string, ByteArray &result)
+	{
+		unsigned char buffer[256];
+		unsigned int length = 0;
+		unsigned int value;
+		const char *temp = string;
+
+		while (*temp != '\0' && *temp != ',')
+		{
+			if (*temp == ' ' || *temp == ':')
+			{
+				temp++;
+				continue;
+			}
+
+			if (length >= sizeof(buffer) || sscanf(temp, "%2x", &value) != 1 ||
+				temp[1] == '\0' || temp[1] == ',')
+			{
+				return false;
+			}
+
+			buffer[length++] = value;
+			temp += 2;
+		}
+
+		return (length > 0 && result.setBuffer(buffer, length));
+	}
+
+	void EmulatorTerminal::loadConfiguration()
+	{
+		const char *value;
+		ByteArray temp;
+
+		value = getenv("SE_EMULATOR_NAME");
+		name = strdup((value != NULL && value[0] != '\0') ? value : DEFAULT_NAME);
+
+		if ((value = getenv("SE_EMULATOR_LATENCY_US")) != NULL)
+		{
+			latency = strtoul(value, NULL, 10);
+		}
+
+		if ((value = getenv("SE_EMULATOR_CHANNELS")) != NULL)
+		{
+			card.setMaxChannels(strtoul(value, NULL, 10));
+		}
+
+		if ((value = getenv("SE_EMULATOR_ATR")) != NULL)
+		{
+			if (parseHexString(value, temp) == true)
+			{
+				card.setATR(temp);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("invalid atr [%s]", value);
+			}
+		}
+
+		if ((value = getenv("SE_EMULATOR_APPLETS")) != NULL)
+		{
+			while (*value != '\0')
+			{
+				if (parseHexString(value, temp) == true)
+				{
+					card.addApplet(temp);
+				}
+				else
+				{
+					SCARD_DEBUG_ERR("invalid aid [%s]", value);
+				}
+
+				if ((value = strchr(value, ',')) == NULL)
+					break;
+
+				value++;
+			}
+		}
+		else
+		{
+			card.addApplet(ByteArray(ARRAY_AND_SIZE(default_applet)));
+		}
+
+		if ((value = getenv("SE_EMULATOR_EF_SIZE")) != NULL)
+		{
+			unsigned int i, size = strtoul(value, NULL, 10);
+			unsigned char *buffer;
+
+			if (size > 0 && (buffer = new unsigned char[size]) != NULL)
+			{
+				for (i = 0; i < size; i++)
+				{
+					buffer[i] = (unsigned char)(i + (i >> 8));
+				}
+
+				temp.setBuffer(buffer, size);
+				card.addBinaryFile(0x6001, 0x05, temp);
+
+				delete []buffer;
+			}
+		}
+
+		if (getenv("SE_EMULATOR_SYNC") != NULL)
+		{
+			capabilities = 0;
+		}
+	}
+
+	bool EmulatorTerminal::initialize()
+	{
+		SCARD_BEGIN();
+
+		if (initialized == true)
+			return true;
+
+		loadConfiguration();
+
+		if (capabilities & TERMINAL_CAP_POLLABLE_FD)
+		{
+			/* responses are delivered when the timer of the latency expires */
+			if ((eventFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+			{
+				SCARD_DEBUG_ERR("timerfd_create failed [%d]", errno);
+
+				capabilities = 0;
+			}
+		}
+
+		initialized = true;
+
+		SCARD_DEBUG("name [%s], latency [%d], capabilities [0x%08X]", name, latency, capabilities);
+
+		SCARD_END();
+
+		return true;
+	}
+
+	void EmulatorTerminal::finalize()
+	{
+		if (initialized == false)
+			return;
+
+		syncLock();
+
+		/* pending responses are dropped */
+		while (results.size() > 0)
+		{
+			results.pop();
+		}
+
+		if (eventFd >= 0)
+		{
+			close(eventFd);
+			eventFd = -1;
+		}
+
+		initialized = false;
+
+		syncUnlock();
+	}
+
+	bool EmulatorTerminal::isSecureElementPresence()
+	{
+		return initialized;
+	}
+
+	int EmulatorTerminal::transmitSync(const ByteArray &command, ByteArray &result)
+	{
+		if (initialized == false)
+			return -1;
+
+		if (latency > 0)
+		{
+			usleep(latency);
+		}
+
+		syncLock();
+
+		card.processCommand(command, result);
+
+		syncUnlock();
+
+		return 0;
+	}
+
+	int EmulatorTerminal::getATRSync(ByteArray &atr)
+	{
+		if (initialized == false)
+			return -1;
+
+		atr = card.getATR();
+
+		return 0;
+	}
+
+	void EmulatorTerminal::armTimer()
+	{
+		struct itimerspec timer;
+
+		memset(&timer, 0, sizeof(timer));
+
+		/* zero would disarm the timer */
+		timer.it_value.tv_sec = latency / 1000000;
+		timer.it_value.tv_nsec = (latency % 1000000) * 1000;
+		if (latency == 0)
+			timer.it_value.tv_nsec = 1;
+
+		if (timerfd_settime(eventFd, 0, &timer, NULL) < 0)
+		{
+			SCARD_DEBUG_ERR("timerfd_settime failed [%d]", errno);
+		}
+	}
+
+	int EmulatorTerminal::transmit(const ByteArray &command, terminalTransmitCallback callback, void *userData)
+	{
+		transmit_result_t result;
+
+		if (initialized == false || eventFd < 0 || callback == NULL)
+			return -1;
+
+		result.callback = callback;
+		result.userData = userData;
+
+		syncLock();
+
+		/* the card answers at once, the response waits for the timer */
+		card.processCommand(command, result.response);
+
+		results.push(result);
+		if (results.size() == 1)
+		{
+			armTimer();
+		}
+
+		syncUnlock();
+
+		return 0;
+	}
+
+	int EmulatorTerminal::getATR(terminalGetATRCallback callback, void *userData)
+	{
+		ByteArray atr;
+
+		if (initialized == false || callback == NULL)
+			return -1;
+
+		atr = card.getATR();
+
+		callback(atr.getBuffer(), atr.getLength(), 0, userData);
+
+		return 0;
+	}
+
+	void EmulatorTerminal::processEvents()
+	{
+		transmit_result_t result;
+		uint64_t expirations;
+
+		syncLock();
+
+		if (eventFd < 0 || read(eventFd, &expirations, sizeof(expirations)) != sizeof(expirations) ||
+			results.size() == 0)
+		{
+			syncUnlock();
+
+			return;
+		}
+
+		result = results.front();
+		results.pop();
+
+		if (results.size() > 0)
+		{
+			armTimer();
+		}
+
+		syncUnlock();
+
+		result.callback(result.response.getBuffer(), result.response.getLength(), 0, result.userData);
+	}
+
+} /* namespace smartcard_service_api */
+
+using namespace smartcard_service_api;
+
+extern "C"
+{
+EXTERN_API void *create_instance()
+{
+	EmulatorTerminal *terminal = new EmulatorTerminal();
+
+	terminal->initialize();
+
+	return (void *)(Terminal *)terminal;
+}
+
+EXTERN_API void destroy_instance(void *instance)
+{
+	delete (EmulatorTerminal *)(Terminal *)instance;
+}
+
+EXTERN_API int get_abi_version()
+{
+	return TERMINAL_ABI_VERSION;
+}
+
+EXTERN_API unsigned int get_capabilities(void *instance)
+{
+	return ((EmulatorTerminal *)(Terminal *)instance)->getCapabilities();
+}
+
+EXTERN_API int get_event_fd(void *instance)
+{
+	return ((EmulatorTerminal *)(Terminal *)instance)->getEventFd();
+}
+
+EXTERN_API void process_events(void *instance)
+{
+	((EmulatorTerminal *)(Terminal *)instance)->processEvents();
+}
+}
@@ -0,0 +1,107 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef EMULATORCARD_H_
+#define EMULATORCARD_H_
+
+/* standard library header */
+#include <vector>
+
+/* SLP library header */
+
+/* local header */
+#include "ByteArray.h"
+
+using namespace std;
+
+namespace smartcard_service_api
+{
+	class EmulatorFile
+	{
+	public:
+		unsigned int fid;
+		unsigned int sfi;
+		bool dedicated;
+		ByteArray name;		/* df name */
+		ByteArray data;		/* contents of transparent ef */
+		EmulatorFile *parent;
+		vector<EmulatorFile *> children;
+
+		EmulatorFile(EmulatorFile *parent, unsigned int fid, bool dedicated);
+		~EmulatorFile();
+
+		EmulatorFile *getChild(unsigned int fid);
+		EmulatorFile *getChildBySFI(unsigned int sfi);
+		EmulatorFile *findByName(const ByteArray &name);
+
+		ByteArray getFCP();
+	};
+
+	/* in-memory card, iso 7816-4 file system with a pkcs #15 application
+	 * holding the gp secure element access control files, plus applets
+	 * which echo the data of any other command */
+	class EmulatorCard
+	{
+	public:
+		static const unsigned int MAX_CHANNELS = 20;
+
+	private:
+		typedef struct _channel_state_t
+		{
+			bool opened;
+			EmulatorFile *currentDF;
+			EmulatorFile *currentEF;
+			int applet;		/* selected applet, -1 for file system */
+			ByteArray pending;	/* response data left for GET RESPONSE */
+		}
+		channel_state_t;
+
+		EmulatorFile *masterFile;
+		vector<ByteArray> applets;
+		channel_state_t channels[MAX_CHANNELS];
+		unsigned int maxChannels;
+		ByteArray atr;
+
+		void buildFileSystem();
+		void resetChannel(unsigned int channel);
+
+		static int getChannelNumber(unsigned char cla);
+		static void setStatus(ByteArray &response, const ByteArray &data, unsigned short sw);
+
+		void manageChannel(unsigned int channel, unsigned char p1, unsigned char p2, ByteArray &response);
+		void selectFile(unsigned int channel, unsigned char p1, unsigned char p2, const ByteArray &data, ByteArray &response);
+		void readBinary(unsigned int channel, unsigned char p1, unsigned char p2, unsigned int le, ByteArray &response);
+		void selected(unsigned int channel, EmulatorFile *file, unsigned char p2, ByteArray &response);
+		void getResponse(unsigned int channel, unsigned int le, ByteArray &response);
+
+	public:
+		EmulatorCard();
+		~EmulatorCard();
+
+		void setMaxChannels(unsigned int count);
+		void setATR(const ByteArray &atr);
+		void addApplet(const ByteArray &aid);
+		void addBinaryFile(unsigned int fid, unsigned int sfi, const ByteArray &data);
+
+		inline ByteArray getATR() { return atr; }
+
+		void reset();
+		void processCommand(const ByteArray &command, ByteArray &response);
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* EMULATORCARD_H_ */
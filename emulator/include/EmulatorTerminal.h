@@ -0,0 +1,86 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef EMULATORTERMINAL_H_
+#define EMULATORTERMINAL_H_
+
+/* standard library header */
+#include <queue>
+
+/* SLP library header */
+
+/* local header */
+#include "Terminal.h"
+#include "EmulatorCard.h"
+
+using namespace std;
+
+namespace smartcard_service_api
+{
+	/* loopback terminal with an in-memory card, configured by environment
+	 *   SE_EMULATOR_NAME : reader name
+	 *   SE_EMULATOR_LATENCY_US : delay of each apdu in microseconds
+	 *   SE_EMULATOR_CHANNELS : number of channels including the basic one
+	 *   SE_EMULATOR_APPLETS : comma separated aids of echo applets
+	 *   SE_EMULATOR_ATR : atr in hex
+	 *   SE_EMULATOR_SYNC : if set, only transmitSync is offered
+	 *   SE_EMULATOR_EF_SIZE : size of ef 6001 (sfi 5) in the mf,
+	 *     byte n holds (n + (n >> 8)) & 0xFF */
+	class EmulatorTerminal : public Terminal
+	{
+	private:
+		typedef struct _transmit_result_t
+		{
+			ByteArray response;
+			terminalTransmitCallback callback;
+			void *userData;
+		}
+		transmit_result_t;
+
+		EmulatorCard card;
+		unsigned int latency;
+		unsigned int capabilities;
+		int eventFd;
+		queue<transmit_result_t> results;
+
+		void loadConfiguration();
+		void armTimer();
+
+		static bool parseHexString(const char *string, ByteArray &result);
+
+	public:
+		EmulatorTerminal();
+		~EmulatorTerminal();
+
+		bool initialize();
+		void finalize();
+
+		bool isSecureElementPresence();
+
+		int transmitSync(const ByteArray &command, ByteArray &result);
+		int getATRSync(ByteArray &atr);
+
+		int transmit(const ByteArray &command, terminalTransmitCallback callback, void *userData);
+		int getATR(terminalGetATRCallback callback, void *userData);
+
+		inline unsigned int getCapabilities() { return capabilities; }
+		inline int getEventFd() { return eventFd; }
+		void processEvents();
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* EMULATORTERMINAL_H_ */
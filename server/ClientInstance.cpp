@@ -28,10 +28,26 @@
 
 namespace smartcard_service_api
 {
+	ClientInstance::~ClientInstance()
+	{
+		vector<ServerChannel *> closing;
+
+		removeServices(closing);
+		ServiceInstance::destroyChannels(closing);
+	}
+
 	void ClientInstance::setPID(int pid)
 	{
 		this->pid = pid;
 
+		/* identity of the process doesn't change, later checks use this copy */
+		if (pid > 0 && SignatureHelper::getProcessName(pid, processName, sizeof(processName)) != 0)
+		{
+			SCARD_DEBUG_ERR("getProcessName failed, pid [%d]", pid);
+
+			processName[0] = '\0';
+		}
+
 #if 0
 		if (pid > 0)
 		{
@@ -40,6 +56,15 @@ namespace smartcard_service_api
 #endif
 	}
 
+	void ClientInstance::setCertificationHash(const ByteArray &hash)
+	{
+		/* sent with every service of the process, it is the same for all */
+		if (certHash.getLength() == 0 && hash.getLength() > 0)
+		{
+			certHash = hash;
+		}
+	}
+
 	bool ClientInstance::createService(unsigned int context)
 	{
 		bool result = false;
@@ -78,23 +103,27 @@ namespace smartcard_service_api
 		return result;
 	}
 
-	void ClientInstance::removeService(unsigned int context)
+	void ClientInstance::removeService(unsigned int context, vector<ServerChannel *> &closing)
 	{
 		map<unsigned int, ServiceInstance *>::iterator item;
 
 		if ((item = mapServices.find(context)) != mapServices.end())
 		{
+			item->second->closeSessions(closing);
+
 			delete item->second;
 			mapServices.erase(item);
 		}
 	}
 
-	void ClientInstance::removeServices()
+	void ClientInstance::removeServices(vector<ServerChannel *> &closing)
 	{
 		map<unsigned int, ServiceInstance *>::iterator item;
 
 		for (item = mapServices.begin(); item != mapServices.end(); item++)
 		{
+			item->second->closeSessions(closing);
+
 			delete item->second;
 		}
 
@@ -0,0 +1,245 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <string.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "HandleTable.h"
+
+namespace smartcard_service_api
+{
+	HandleTable::HandleTable()
+	{
+		memset((void *)segments, 0, sizeof(segments));
+		segmentCount = 0;
+		freeHead = NO_SLOT;
+		freeTail = NO_SLOT;
+		usedCount = 0;
+	}
+
+	HandleTable::~HandleTable()
+	{
+		unsigned int i;
+
+		for (i = 0; i < segmentCount; i++)
+		{
+			delete[] segments[i];
+			segments[i] = NULL;
+		}
+	}
+
+	HandleTable &HandleTable::getInstance()
+	{
+		static HandleTable handleTable;
+
+		return handleTable;
+	}
+
+	void HandleTable::pushFreeSlot(unsigned int index)
+	{
+		getSlot(index)->nextFree = NO_SLOT;
+
+		if (freeTail != NO_SLOT)
+		{
+			getSlot(freeTail)->nextFree = index;
+		}
+		else
+		{
+			freeHead = index;
+		}
+
+		freeTail = index;
+	}
+
+	bool HandleTable::appendSegment()
+	{
+		handle_slot_t *segment = NULL;
+		unsigned int i;
+
+		if (segmentCount >= SEGMENT_COUNT)
+		{
+			SCARD_DEBUG_ERR("handle table is full [%d]", usedCount);
+
+			return false;
+		}
+
+		segment = new handle_slot_t[SEGMENT_SIZE];
+		if (segment == NULL)
+		{
+			SCARD_DEBUG_ERR("alloc failed");
+
+			return false;
+		}
+
+		memset(segment, 0, sizeof(handle_slot_t) * SEGMENT_SIZE);
+
+		/* publish the zeroed segment before any index in it is handed out */
+		__sync_synchronize();
+		segments[segmentCount] = segment;
+
+		for (i = 0; i < SEGMENT_SIZE; i++)
+		{
+			pushFreeSlot(segmentCount * SEGMENT_SIZE + i);
+		}
+
+		segmentCount++;
+
+		return true;
+	}
+
+	unsigned int HandleTable::assignHandle(int type, void *object, int socket, unsigned int context, Terminal *terminal)
+	{
+		unsigned int handle = INVALID_HANDLE;
+
+		if (object == NULL)
+			return handle;
+
+		SCOPE_LOCK(mutexLock)
+		{
+			handle_slot_t *slot;
+			unsigned int index;
+			unsigned int generation;
+
+			if (freeHead == NO_SLOT && appendSegment() == false)
+			{
+				return handle;
+			}
+
+			index = freeHead;
+			slot = getSlot(index);
+
+			freeHead = slot->nextFree;
+			if (freeHead == NO_SLOT)
+				freeTail = NO_SLOT;
+
+			slot->type = type;
+			slot->object = object;
+			slot->terminal = terminal;
+			slot->socket = socket;
+			slot->context = context;
+
+			/* contents are visible before the slot turns odd */
+			generation = (slot->generation + 1) & GENERATION_MASK;
+			__sync_synchronize();
+			slot->generation = generation;
+
+			usedCount++;
+
+			handle = (generation << INDEX_BITS) | index;
+		}
+
+		SCARD_DEBUG("assign handle : type [%d], handle [0x%08X]", type, handle);
+
+		return handle;
+	}
+
+	bool HandleTable::releaseHandle(unsigned int handle)
+	{
+		bool result = false;
+
+		SCARD_DEBUG("will be released : handle [0x%08X]", handle);
+
+		SCOPE_LOCK(mutexLock)
+		{
+			handle_slot_t *slot;
+
+			if ((slot = getSlot(handle & INDEX_MASK)) != NULL &&
+				slot->generation == (handle >> INDEX_BITS))
+			{
+				/* turn even first, lookups in flight see the change */
+				slot->generation = (slot->generation + 1) & GENERATION_MASK;
+				__sync_synchronize();
+
+				slot->type = HANDLE_TYPE_NONE;
+				slot->object = NULL;
+				slot->terminal = NULL;
+
+				pushFreeSlot(handle & INDEX_MASK);
+				usedCount--;
+
+				result = true;
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("stale handle [0x%08X]", handle);
+			}
+		}
+
+		return result;
+	}
+
+	void *HandleTable::getObject(unsigned int handle, int type, int socket, unsigned int context) const
+	{
+		handle_slot_t *slot;
+		unsigned int generation = handle >> INDEX_BITS;
+		void *object;
+
+		/* even generations are never handed out */
+		if ((generation & 1) == 0 || (slot = getSlot(handle & INDEX_MASK)) == NULL)
+			return NULL;
+
+		if (slot->generation != generation)
+			return NULL;
+
+		__sync_synchronize();
+
+		if (slot->type != type || slot->socket != socket || slot->context != context)
+			return NULL;
+
+		object = slot->object;
+
+		/* slot was not released while reading */
+		__sync_synchronize();
+
+		if (slot->generation != generation)
+			return NULL;
+
+		return object;
+	}
+
+	Terminal *HandleTable::getObjectTerminal(unsigned int handle, int type, int socket, unsigned int context) const
+	{
+		handle_slot_t *slot;
+		unsigned int generation = handle >> INDEX_BITS;
+		Terminal *terminal;
+
+		if ((generation & 1) == 0 || (slot = getSlot(handle & INDEX_MASK)) == NULL)
+			return NULL;
+
+		if (slot->generation != generation)
+			return NULL;
+
+		__sync_synchronize();
+
+		if (slot->type != type || slot->socket != socket || slot->context != context)
+			return NULL;
+
+		terminal = slot->terminal;
+
+		__sync_synchronize();
+
+		if (slot->generation != generation)
+			return NULL;
+
+		return terminal;
+	}
+
+} /* namespace smartcard_service_api */
@@ -0,0 +1,257 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "APDUHelper.h"
+#include "LogicalChannelPool.h"
+
+namespace smartcard_service_api
+{
+	LogicalChannelPool::LogicalChannelPool(Terminal *terminal, unsigned int capacity)
+	{
+		this->terminal = terminal;
+		this->capacity = capacity;
+		epoch = 0;
+		disabled = false;
+		hitCount = 0;
+		missCount = 0;
+	}
+
+	LogicalChannelPool::~LogicalChannelPool()
+	{
+		SCARD_DEBUG("channel pool of [%s] : hit [%d], miss [%d]", terminal->getName(), hitCount, missCount);
+
+		/* the terminal may be finalized already, channels are not closed */
+		idleChannels.clear();
+	}
+
+	int LogicalChannelPool::openChannel()
+	{
+		ByteArray command, response;
+		int channelNum = -1;
+		int rv;
+
+		command = APDUHelper::generateAPDU(APDUHelper::COMMAND_OPEN_LOGICAL_CHANNEL, 0, ByteArray::EMPTY);
+		rv = terminal->transmitSync(command, response);
+		if (rv == 0 && response.getLength() >= 3)
+		{
+			if (ResponseHelper::getStatus(response) == 0)
+			{
+				channelNum = response[0];
+			}
+			else
+			{
+				SCARD_DEBUG("open channel is refused [ 0x%02X 0x%02X ]", response[response.getLength() - 2], response[response.getLength() - 1]);
+			}
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("open channel is failed, rv [%d], length [%d]", rv, response.getLength());
+		}
+
+		return channelNum;
+	}
+
+	void LogicalChannelPool::closeChannel(int channelNum)
+	{
+		ByteArray command, response;
+		int rv;
+
+		command = APDUHelper::generateAPDU(APDUHelper::COMMAND_CLOSE_LOGICAL_CHANNEL, channelNum, ByteArray::EMPTY);
+		rv = terminal->transmitSync(command, response);
+		if (rv != 0 || ResponseHelper::getStatus(response) != 0)
+		{
+			SCARD_DEBUG_ERR("close channel [%d] is failed, rv [%d]", channelNum, rv);
+		}
+	}
+
+	bool LogicalChannelPool::resetChannel(int channelNum)
+	{
+		ByteArray command, response;
+		int rv;
+
+		/* select without name, the channel goes back to the default application */
+		command = APDUHelper::generateAPDU(APDUHelper::COMMAND_SELECT_BY_DF_NAME, channelNum, ByteArray::EMPTY);
+		if (command.getLength() == 0)
+		{
+			SCARD_DEBUG_ERR("channel [%d] can not be encoded", channelNum);
+
+			return false;
+		}
+
+		rv = terminal->transmitSync(command, response);
+		if (rv == 0 && response.getLength() >= 2 && ResponseHelper::getStatus(response) == 0)
+		{
+			return true;
+		}
+
+		SCARD_DEBUG_ERR("reset of channel [%d] is failed, rv [%d], length [%d]", channelNum, rv, response.getLength());
+
+		return false;
+	}
+
+	bool LogicalChannelPool::hasRoom(unsigned int epoch)
+	{
+		bool result = false;
+
+		SCOPE_LOCK(poolLock)
+		{
+			result = (epoch == this->epoch && disabled == false && idleChannels.size() < capacity);
+		}
+
+		return result;
+	}
+
+	bool LogicalChannelPool::keepChannel(int channelNum, unsigned int epoch)
+	{
+		bool result = false;
+
+		SCOPE_LOCK(poolLock)
+		{
+			if (epoch == this->epoch && disabled == false && idleChannels.size() < capacity)
+			{
+				idleChannels.push_back(channelNum);
+				result = true;
+			}
+		}
+
+		return result;
+	}
+
+	void LogicalChannelPool::fill()
+	{
+		unsigned int current;
+		int channelNum;
+
+		SCOPE_LOCK(poolLock)
+		{
+			current = epoch;
+			if (disabled == true || idleChannels.size() >= capacity)
+			{
+				return;
+			}
+		}
+
+		/* checked before each open, a full pool costs no apdu */
+		while (hasRoom(current) == true && (channelNum = openChannel()) > 0)
+		{
+			if (keepChannel(channelNum, current) == false)
+			{
+				closeChannel(channelNum);
+				break;
+			}
+		}
+
+		SCARD_DEBUG("channel pool of [%s] : [%d] idle", terminal->getName(), (int)idleChannels.size());
+	}
+
+	int LogicalChannelPool::acquire(unsigned int &epoch)
+	{
+		int channelNum = -1;
+
+		SCOPE_LOCK(poolLock)
+		{
+			epoch = this->epoch;
+
+			if (idleChannels.size() > 0)
+			{
+				channelNum = idleChannels.back();
+				idleChannels.pop_back();
+
+				hitCount++;
+			}
+			else
+			{
+				missCount++;
+			}
+		}
+
+		return channelNum;
+	}
+
+	bool LogicalChannelPool::release(int channelNum, unsigned int epoch)
+	{
+		vector<int> closing;
+		bool result = false;
+
+		SCOPE_LOCK(poolLock)
+		{
+			if (epoch != this->epoch)
+			{
+				/* the card is gone, so is the channel */
+				return true;
+			}
+
+			if (disabled == true || idleChannels.size() >= capacity)
+			{
+				return false;
+			}
+		}
+
+		if (resetChannel(channelNum) == true)
+		{
+			result = keepChannel(channelNum, epoch);
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("card refuses reuse of channels, pool of [%s] is disabled", terminal->getName());
+
+			SCOPE_LOCK(poolLock)
+			{
+				disabled = true;
+				closing.swap(idleChannels);
+			}
+
+			for (size_t i = 0; i < closing.size(); i++)
+			{
+				closeChannel(closing[i]);
+			}
+		}
+
+		return result;
+	}
+
+	void LogicalChannelPool::invalidate()
+	{
+		SCOPE_LOCK(poolLock)
+		{
+			idleChannels.clear();
+			epoch++;
+
+			/* a new card gets a new chance */
+			disabled = false;
+		}
+	}
+
+	void LogicalChannelPool::getStatistics(pool_statistics_t &result)
+	{
+		SCOPE_LOCK(poolLock)
+		{
+			result.capacity = capacity;
+			result.idle = idleChannels.size();
+			result.hit = hitCount;
+			result.miss = missCount;
+			result.disabled = disabled;
+		}
+	}
+
+} /* namespace smartcard_service_api */
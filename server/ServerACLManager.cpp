@@ -0,0 +1,135 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <vector>
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "ServerACLManager.h"
+#include "ServerResource.h"
+#include "ServerDispatcher.h"
+
+using namespace std;
+
+namespace smartcard_service_api
+{
+	ServerACLManager::ServerACLManager()
+	{
+		interval = DEFAULT_INTERVAL;
+		timerID = 0;
+	}
+
+	ServerACLManager::~ServerACLManager()
+	{
+		stop();
+	}
+
+	ServerACLManager *ServerACLManager::getInstance()
+	{
+		static ServerACLManager instance;
+
+		return &instance;
+	}
+
+	void ServerACLManager::start(unsigned int interval)
+	{
+		SCARD_BEGIN();
+
+		stop();
+
+		this->interval = interval;
+
+		/* preload all terminals */
+		requestUpdate();
+
+		if (interval > 0)
+		{
+			timerID = g_timeout_add_seconds(interval, &ServerACLManager::timerCallback, this);
+		}
+
+		SCARD_DEBUG("refresh interval [%d]", interval);
+
+		SCARD_END();
+	}
+
+	void ServerACLManager::stop()
+	{
+		if (timerID != 0)
+		{
+			g_source_remove(timerID);
+			timerID = 0;
+		}
+	}
+
+	gboolean ServerACLManager::timerCallback(gpointer user_data)
+	{
+		ServerACLManager *manager = (ServerACLManager *)user_data;
+
+		manager->requestUpdate();
+
+		return TRUE;
+	}
+
+	void ServerACLManager::requestUpdate()
+	{
+		size_t i;
+		vector<Terminal *> terminals;
+
+		ServerResource::getInstance().getTerminals(terminals);
+
+		for (i = 0; i < terminals.size(); i++)
+		{
+			requestUpdate(terminals[i]);
+		}
+	}
+
+	void ServerACLManager::requestUpdate(Terminal *terminal, bool force)
+	{
+		DispatcherMsg *msg = NULL;
+
+		if (terminal == NULL)
+			return;
+
+		/* presence is checked and the list loaded by the worker of the terminal,
+		 * the main loop and clients of other terminals are not blocked */
+		msg = new DispatcherMsg();
+		if (msg != NULL)
+		{
+			msg->message = Message::MSG_OPERATION_UPDATE_ACL;
+			msg->caller = terminal;
+			msg->param1 = force ? 1 : 0;
+
+			ServerDispatcher::getInstance()->pushMessage(msg);
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("alloc failed");
+		}
+	}
+
+	void ServerACLManager::requestUpdate(const char *name, bool force)
+	{
+		if (name == NULL)
+			return;
+
+		requestUpdate(ServerResource::getInstance().getTerminal(name), force);
+	}
+
+} /* namespace smartcard_service_api */
@@ -21,7 +21,11 @@
 /* local header */
 #include "Debug.h"
 #include "ServerChannel.h"
+#include "TerminalDispatcher.h"
+#include "LogicalChannelPool.h"
+#include "ServerResource.h"
 #include "APDUHelper.h"
+#include "Message.h"
 
 namespace smartcard_service_api
 {
@@ -30,6 +34,11 @@ namespace smartcard_service_api
 		this->terminal = terminal;
 		this->caller = caller;
 		this->channelNum = channelNum;
+		this->handle = (unsigned int)-1;
+		this->prevChannel = NULL;
+		this->nextChannel = NULL;
+		this->pool = NULL;
+		this->poolEpoch = 0;
 	}
 
 	ServerChannel::~ServerChannel()
@@ -46,7 +55,11 @@ namespace smartcard_service_api
 		APDUHelper apdu;
 		int rv;
 
-		if (isBasicChannel() == false)
+		if (isBasicChannel() == false && pool != NULL && pool->release(channelNum, poolEpoch) == true)
+		{
+			SCARD_DEBUG("channel [%d] is returned to the pool", channelNum);
+		}
+		else if (isBasicChannel() == false)
 		{
 			/* close channel */
 			command = apdu.generateAPDU(APDUHelper::COMMAND_CLOSE_LOGICAL_CHANNEL, channelNum, ByteArray::EMPTY);
@@ -79,10 +92,20 @@ namespace smartcard_service_api
 		return channelNum;
 	}
 
-	int ServerChannel::transmitSync(ByteArray command, ByteArray &result)
+	int ServerChannel::buildCommand(const ByteArray &command, ByteArray &apdu)
 	{
 		APDUCommand helper;
 
+		apdu = command; /* shares storage until rebuilt */
+
+		/* apdu filters of access control rule */
+		if (apduRule.isAuthorizedAccess(command) == false)
+		{
+			SCARD_DEBUG_ERR("unauthorized apdu : %s", command.toString());
+
+			return -4; /* security reason */
+		}
+
 		if (session != NULL) /* admin channel */
 		{
 			helper.setCommand(command);
@@ -95,14 +118,182 @@ namespace smartcard_service_api
 			}
 
 			/* insert channel ID */
-			helper.setChannel(0, channelNum);
+			if (channelNum != 0 && helper.setChannel(0, channelNum) == false)
+			{
+				SCARD_DEBUG_ERR("channel [%d] can not be encoded", channelNum);
+
+				return -1;
+			}
+
+			helper.getBuffer(apdu);
+		}
+
+		SCARD_DEBUG("command [%d] : %s", apdu.getLength(), apdu.toString());
+
+		return 0;
+	}
+
+	int ServerChannel::transmitSync(const ByteArray &command, ByteArray &result)
+	{
+		ByteArray apdu;
+		int rv;
+
+		if ((rv = buildCommand(command, apdu)) != 0)
+			return rv;
+
+		if ((rv = terminal->transmitSync(apdu, result)) != 0)
+		{
+			/* the card may be reset, its answer to reset is read again */
+			ServerResource::getInstance().invalidateATR(terminal);
+		}
+
+		return rv;
+	}
 
-			helper.getBuffer(command);
+	unsigned char ServerChannel::getResponseCLA(unsigned char cla)
+	{
+		/* channel of the command, without secure messaging and proprietary class */
+		if (cla & 0x40)
+		{
+			return (cla & 0x4F);
+		}
+		else
+		{
+			return (cla & 0x03);
+		}
+	}
+
+	bool ServerChannel::chainResponse(const ByteArray &apdu, const ByteArray &response, ByteArray &collected, unsigned int count, ByteArray &next)
+	{
+		APDUCommand helper;
+		unsigned int length;
+		unsigned char sw1;
+
+		if (response.getLength() >= 2 && count < MAX_CHAINED_APDUS)
+		{
+			sw1 = response[response.getLength() - 2];
+			length = response[response.getLength() - 1];
+			if (length == 0)
+			{
+				length = 256;
+			}
+
+			if (sw1 == 0x61 && collected.getLength() + response.getLength() - 2 + length <= MAX_CHAINED_RESPONSE)
+			{
+				/* keep the data, the card has more */
+				if (response.getLength() > 2)
+				{
+					collected += ByteArray(response.getBuffer(), response.getLength() - 2);
+				}
+
+				helper.setCommand(getResponseCLA(apdu[0]), APDUCommand::INS_GET_RESPONSE, 0, 0, ByteArray::EMPTY, length);
+				helper.getBuffer(next);
+
+				return true;
+			}
+			else if (sw1 == 0x6C && response.getLength() == 2 && helper.setCommand(apdu) == true)
+			{
+				/* same command with the length the card asks for */
+				helper.setMaxResponseSize(length);
+				helper.getBuffer(next);
+
+				return true;
+			}
 		}
 
-		SCARD_DEBUG("command [%d] : %s", command.getLength(), command.toString());
+		collected += response;
+
+		return false;
+	}
+
+	int ServerChannel::transmitSync(const ByteArray &command, ByteArray &result, unsigned int &count)
+	{
+		ByteArray apdu;
+		ByteArray response;
+		ByteArray next;
+		int rv;
+
+		count = 0;
+		result.releaseBuffer();
+
+		if ((rv = buildCommand(command, apdu)) != 0)
+			return rv;
+
+		while ((rv = terminal->transmitSync(apdu, response)) == 0 &&
+			chainResponse(apdu, response, result, count, next) == true)
+		{
+			SCARD_DEBUG("chained apdu [%d] : %s", count + 1, next.toString());
+
+			apdu = next;
+			count++;
+		}
+
+		if (rv != 0)
+		{
+			ServerResource::getInstance().invalidateATR(terminal);
+
+			result.releaseBuffer();
+		}
+
+		return rv;
+	}
+
+	int ServerChannel::transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results)
+	{
+		unsigned int count;
+
+		return transmitSync(commands, results, Message::TRANSMIT_BATCH_STOP_ON_ERROR, count);
+	}
+
+	int ServerChannel::transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results, unsigned int options, unsigned int &count, TerminalDispatcher *worker)
+	{
+		int rv = 0;
+		size_t i;
+
+		results.clear();
+		count = 0;
+
+		for (i = 0; i < commands.size(); i++)
+		{
+			ByteArray response;
+			unsigned int extra = 0;
+
+			if (i > 0 && worker != NULL)
+			{
+				worker->interleave();
+			}
+
+			if (options & Message::TRANSMIT_AUTO_GET_RESPONSE)
+			{
+				rv = transmitSync(commands[i], response, extra);
+				count += extra;
+			}
+			else
+			{
+				rv = transmitSync(commands[i], response);
+			}
+
+			if (rv != 0)
+			{
+				SCARD_DEBUG_ERR("transmit failed [%d], index [%d]", rv, i);
+				break;
+			}
+
+			results.push_back(response);
+
+			if (options & Message::TRANSMIT_BATCH_STOP_ON_ERROR)
+			{
+				ByteArrayView sw = ByteArrayView(response).subView(response.getLength() - 2, 2);
+
+				if (response.getLength() < 2 || sw[0] != 0x90 || sw[1] != 0x00)
+				{
+					SCARD_DEBUG("stop batch, index [%d], response %s", i, response.toString());
+					break;
+				}
+			}
+		}
 
-		return terminal->transmitSync(command, result);
+		return rv;
 	}
 
 } /* namespace smartcard_service_api */
@@ -18,6 +18,7 @@
 /* standard library header */
 #include <stdio.h>
 #include <string.h>
+#include <vector>
 
 /* SLP library header */
 
@@ -36,6 +37,8 @@ namespace smartcard_service_api
 	{
 		SCARD_BEGIN();
 
+		statisticsTimerID = 0;
+
 		runDispatcherThread();
 
 		SCARD_END();
@@ -52,6 +55,256 @@ namespace smartcard_service_api
 		return &instance;
 	}
 
+	bool ServerDispatcher::addTerminal(Terminal *terminal, void *library)
+	{
+		bool result = false;
+
+		SCOPE_LOCK(terminalLock)
+		{
+			if (mapTerminals.find(terminal) == mapTerminals.end())
+			{
+				TerminalDispatcher *worker = new TerminalDispatcher(terminal, library);
+				if (worker != NULL)
+				{
+					mapTerminals.insert(make_pair(terminal, worker));
+					result = true;
+				}
+				else
+				{
+					SCARD_DEBUG_ERR("alloc failed");
+				}
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("terminal already exist [%p]", terminal);
+			}
+		}
+
+		return result;
+	}
+
+	void ServerDispatcher::removeTerminal(Terminal *terminal)
+	{
+		TerminalDispatcher *worker = NULL;
+		map<Terminal *, TerminalDispatcher *>::iterator item;
+
+		SCOPE_LOCK(terminalLock)
+		{
+			if ((item = mapTerminals.find(terminal)) != mapTerminals.end())
+			{
+				worker = item->second;
+				mapTerminals.erase(item);
+			}
+		}
+
+		if (worker != NULL)
+		{
+			delete worker;
+		}
+	}
+
+	void ServerDispatcher::dumpStatistics()
+	{
+		map<Terminal *, TerminalDispatcher *>::iterator item;
+		vector<pair<const char *, vector<queue_statistics_t> > > snapshots;
+		vector<Terminal *> terminals;
+		vector<pool_statistics_t> pools;
+		LogicalChannelPool *pool = NULL;
+		size_t i, j;
+
+		/* copied quickly, logging doesn't hold up the routing of requests */
+		SCOPE_LOCK(terminalLock)
+		{
+			for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
+			{
+				terminals.push_back(item->first);
+				snapshots.push_back(make_pair(item->first->getName(), vector<queue_statistics_t>()));
+				item->second->getStatistics(snapshots.back().second);
+			}
+		}
+
+		/* pools are looked up under resourceLock, so not under terminalLock */
+		pools.resize(terminals.size());
+		for (i = 0; i < terminals.size(); i++)
+		{
+			memset(&pools[i], 0, sizeof(pools[i]));
+
+			if ((pool = ServerResource::getInstance().getChannelPool(terminals[i])) != NULL)
+			{
+				pool->getStatistics(pools[i]);
+			}
+		}
+
+		for (i = 0; i < snapshots.size(); i++)
+		{
+			if (pools[i].capacity > 0)
+			{
+				SCARD_DEBUG("terminal [%s] : channel pool hit [%u] miss [%u], idle [%u/%u]%s",
+					snapshots[i].first, pools[i].hit, pools[i].miss,
+					pools[i].idle, pools[i].capacity,
+					pools[i].disabled ? ", disabled" : "");
+			}
+
+			for (j = 0; j < snapshots[i].second.size(); j++)
+			{
+				queue_statistics_t &queue = snapshots[i].second[j];
+
+				SCARD_DEBUG("terminal [%s], socket [%d], channel [0x%08X] : depth [%d] max [%d], dispatched [%llu], wait avg [%llu] max [%llu] usec",
+					snapshots[i].first, queue.socket, queue.handle,
+					queue.statistics.depth, queue.statistics.maxDepth, queue.statistics.dispatched,
+					queue.statistics.dispatched ? queue.statistics.totalWait / queue.statistics.dispatched : 0,
+					queue.statistics.maxWait);
+			}
+		}
+	}
+
+	gboolean ServerDispatcher::statisticsCallback(gpointer user_data)
+	{
+		ServerDispatcher *dispatcher = (ServerDispatcher *)user_data;
+
+		dispatcher->dumpStatistics();
+
+		return TRUE;
+	}
+
+	void ServerDispatcher::startStatistics(unsigned int interval)
+	{
+		if (statisticsTimerID != 0)
+		{
+			g_source_remove(statisticsTimerID);
+			statisticsTimerID = 0;
+		}
+
+		if (interval > 0)
+		{
+			statisticsTimerID = g_timeout_add_seconds(interval, &ServerDispatcher::statisticsCallback, this);
+		}
+	}
+
+	TerminalDispatcher *ServerDispatcher::getTerminalDispatcher(DispatcherMsg *msg)
+	{
+		TerminalDispatcher *result = NULL;
+		Terminal *terminal = NULL;
+		ServerResource *resource = &ServerResource::getInstance();
+		int socket = msg->getPeerSocket();
+
+		/* requests which touch the secure element are served by the worker of its terminal */
+		switch (msg->message)
+		{
+		case Message::MSG_REQUEST_TRANSMIT :
+		case Message::MSG_REQUEST_TRANSMIT_BATCH :
+		case Message::MSG_REQUEST_CLOSE_CHANNEL :
+			terminal = resource->getTerminalByChannel(socket, msg->error/* service context */, msg->param1);
+			break;
+
+		case Message::MSG_REQUEST_OPEN_CHANNEL :
+			terminal = resource->getTerminalBySession(socket, msg->error/* service context */, msg->param2);
+			break;
+
+		case Message::MSG_REQUEST_GET_ATR :
+		case Message::MSG_REQUEST_CLOSE_SESSION :
+		case Message::MSG_REQUEST_CLOSE_CHANNELS :
+			terminal = resource->getTerminalBySession(socket, msg->error/* service context */, msg->param1);
+			break;
+
+		case Message::MSG_OPERATION_UPDATE_ACL :
+			terminal = (Terminal *)msg->caller;
+			break;
+
+		default :
+			break;
+		}
+
+		if (terminal != NULL)
+		{
+			map<Terminal *, TerminalDispatcher *>::iterator item;
+
+			SCOPE_LOCK(terminalLock)
+			{
+				if ((item = mapTerminals.find(terminal)) != mapTerminals.end())
+				{
+					result = item->second;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	void ServerDispatcher::pushMessage(DispatcherMsg *msg)
+	{
+		TerminalDispatcher *worker = NULL;
+
+		if ((worker = getTerminalDispatcher(msg)) != NULL)
+		{
+			worker->pushMessage(msg);
+		}
+		else if (msg->message == Message::MSG_OPERATION_UPDATE_ACL)
+		{
+			/* terminal is already removed */
+			delete msg;
+		}
+		else
+		{
+			/* control messages and invalid handles */
+			DispatcherHelper::pushMessage(msg);
+		}
+	}
+
+	void ServerDispatcher::lockTerminals()
+	{
+		size_t i;
+		vector<TerminalDispatcher *> list;
+		map<Terminal *, TerminalDispatcher *>::iterator item;
+
+		SCOPE_LOCK(terminalLock)
+		{
+			for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
+			{
+				list.push_back(item->second);
+			}
+		}
+
+		/* always in the same order, terminal workers never wait for each other */
+		for (i = 0; i < list.size(); i++)
+		{
+			list[i]->lock();
+		}
+	}
+
+	void ServerDispatcher::unlockTerminals()
+	{
+		size_t i;
+		vector<TerminalDispatcher *> list;
+		map<Terminal *, TerminalDispatcher *>::iterator item;
+
+		SCOPE_LOCK(terminalLock)
+		{
+			for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
+			{
+				list.push_back(item->second);
+			}
+		}
+
+		for (i = 0; i < list.size(); i++)
+		{
+			list[i]->unlock();
+		}
+	}
+
+	void ServerDispatcher::removeTerminalMessages(int socket)
+	{
+		map<Terminal *, TerminalDispatcher *>::iterator item;
+
+		SCOPE_LOCK(terminalLock)
+		{
+			for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
+			{
+				item->second->removeMessages(socket);
+			}
+		}
+	}
+
 	void *ServerDispatcher::dispatcherThreadFunc(DispatcherMsg *msg, void *data)
 	{
 		int socket = -1;
@@ -83,25 +336,29 @@ namespace smartcard_service_api
 				seService->dispatcherCallback(msg, msg->getPeerSocket());
 #else
 				int count = 0;
+				unsigned int version = 0;
 				Message response(*msg);
 				ByteArray info;
 				ClientInstance *instance = NULL;
 
 				if ((instance = resource->getClient(socket)) != NULL)
 				{
-					/* update client PID */
+					/* pid from the client is used only if the peer credential was not available */
 					if (instance->getPID() == -1)
 					{
 						instance->setPID(msg->error);
 						SCARD_DEBUG_ERR("update PID [%d]", msg->error);
 					}
 
+					/* package certificate hash of the process, used by sessions opened later */
+					instance->setCertificationHash(msg->data);
+
 					/* create service */
-					if (resource->getService(socket, (unsigned int)msg->userParam) == NULL)
+					if (resource->getService(socket, msg->param1 /* service context */) == NULL)
 					{
-						if (resource->createService(socket, (unsigned int)msg->userParam) == true)
+						if (resource->createService(socket, msg->param1 /* service context */) == true)
 						{
-							SCARD_DEBUG_ERR("client added : context [%d]", (unsigned int)msg->userParam);
+							SCARD_DEBUG_ERR("client added : context [%d]", msg->param1);
 						}
 						else
 						{
@@ -117,12 +374,21 @@ namespace smartcard_service_api
 						}
 					}
 
-					if ((count = resource->getReadersInformation(info)) > 0)
+					if ((count = resource->getReadersInformation(info, version)) > 0)
 					{
 						response.param1 = count;
-						response.param2 = 0;
+						response.param2 = version;
 						response.error = 0;
-						response.data = info;
+
+						/* client has this snapshot already */
+						if (msg->param2 == version)
+						{
+							response.data.releaseBuffer();
+						}
+						else
+						{
+							response.data = info;
+						}
 					}
 					else
 					{
@@ -171,7 +437,10 @@ namespace smartcard_service_api
 
 				response.error = 0;
 
+				/* channels of the service may be in use by terminal workers */
+				lockTerminals();
 				resource->removeService(socket, msg->error/* service context */);
+				unlockTerminals();
 
 				/* response to client */
 				ServerIPC::getInstance()->sendMessage(socket, &response);
@@ -213,8 +482,8 @@ namespace smartcard_service_api
 
 				if (resource->isValidReaderHandle(msg->param1))
 				{
-					handle = resource->createSession(socket, msg->error/* service context */, msg->param1, msg->data, msg->caller);
-					if (handle != IntegerHandle::INVALID_HANDLE)
+					handle = resource->createSession(socket, msg->error/* service context */, msg->param1, msg->caller);
+					if (handle != HandleTable::INVALID_HANDLE)
 					{
 						response.param1 = handle;
 						response.error = 0;
@@ -336,7 +605,7 @@ namespace smartcard_service_api
 				response.data.releaseBuffer();
 
 				channelID = resource->createChannel(socket, msg->error/* service context */, msg->param2, msg->param1, msg->data);
-				if (channelID != IntegerHandle::INVALID_HANDLE)
+				if (channelID != HandleTable::INVALID_HANDLE)
 				{
 					ServerChannel *temp = (ServerChannel *)resource->getChannel(socket, msg->error/* service context */, channelID);
 
@@ -419,6 +688,26 @@ namespace smartcard_service_api
 #endif
 			break;
 
+		case Message::MSG_REQUEST_CLOSE_CHANNELS :
+			{
+				Message response(*msg);
+
+				SCARD_DEBUG("[MSG_REQUEST_CLOSE_CHANNELS]");
+
+				response.error = -1;
+
+				/* all logical channels of the session are closed in this one worker turn */
+				if (resource->isValidSessionHandle(socket, msg->error/* service context */, msg->param1))
+				{
+					resource->removeChannels(socket, msg->error/* service context */, msg->param1);
+					response.error = 0;
+				}
+
+				/* response to client */
+				ServerIPC::getInstance()->sendMessage(socket, &response);
+			}
+			break;
+
 		case Message::MSG_REQUEST_GET_ATR :
 #if 0
 			{
@@ -443,7 +732,7 @@ namespace smartcard_service_api
 				int rv;
 				Message response(*msg);
 				ByteArray result;
-				ServiceInstance *client = NULL;
+				Terminal *terminal = NULL;
 
 				SCARD_DEBUG("[MSG_REQUEST_GET_ATR]");
 
@@ -451,32 +740,24 @@ namespace smartcard_service_api
 				response.param2 = 0;
 				response.error = -1;
 
-				if ((client = resource->getService(socket, msg->error/* service context */)) != NULL)
+				if ((terminal = resource->getTerminalBySession(socket, msg->error/* service context */, msg->param1)) != NULL)
 				{
-					Terminal *terminal = NULL;
-
-					if ((terminal = client->getTerminal(msg->param1)) != NULL)
+					/* read from the card once per insertion */
+					if ((rv = resource->getATR(terminal, result)) == 0)
 					{
-						if ((rv = terminal->getATRSync(result)) == 0)
-						{
-							response.data = result;
-							response.error = 0;
-						}
-						else
-						{
-							SCARD_DEBUG_ERR("transmit failed [%d]", rv);
-
-							response.error = rv;
-						}
+						response.data = result;
+						response.error = 0;
 					}
 					else
 					{
-						SCARD_DEBUG_ERR("getTerminal failed : socket [%d], context [%d], session [%d]", socket, msg->error/* service context */, msg->param1);
+						SCARD_DEBUG_ERR("transmit failed [%d]", rv);
+
+						response.error = rv;
 					}
 				}
 				else
 				{
-					SCARD_DEBUG_ERR("getClient failed : socket [%d], context [%d], session [%d]", socket, msg->error/* service context */, msg->param1);
+					SCARD_DEBUG_ERR("getTerminal failed : socket [%d], context [%d], session [%d]", socket, msg->error/* service context */, msg->param1);
 				}
 
 				/* response to client */
@@ -520,9 +801,10 @@ namespace smartcard_service_api
 #else
 			{
 				int rv;
+				unsigned int count = 0;
 				Message response(*msg);
 				ByteArray result;
-				Channel *channel = NULL;
+				ServerChannel *channel = NULL;
 
 				SCARD_DEBUG("[MSG_REQUEST_TRANSMIT]");
 
@@ -530,11 +812,21 @@ namespace smartcard_service_api
 				response.param2 = 0;
 				response.error = -1;
 
-				if ((channel = resource->getChannel(socket, msg->error/* service context */, msg->param1)) != NULL)
+				if ((channel = (ServerChannel *)resource->getChannel(socket, msg->error/* service context */, msg->param1)) != NULL)
 				{
-					if ((rv = channel->transmitSync(msg->data, result)) == 0)
+					if (msg->param2 & Message::TRANSMIT_AUTO_GET_RESPONSE)
+					{
+						rv = channel->transmitSync(msg->data, result, count);
+					}
+					else
+					{
+						rv = channel->transmitSync(msg->data, result);
+					}
+
+					if (rv == 0)
 					{
 						response.data = result;
+						response.param2 = count;
 						response.error = 0;
 					}
 					else
@@ -555,6 +847,75 @@ namespace smartcard_service_api
 #endif
 			break;
 
+		case Message::MSG_REQUEST_TRANSMIT_BATCH :
+			{
+				int rv;
+				unsigned int count = 0;
+				Message response(*msg);
+				vector<ByteArray> commands;
+				vector<ByteArray> results;
+				ServerChannel *channel = NULL;
+				TerminalDispatcher *worker = NULL;
+
+				SCARD_DEBUG("[MSG_REQUEST_TRANSMIT_BATCH]");
+
+				/* data is the queue running this, other channels of the terminal may run between the apdus */
+				if (data != (void *)this)
+				{
+					worker = (TerminalDispatcher *)data;
+				}
+
+				response.param1 = 0;
+				response.param2 = 0;
+				response.error = -1;
+				response.data.releaseBuffer();
+
+				if ((channel = (ServerChannel *)resource->getChannel(socket, msg->error/* service context */, msg->param1)) != NULL)
+				{
+					if (Message::deserializeList(msg->data, commands) == true && commands.size() > 0 &&
+						commands.size() <= Message::MAX_BATCH_COUNT)
+					{
+						rv = channel->transmitSync(commands, results, msg->param2, count, worker);
+
+						/* responses of executed apdus are returned even if one of them failed */
+						response.param1 = results.size();
+						response.param2 = count;
+						response.data = Message::serializeList(results);
+						response.error = rv;
+					}
+					else
+					{
+						SCARD_DEBUG_ERR("invalid batch data, length [%d]", msg->data.getLength());
+					}
+				}
+				else
+				{
+					SCARD_DEBUG_ERR("invalid handle : socket [%d], context [%d], channel [%d]", socket, msg->error/* service context */, msg->param1);
+				}
+
+				/* response to client */
+				ServerIPC::getInstance()->sendMessage(socket, &response);
+			}
+			break;
+
+		case Message::MSG_OPERATION_UPDATE_ACL :
+			{
+				Terminal *terminal = (Terminal *)msg->caller;
+
+				SCARD_DEBUG("[MSG_OPERATION_UPDATE_ACL]");
+
+				/* running on the worker of this terminal, presence check is card i/o as well */
+				if (terminal->isSecureElementPresence() == true)
+				{
+					resource->updateAccessControlList(terminal, msg->param1 != 0);
+				}
+				else
+				{
+					SCARD_DEBUG("secure element is not present, terminal [%s]", terminal->getName());
+				}
+			}
+			break;
+
 		case Message::MSG_OPERATION_RELEASE_CLIENT :
 #if 0
 			{
@@ -578,7 +939,11 @@ namespace smartcard_service_api
 			{
 				SCARD_DEBUG("[MSG_OPERATION_RELEASE_CLIENT]");
 
+				lockTerminals();
+				/* drop pending requests before the socket number can be reused */
+				removeTerminalMessages(msg->param1);
 				resource->removeClient(msg->param1);
+				unlockTerminals();
 			}
 #endif
 			break;
@@ -14,9 +14,13 @@
 * limitations under the License.
 */
 
+
 /* standard library header */
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 
 /* SLP library header */
@@ -29,10 +33,37 @@
 
 namespace smartcard_service_api
 {
+	IPCConnection::~IPCConnection()
+	{
+		if (msg != NULL)
+			delete msg;
+
+		closeDescriptors();
+#ifdef USE_SHM_TRANSPORT
+		if (shm != NULL)
+			delete shm;
+#endif
+	}
+
+	void IPCConnection::closeDescriptors()
+	{
+		size_t i;
+
+		for (i = 0; i < fds.size(); i++)
+		{
+			close(fds[i]);
+		}
+
+		fds.clear();
+	}
+
 	ServerIPC::ServerIPC():IPCHelper()
 	{
 		SCARD_BEGIN();
 
+		epollFd = -1;
+		memset(&reactorThread, 0, sizeof(reactorThread));
+
 		setDispatcher(ServerDispatcher::getInstance());
 
 		SCARD_END();
@@ -49,198 +80,925 @@ namespace smartcard_service_api
 		return &instance;
 	}
 
-	bool ServerIPC::acceptClient()
+	bool ServerIPC::createListenSocket()
 	{
-		GIOCondition condition = (GIOCondition)(G_IO_ERR | G_IO_HUP | G_IO_IN);
-		socklen_t addrlen = 0;
-		int client_sock_fd = 0;
-		GIOChannel *client_channel = NULL;
-		int client_src_id;
+		struct epoll_event event;
 
-		SCARD_DEBUG("client is trying to connect to server");
+		SCARD_BEGIN();
 
-		pthread_mutex_lock(&ipcLock);
-		client_sock_fd = accept(ipcSocket, NULL, &addrlen);
-		pthread_mutex_unlock(&ipcLock);
+		if (epollFd >= 0)
+			return true;
 
-		if (client_sock_fd < 0)
+		if (openListenSocket() == false)
 		{
-			SCARD_DEBUG_ERR("can not accept client");
-			goto ERROR;
+			SCARD_DEBUG_ERR("openListenSocket failed");
+			return false;
 		}
 
-		SCARD_DEBUG("client is accepted by server");
-
-		if ((client_channel = g_io_channel_unix_new(client_sock_fd)) == NULL)
+		if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0)
 		{
-			SCARD_DEBUG_ERR("create new g io channel is failed");
+			SCARD_DEBUG_ERR("epoll_create1 failed, [%d]", errno);
 			goto ERROR;
 		}
 
-		if ((client_src_id = g_io_add_watch(client_channel, condition, &IPCHelper::channelCallbackFunc, this)) < 1)
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = ipcSocket;
+
+		if (epoll_ctl(epollFd, EPOLL_CTL_ADD, ipcSocket, &event) < 0)
 		{
-			SCARD_DEBUG_ERR("add io callback is failed");
+			SCARD_DEBUG_ERR("epoll_ctl failed, [%d]", errno);
 			goto ERROR;
 		}
 
-		SCARD_DEBUG("client socket is bound with g_io_channel");
+		/* sources registered before the loop existed */
+		SCOPE_LOCK(connectionLock)
+		{
+			map<int, pair<ipcEventHandler, void *> >::iterator item;
+
+			for (item = mapEventSources.begin(); item != mapEventSources.end(); item++)
+			{
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN;
+				event.data.fd = item->first;
+
+				if (epoll_ctl(epollFd, EPOLL_CTL_ADD, item->first, &event) < 0)
+				{
+					SCARD_DEBUG_ERR("epoll_ctl failed, fd [%d], [%d]", item->first, errno);
+				}
+			}
+		}
 
-		if (ServerResource::getInstance().createClient(client_channel, client_sock_fd, client_src_id, 0, -1) == false)
+		/* sockets are served by the reactor thread, glib main loop only runs timers */
+		if (pthread_create(&reactorThread, NULL, &ServerIPC::reactorThreadFunc, this) != 0)
 		{
-			SCARD_DEBUG_ERR("failed to add client");
+			SCARD_DEBUG_ERR("pthread_create failed");
+			goto ERROR;
 		}
 
+		SCARD_DEBUG("server ipc is initialized");
+
+		SCARD_END();
+
 		return true;
 
 ERROR :
-		if (client_channel != NULL)
+		if (epollFd >= 0)
+		{
+			close(epollFd);
+			epollFd = -1;
+		}
+
+		closeListenSocket();
+
+		SCARD_END();
+
+		return false;
+	}
+
+	void *ServerIPC::reactorThreadFunc(void *data)
+	{
+		ServerIPC *ipc = (ServerIPC *)data;
+
+		ipc->runReactor();
+
+		return NULL;
+	}
+
+	void ServerIPC::runReactor()
+	{
+		struct epoll_event events[IPC_MAX_EVENTS];
+		int count, i;
+
+		while (true)
+		{
+			count = epoll_wait(epollFd, events, IPC_MAX_EVENTS, -1);
+			if (count < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				SCARD_DEBUG_ERR("epoll_wait failed, [%d]", errno);
+				break;
+			}
+
+			for (i = 0; i < count; i++)
+			{
+				if (events[i].data.fd == ipcSocket)
+				{
+					if (events[i].events & (EPOLLERR | EPOLLHUP))
+					{
+						SCARD_DEBUG("server socket is closed");
+						restartServerIPC();
+					}
+					else
+					{
+						/* connect state. should accept */
+						while (acceptClient() == true);
+					}
+				}
+#ifdef USE_SHM_TRANSPORT
+				else if (handleDoorbellEvent(events[i].data.fd) == true)
+				{
+					/* requests from the shared ring */
+				}
+#endif
+				else if (handleEventSource(events[i].data.fd) == true)
+				{
+					/* completions of terminal plugins */
+				}
+				else
+				{
+					handleClientEvent(events[i].data.fd, events[i].events);
+				}
+			}
+		}
+	}
+
+	bool ServerIPC::acceptClient()
+	{
+		struct epoll_event event;
+		IPCConnection *connection = NULL;
+		struct ucred cred;
+		socklen_t credLength;
+		int client_sock_fd;
+
+		client_sock_fd = accept4(ipcSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client_sock_fd < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				SCARD_DEBUG_ERR("can not accept client, [%d]", errno);
+			}
+
+			return false;
+		}
+
+		SCARD_DEBUG("client is accepted by server, socket [%d]", client_sock_fd);
+
+		/* identity comes from the kernel, not from what the client tells */
+		credLength = sizeof(cred);
+		if (getsockopt(client_sock_fd, SOL_SOCKET, SO_PEERCRED, &cred, &credLength) == 0)
+		{
+			SCARD_DEBUG("peer credential : pid [%d], uid [%d]", cred.pid, cred.uid);
+		}
+		else
 		{
-			g_io_channel_unref(client_channel);
+			SCARD_DEBUG_ERR("getsockopt SO_PEERCRED failed, [%d]", errno);
+
+			cred.pid = -1;
+			cred.uid = (uid_t)-1;
 		}
 
-		if (client_sock_fd != -1)
+		if (ServerResource::getInstance().createClient(NULL, client_sock_fd, 0, 0, cred.pid, cred.uid) == false)
 		{
+			SCARD_DEBUG_ERR("failed to add client");
+
 			shutdown(client_sock_fd, SHUT_RDWR);
 			close(client_sock_fd);
+
+			return true;
 		}
 
-		return false;
+		connection = new IPCConnection(client_sock_fd);
+		if (connection != NULL)
+		{
+			SCOPE_LOCK(connectionLock)
+			{
+				mapConnections.insert(make_pair(client_sock_fd, connection));
+			}
+
+			memset(&event, 0, sizeof(event));
+			event.events = EPOLLIN | EPOLLRDHUP;
+			event.data.fd = client_sock_fd;
+
+			if (epoll_ctl(epollFd, EPOLL_CTL_ADD, client_sock_fd, &event) == 0)
+			{
+				return true;
+			}
+
+			SCARD_DEBUG_ERR("epoll_ctl failed, [%d]", errno);
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("alloc failed");
+		}
+
+		/* closes the socket too */
+		ServerResource::getInstance().removeClient(client_sock_fd);
+
+		return true;
 	}
 
 	void ServerIPC::restartServerIPC()
 	{
-		if (watchId != 0)
+		struct epoll_event event;
+
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, ipcSocket, NULL);
+
+		closeListenSocket();
+
+		if (openListenSocket() == true)
 		{
-			g_source_remove(watchId);
-			watchId = 0;
-		}
+			memset(&event, 0, sizeof(event));
+			event.events = EPOLLIN;
+			event.data.fd = ipcSocket;
 
-		if (ioChannel != NULL)
+			if (epoll_ctl(epollFd, EPOLL_CTL_ADD, ipcSocket, &event) < 0)
+			{
+				SCARD_DEBUG_ERR("epoll_ctl failed, [%d]", errno);
+			}
+		}
+		else
 		{
-			g_io_channel_unref(ioChannel);
-			ioChannel = NULL;
+			SCARD_DEBUG_ERR("openListenSocket failed");
 		}
+	}
 
-		if (ipcSocket != -1)
+	void ServerIPC::releaseClient(void *channel, int socket, int watchID)
+	{
+		IPCConnection *connection = NULL;
+		map<int, IPCConnection *>::iterator item;
+
+		SCOPE_LOCK(connectionLock)
 		{
-			shutdown(ipcSocket, SHUT_RDWR);
-			close(ipcSocket);
+			if ((item = mapConnections.find(socket)) != mapConnections.end())
+			{
+				connection = item->second;
+				mapConnections.erase(item);
+
+#ifdef USE_SHM_TRANSPORT
+				if (connection->shm != NULL)
+				{
+					int doorbell = connection->shm->getReceiveDoorbell();
 
-			ipcSocket = -1;
+					epoll_ctl(epollFd, EPOLL_CTL_DEL, doorbell, NULL);
+					mapDoorbells.erase(doorbell);
+				}
+#endif
+			}
+		}
+
+		if (socket >= 0)
+		{
+			/* may be removed already by the reactor */
+			epoll_ctl(epollFd, EPOLL_CTL_DEL, socket, NULL);
 		}
 
-		createListenSocket();
+		if (connection != NULL)
+		{
+			/* senders in progress fail from now, the last one closes the socket */
+			shutdown(socket, SHUT_RDWR);
+
+			putConnection(connection);
+		}
+		else if (socket >= 0)
+		{
+			/* socket number can be reused from now */
+			shutdown(socket, SHUT_RDWR);
+			close(socket);
+		}
 	}
 
-	void ServerIPC::releaseClient(void *channel, int socket, int watchID)
+	IPCConnection *ServerIPC::getConnection(int socket)
 	{
-		if (watchID != 0)
+		IPCConnection *connection = NULL;
+		map<int, IPCConnection *>::iterator item;
+
+		SCOPE_LOCK(connectionLock)
 		{
-			g_source_remove(watchID);
+			if ((item = mapConnections.find(socket)) != mapConnections.end())
+			{
+				connection = item->second;
+				connection->refCount++;
+			}
 		}
 
-		if (channel != NULL)
+		return connection;
+	}
+
+	void ServerIPC::putConnection(IPCConnection *connection)
+	{
+		bool last = false;
+
+		SCOPE_LOCK(connectionLock)
 		{
-			g_io_channel_unref((GIOChannel *)channel);
+			last = (--connection->refCount == 0);
 		}
 
-		if (socket >= 0)
+		if (last == true)
 		{
-			shutdown(socket, SHUT_RDWR);
+			int socket = connection->socket;
+
+			delete connection;
+
+			/* socket number can be reused from now */
 			close(socket);
 		}
 	}
 
-	int ServerIPC::handleIOErrorCondition(void *channel, GIOCondition condition)
+	ssize_t ServerIPC::receiveData(IPCConnection *connection, void *buffer, size_t length)
 	{
-		SCARD_BEGIN();
+		struct iovec iov;
+		struct msghdr mh;
+		struct cmsghdr *cmsg;
+		char control[CMSG_SPACE(sizeof(int) * IPC_MAX_DESCRIPTORS)];
+		ssize_t readBytes;
+		int fd;
+		size_t i, count;
+
+		iov.iov_base = buffer;
+		iov.iov_len = length;
+
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = &iov;
+		mh.msg_iovlen = 1;
+		mh.msg_control = control;
+		mh.msg_controllen = sizeof(control);
+
+		/* plain recv would drop passed descriptors */
+		readBytes = recvmsg(connection->socket, &mh, MSG_CMSG_CLOEXEC);
+		if (readBytes > 0)
+		{
+			for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg))
+			{
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+				{
+					count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+					for (i = 0; i < count; i++)
+					{
+						memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+						connection->fds.push_back(fd);
+					}
+				}
+			}
+		}
 
-		if(channel == ioChannel)
+		return readBytes;
+	}
+
+	bool ServerIPC::receiveFrames(IPCConnection *connection, vector<DispatcherMsg *> &messages)
+	{
+		ssize_t readBytes;
+		int frames = 0;
+
+		/* read what is available and keep the rest of a frame for the next wakeup */
+		while (frames < IPC_MAX_FRAMES)
 		{
-			SCARD_DEBUG("server socket is closed");
-			restartServerIPC();
+			if (connection->received < sizeof(connection->header))
+			{
+				readBytes = receiveData(connection, (char *)&connection->header + connection->received, sizeof(connection->header) - connection->received);
+			}
+			else
+			{
+				unsigned int offset = connection->received - sizeof(connection->header);
+
+				readBytes = receiveData(connection, connection->msg->data.getBuffer(offset), connection->header.dataLength - offset);
+			}
+
+			if (readBytes > 0)
+			{
+				connection->received += readBytes;
+
+				if (connection->msg == NULL && connection->received == sizeof(connection->header))
+				{
+					/* length comes from the peer, never allocate what it asks blindly */
+					if (connection->header.dataLength > Message::getMaxDataLength(connection->header.message))
+					{
+						SCARD_DEBUG_ERR("frame is too long, socket [%d], length [%u]", connection->socket, connection->header.dataLength);
+						return false;
+					}
+
+					connection->msg = new DispatcherMsg();
+					if (connection->msg == NULL)
+					{
+						SCARD_DEBUG_ERR("alloc failed");
+						return false;
+					}
+
+					connection->msg->setHeader(&connection->header);
+					connection->msg->setPeerSocket(connection->socket);
+
+					/* payload is read straight into the message */
+					if (connection->msg->data.allocBuffer(connection->header.dataLength) == false)
+					{
+						SCARD_DEBUG_ERR("allocation failed, length [%d]", connection->header.dataLength);
+						return false;
+					}
+				}
+
+				if (connection->msg != NULL && connection->received == sizeof(connection->header) + connection->header.dataLength)
+				{
+					SCARD_DEBUG("<<<[RETRIEVE]<<< socket [%d], msg [%d], length [%d]", connection->socket, connection->header.message, connection->header.dataLength);
+
+					if (connection->header.message == (unsigned int)Message::MSG_OPERATION_ATTACH_SHM)
+					{
+						/* transport setup never reaches the dispatcher */
+						attachTransport(connection);
+
+						delete connection->msg;
+					}
+					else
+					{
+						if (connection->fds.size() > 0)
+						{
+							SCARD_DEBUG_ERR("unexpected descriptors, socket [%d]", connection->socket);
+							connection->closeDescriptors();
+						}
+
+						messages.push_back(connection->msg);
+					}
+
+					connection->msg = NULL;
+					connection->received = 0;
+					frames++;
+				}
+			}
+			else if (readBytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			else if (readBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				break;
+			}
+			else
+			{
+				/* closed by peer or error */
+				return false;
+			}
 		}
-		else
+
+		return true;
+	}
+
+	void ServerIPC::handleClientEvent(int socket, unsigned int events)
+	{
+		bool alive = false;
+		size_t i;
+		vector<DispatcherMsg *> messages;
+		map<int, IPCConnection *>::iterator item;
+
+		SCOPE_LOCK(connectionLock)
+		{
+			if ((item = mapConnections.find(socket)) != mapConnections.end())
+			{
+				alive = true;
+
+				if (events & EPOLLOUT)
+				{
+					SCOPE_LOCK(item->second->sendLock)
+					{
+						alive = flushFrames(item->second);
+					}
+				}
+
+				/* drain data first, the last requests may come with hang up */
+				if (alive == true && (events & ~EPOLLOUT) != 0)
+				{
+					alive = receiveFrames(item->second, messages);
+				}
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("client context doesn't exist, socket [%d]", socket);
+			}
+		}
+
+		/* pushed after unlocking, dispatcher takes the resource lock */
+		for (i = 0; i < messages.size(); i++)
 		{
-			DispatcherMsg *dispMsg = NULL;
-			int peerSocket = g_io_channel_unix_get_fd((GIOChannel *)channel);
+			ServerDispatcher::getInstance()->pushMessage(messages[i]);
+		}
 
-			SCARD_DEBUG("client socket is closed, socket [%d]", peerSocket);
+		if (alive == false || (events & (EPOLLERR | EPOLLHUP)))
+		{
+			SCARD_DEBUG("client socket is closed, socket [%d]", socket);
 
-			/* push messsage to dispatcher */
-			dispMsg = new DispatcherMsg();
+			disconnectClient(socket);
+		}
+	}
 
+	void ServerIPC::disconnectClient(int socket)
+	{
+		DispatcherMsg *dispMsg = NULL;
+
+		/* no more events, the socket is closed by removeClient */
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, socket, NULL);
+
+		/* push messsage to dispatcher */
+		dispMsg = new DispatcherMsg();
+		if (dispMsg != NULL)
+		{
 			dispMsg->message = Message::MSG_OPERATION_RELEASE_CLIENT;
-			dispMsg->param1 = peerSocket;
-			dispMsg->setPeerSocket(peerSocket);
+			dispMsg->param1 = socket;
+			dispMsg->setPeerSocket(socket);
 
 			/* push to dispatcher */
 			ServerDispatcher::getInstance()->pushMessage(dispMsg);
 		}
+	}
 
-		SCARD_END();
+	/* called with sendLock held. never waits for the peer, which would stall
+	 * the reactor or a terminal worker behind a client that doesn't read */
+	bool ServerIPC::queueFrame(IPCConnection *connection, Message *msg)
+	{
+		message_header_t header;
+		struct iovec iov[2];
+		struct msghdr mh;
+		ByteArray frame;
+		ssize_t sentBytes = 0;
+		unsigned int waiting;
 
-		return FALSE;
+		msg->getHeader(&header);
+
+		if (connection->pending.getLength() == 0)
+		{
+			SCARD_DEBUG(">>>[SEND]>>> socket [%d], msg [%d], length [%d]", connection->socket, msg->message, header.dataLength);
+
+			iov[0].iov_base = &header;
+			iov[0].iov_len = sizeof(header);
+			iov[1].iov_base = msg->data.getBuffer();
+			iov[1].iov_len = header.dataLength;
+
+			memset(&mh, 0, sizeof(mh));
+			mh.msg_iov = iov;
+			mh.msg_iovlen = (header.dataLength > 0) ? 2 : 1;
+
+			do
+			{
+				sentBytes = sendmsg(connection->socket, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+			}
+			while (sentBytes < 0 && errno == EINTR);
+
+			if (sentBytes < 0)
+			{
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+				{
+					SCARD_DEBUG_ERR("send failed, socket [%d], errno [%d]", connection->socket, errno);
+					return false;
+				}
+
+				sentBytes = 0;
+			}
+
+			if ((size_t)sentBytes == sizeof(header) + header.dataLength)
+			{
+				return true;
+			}
+		}
+
+		/* the rest goes out when the socket becomes writable */
+		waiting = connection->pending.getLength() - connection->pendingOffset;
+		if (waiting + sizeof(header) + header.dataLength - sentBytes > IPC_MAX_PENDING)
+		{
+			SCARD_DEBUG_ERR("client doesn't read, socket [%d], pending [%d]", connection->socket, waiting);
+
+			/* the reactor sees the hang up and releases the client */
+			shutdown(connection->socket, SHUT_RDWR);
+
+			return false;
+		}
+
+		frame = msg->serialize();
+
+		if (connection->pendingOffset > 0)
+		{
+			connection->pending = ByteArray(connection->pending.getBuffer(connection->pendingOffset), waiting);
+			connection->pendingOffset = 0;
+		}
+
+		connection->pending += ByteArray(frame.getBuffer(sentBytes), frame.getLength() - sentBytes);
+
+		if (waiting == 0)
+		{
+			watchWritable(connection, true);
+		}
+
+		return true;
 	}
 
-	int ServerIPC::handleInvalidSocketCondition(void *channel, GIOCondition condition)
+	/* called with sendLock held */
+	bool ServerIPC::flushFrames(IPCConnection *connection)
 	{
-		SCARD_BEGIN();
-		SCARD_END();
+		ssize_t sentBytes;
 
-		return FALSE;
+		while (connection->pendingOffset < connection->pending.getLength())
+		{
+			sentBytes = send(connection->socket, connection->pending.getBuffer(connection->pendingOffset),
+				connection->pending.getLength() - connection->pendingOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (sentBytes > 0)
+			{
+				connection->pendingOffset += sentBytes;
+			}
+			else if (sentBytes < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			else if (sentBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				return true;
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("send failed, socket [%d], errno [%d]", connection->socket, errno);
+				return false;
+			}
+		}
+
+		connection->pending.releaseBuffer();
+		connection->pendingOffset = 0;
+
+		watchWritable(connection, false);
+
+		return true;
 	}
 
-	int ServerIPC::handleIncomingCondition(void *channel, GIOCondition condition)
+	void ServerIPC::watchWritable(IPCConnection *connection, bool writable)
 	{
-		int result = FALSE;
+		struct epoll_event event;
 
-		SCARD_BEGIN();
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN | EPOLLRDHUP | (writable ? EPOLLOUT : 0);
+		event.data.fd = connection->socket;
 
-		if(channel == ioChannel)
+		/* fails once the client is released, nothing to watch then */
+		epoll_ctl(epollFd, EPOLL_CTL_MOD, connection->socket, &event);
+	}
+
+	/* called by the reactor with connectionLock held */
+	void ServerIPC::attachTransport(IPCConnection *connection)
+	{
+		Message response;
+
+		response.message = Message::MSG_OPERATION_ATTACH_SHM;
+		response.error = -1;
+
+#ifdef USE_SHM_TRANSPORT
+		IPCSharedMemory *shm = NULL;
+		struct epoll_event event;
+		int doorbell;
+
+		if (connection->shm == NULL && (shm = new IPCSharedMemory()) != NULL)
 		{
-			/* connect state. should accept */
-			SCARD_DEBUG("new client connected");
+			/* descriptors are owned by shm from now, even on failure */
+			if (shm->attach(connection->fds.size() > 0 ? &connection->fds[0] : NULL, connection->fds.size()) == true)
+			{
+				connection->fds.clear();
+
+				doorbell = shm->getReceiveDoorbell();
+
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN;
+				event.data.fd = doorbell;
+
+				if (epoll_ctl(epollFd, EPOLL_CTL_ADD, doorbell, &event) == 0)
+				{
+					/* ring is empty, the first request has to ring */
+					shm->prepareWait();
+					mapDoorbells.insert(make_pair(doorbell, connection->socket));
+
+					response.error = 0;
+				}
+				else
+				{
+					SCARD_DEBUG_ERR("epoll_ctl failed, [%d]", errno);
+				}
+			}
+			else
+			{
+				connection->fds.clear();
+			}
 
-			result = acceptClient();
+			if (response.error != 0)
+			{
+				delete shm;
+				shm = NULL;
+			}
 		}
-		else
+#endif
+		connection->closeDescriptors();
+
+		SCOPE_LOCK(connection->sendLock)
 		{
-			int peerSocket = g_io_channel_unix_get_fd((GIOChannel *)channel);
+			/* acknowledged on the socket, the rings are used after it */
+			queueFrame(connection, &response);
+#ifdef USE_SHM_TRANSPORT
+			if (shm != NULL)
+			{
+				connection->shm = shm;
+			}
+#endif
+		}
 
-			SCARD_DEBUG("data incomming from [%d]", peerSocket);
+		SCARD_DEBUG("transport of socket [%d] : %s", connection->socket, response.error == 0 ? "shared memory" : "socket");
+	}
 
-			if (peerSocket >= 0)
+#ifdef USE_SHM_TRANSPORT
+	bool ServerIPC::handleDoorbellEvent(int doorbell)
+	{
+		bool found = false;
+		bool alive = true;
+		int socket = -1;
+		int ret = 0, frames = 0;
+		size_t i;
+		vector<DispatcherMsg *> messages;
+		map<int, int>::iterator item;
+		map<int, IPCConnection *>::iterator connection;
+
+		SCOPE_LOCK(connectionLock)
+		{
+			if ((item = mapDoorbells.find(doorbell)) != mapDoorbells.end())
 			{
-				Message *msg = NULL;
+				found = true;
+				socket = item->second;
 
-				/* read message */
-				if ((msg = retrieveMessage(peerSocket)) != NULL)
+				if ((connection = mapConnections.find(socket)) != mapConnections.end() &&
+					connection->second->shm != NULL)
 				{
-					DispatcherMsg *dispMsg = new DispatcherMsg(msg, peerSocket);
+					IPCSharedMemory *shm = connection->second->shm;
+					DispatcherMsg *msg;
+
+					shm->clearDoorbell();
+
+					while (frames < IPC_MAX_FRAMES)
+					{
+						msg = new DispatcherMsg();
+
+						if ((ret = shm->receiveMessage(msg)) <= 0)
+						{
+							delete msg;
+							break;
+						}
+
+						msg->setPeerSocket(socket);
+						messages.push_back(msg);
+						frames++;
+					}
+
+					if (ret < 0)
+					{
+						epoll_ctl(epollFd, EPOLL_CTL_DEL, doorbell, NULL);
+						alive = false;
+					}
+					else if (frames == IPC_MAX_FRAMES || shm->prepareWait() == false)
+					{
+						/* the rest is read on the next wakeup */
+						shm->rearmDoorbell();
+					}
+				}
+			}
+		}
 
-					/* push to dispatcher */
-					ServerDispatcher::getInstance()->pushMessage(dispMsg);
+		/* pushed after unlocking, dispatcher takes the resource lock */
+		for (i = 0; i < messages.size(); i++)
+		{
+			ServerDispatcher::getInstance()->pushMessage(messages[i]);
+		}
 
-					result = TRUE;
+		if (alive == false)
+		{
+			SCARD_DEBUG_ERR("request ring is corrupted, socket [%d]", socket);
 
-					delete msg;
-				}
-				else
+			disconnectClient(socket);
+		}
+
+		return found;
+	}
+#endif
+
+	bool ServerIPC::addEventSource(int fd, ipcEventHandler handler, void *userParam)
+	{
+		bool result = false;
+		struct epoll_event event;
+
+		if (fd < 0 || handler == NULL)
+			return result;
+
+		SCOPE_LOCK(connectionLock)
+		{
+			if (mapEventSources.find(fd) == mapEventSources.end())
+			{
+				mapEventSources.insert(make_pair(fd, make_pair(handler, userParam)));
+				result = true;
+
+				if (epollFd >= 0)
 				{
-					/* clear client connection */
-					SCARD_DEBUG_ERR("retrieve message failed, socket [%d]", peerSocket);
+					memset(&event, 0, sizeof(event));
+					event.events = EPOLLIN;
+					event.data.fd = fd;
+
+					if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+					{
+						SCARD_DEBUG_ERR("epoll_ctl failed, fd [%d], [%d]", fd, errno);
+
+						mapEventSources.erase(fd);
+						result = false;
+					}
 				}
 			}
 			else
 			{
-				SCARD_DEBUG_ERR("client context doesn't exist, socket [%d]", peerSocket);
+				SCARD_DEBUG_ERR("event source already exist [%d]", fd);
 			}
 		}
 
-		SCARD_END();
+		return result;
+	}
+
+	void ServerIPC::removeEventSource(int fd)
+	{
+		SCOPE_LOCK(connectionLock)
+		{
+			if (mapEventSources.erase(fd) > 0 && epollFd >= 0)
+			{
+				epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+			}
+		}
+	}
+
+	bool ServerIPC::handleEventSource(int fd)
+	{
+		ipcEventHandler handler = NULL;
+		void *userParam = NULL;
+		map<int, pair<ipcEventHandler, void *> >::iterator item;
+
+		SCOPE_LOCK(connectionLock)
+		{
+			if ((item = mapEventSources.find(fd)) != mapEventSources.end())
+			{
+				handler = item->second.first;
+				userParam = item->second.second;
+			}
+		}
+
+		/* called unlocked, completions send replies */
+		if (handler != NULL)
+		{
+			handler(fd, userParam);
+		}
+
+		return (handler != NULL);
+	}
+
+	bool ServerIPC::sendMessage(int socket, Message *msg)
+	{
+		bool result = false;
+		IPCConnection *connection;
+
+		/* the reference keeps the connection while releaseClient runs */
+		if ((connection = getConnection(socket)) != NULL)
+		{
+			/* writers of other clients are not blocked */
+			SCOPE_LOCK(connection->sendLock)
+			{
+#ifdef USE_SHM_TRANSPORT
+				int ret = 1;
+
+				/* frames waiting on the socket go first */
+				if (connection->shm != NULL && connection->pending.getLength() == 0)
+				{
+					ret = connection->shm->sendMessage(msg);
+				}
+
+				if (ret == 0)
+				{
+					result = true;
+				}
+				else if (ret > 0)
+				{
+					result = queueFrame(connection, msg);
+				}
+#else
+				result = queueFrame(connection, msg);
+#endif
+			}
+
+			putConnection(connection);
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("client context doesn't exist, socket [%d]", socket);
+		}
 
 		return result;
 	}
 
+	/* client sockets are not bound to glib any more */
+	int ServerIPC::handleIOErrorCondition(void *channel, GIOCondition condition)
+	{
+		return FALSE;
+	}
+
+	int ServerIPC::handleInvalidSocketCondition(void *channel, GIOCondition condition)
+	{
+		return FALSE;
+	}
+
+	int ServerIPC::handleIncomingCondition(void *channel, GIOCondition condition)
+	{
+		return FALSE;
+	}
+
 } /* namespace smartcard_service_api */
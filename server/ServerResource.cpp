@@ -21,58 +21,20 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <dirent.h>
+#include <time.h>
 
 /* SLP library header */
 
 /* local header */
 #include "Debug.h"
 #include "ServerResource.h"
+#include "ServerACLManager.h"
 #include "TerminalInterface.h"
 #include "APDUHelper.h"
-#include "SignatureHelper.h"
 #include "GPSEACL.h"
 
 namespace smartcard_service_api
 {
-	unsigned int IntegerHandle::newHandle = 0;
-	set<unsigned int> IntegerHandle::setHandles;
-	PMutex IntegerHandle::mutexLock;
-
-	unsigned int IntegerHandle::assignHandle()
-	{
-		SCOPE_LOCK(mutexLock)
-		{
-			pair<set<unsigned int>::iterator, bool> result;
-
-			do
-			{
-				newHandle++;
-				if (newHandle == (unsigned int)-1)
-				{
-					newHandle = 1;
-				}
-
-				result = setHandles.insert(newHandle);
-
-			}
-			while (!result.second);
-		}
-
-		SCARD_DEBUG("assign handle : newHandle [%d]", newHandle);
-
-		return newHandle;
-	}
-
-	void IntegerHandle::releaseHandle(unsigned int handle)
-	{
-		SCARD_DEBUG("will be released : Handle [%d]", handle);
-
-		SCOPE_LOCK(mutexLock)
-		{
-			setHandles.erase(handle);
-		}
-	}
-
 #define OMAPI_SE_PATH "/usr/lib/se"
 
 	ServerResource::ServerResource()
@@ -82,9 +44,14 @@ namespace smartcard_service_api
 		serverIPC = ServerIPC::getInstance();
 		serverDispatcher = ServerDispatcher::getInstance();
 
+		/* clients may keep a version of the previous daemon */
+		readersCount = 0;
+		readersVersion = (unsigned int)time(NULL);
+
 #if 1
 		loadSecureElements();
 #endif
+		updateReadersInformation();
 		SCARD_END();
 	}
 
@@ -99,27 +66,30 @@ namespace smartcard_service_api
 		return serverResource;
 	}
 
-	bool ServerResource::createClient(void *ioChannel, int socket, int watchID, int state, int pid)
+	bool ServerResource::createClient(void *ioChannel, int socket, int watchID, int state, int pid, uid_t uid)
 	{
 		bool result = false;
 
-		if (getClient(socket) == NULL)
+		SCOPE_LOCK(resourceLock)
 		{
-			ClientInstance *instance = new ClientInstance(ioChannel, socket, watchID, state, pid);
-			if (instance != NULL)
+			if (getClient(socket) == NULL)
 			{
-				mapClients.insert(make_pair(socket, instance));
-				result = true;
+				ClientInstance *instance = new ClientInstance(ioChannel, socket, watchID, state, pid, uid);
+				if (instance != NULL)
+				{
+					mapClients.insert(make_pair(socket, instance));
+					result = true;
+				}
+				else
+				{
+					SCARD_DEBUG_ERR("alloc failed");
+				}
 			}
 			else
 			{
-				SCARD_DEBUG_ERR("alloc failed");
+				SCARD_DEBUG_ERR("client already exist [%d]", socket);
 			}
 		}
-		else
-		{
-			SCARD_DEBUG_ERR("client already exist [%d]", socket);
-		}
 
 		return result;
 	}
@@ -129,9 +99,12 @@ namespace smartcard_service_api
 		ClientInstance *result = NULL;
 		map<int, ClientInstance *>::iterator item;
 
-		if ((item = mapClients.find(socket)) != mapClients.end())
+		SCOPE_LOCK(resourceLock)
 		{
-			result = item->second;
+			if ((item = mapClients.find(socket)) != mapClients.end())
+			{
+				result = item->second;
+			}
 		}
 
 		return result;
@@ -141,42 +114,62 @@ namespace smartcard_service_api
 	{
 		map<int, ClientInstance *>::iterator item;
 
-		if ((item = mapClients.find(socket)) != mapClients.end())
+		SCOPE_LOCK(resourceLock)
 		{
-			if (item->second->getPID() < 0)
-				item->second->setPID(pid);
+			if ((item = mapClients.find(socket)) != mapClients.end())
+			{
+				if (item->second->getPID() < 0)
+					item->second->setPID(pid);
+			}
 		}
 	}
 
 	void ServerResource::removeClient(int socket)
 	{
+		vector<ServerChannel *> closing;
 		map<int, ClientInstance *>::iterator item;
 
-		if ((item = mapClients.find(socket)) != mapClients.end())
+		SCOPE_LOCK(resourceLock)
 		{
-			ServerIPC::getInstance()->releaseClient(item->second->getIOChannel(), item->second->getSocket(), item->second->getWatchID());
+			if ((item = mapClients.find(socket)) != mapClients.end())
+			{
+				ServerIPC::getInstance()->releaseClient(item->second->getIOChannel(), item->second->getSocket(), item->second->getWatchID());
 
-			delete item->second;
-			mapClients.erase(item);
-		}
-		else
-		{
-			SCARD_DEBUG("client exists already [%d]", socket);
+				item->second->removeServices(closing);
+
+				delete item->second;
+				mapClients.erase(item);
+			}
+			else
+			{
+				SCARD_DEBUG("client exists already [%d]", socket);
+			}
 		}
+
+		/* card i/o of closing doesn't hold up the other terminals */
+		ServiceInstance::destroyChannels(closing);
 	}
 
 	void ServerResource::removeClients()
 	{
+		vector<ServerChannel *> closing;
 		map<int, ClientInstance *>::iterator item;
 
-		for (item = mapClients.begin(); item != mapClients.end(); item++)
+		SCOPE_LOCK(resourceLock)
 		{
-			ServerIPC::getInstance()->releaseClient(item->second->getIOChannel(), item->second->getSocket(), item->second->getWatchID());
+			for (item = mapClients.begin(); item != mapClients.end(); item++)
+			{
+				ServerIPC::getInstance()->releaseClient(item->second->getIOChannel(), item->second->getSocket(), item->second->getWatchID());
 
-			delete item->second;
+				item->second->removeServices(closing);
+
+				delete item->second;
+			}
+
+			mapClients.clear();
 		}
 
-		mapClients.clear();
+		ServiceInstance::destroyChannels(closing);
 	}
 
 	bool ServerResource::createService(int socket, unsigned int context)
@@ -184,17 +177,20 @@ namespace smartcard_service_api
 		bool result = false;
 		ClientInstance *instance = NULL;
 
-		if ((instance = getClient(socket)) != NULL)
+		SCOPE_LOCK(resourceLock)
 		{
-			if ((result = instance->createService(context)) == false)
+			if ((instance = getClient(socket)) != NULL)
+			{
+				if ((result = instance->createService(context)) == false)
+				{
+					SCARD_DEBUG_ERR("ClientInstance::createService failed [%d] [%d]", socket, context);
+				}
+			}
+			else
 			{
-				SCARD_DEBUG_ERR("ClientInstance::createService failed [%d] [%d]", socket, context);
+				SCARD_DEBUG_ERR("client doesn't exist [%d]", socket);
 			}
 		}
-		else
-		{
-			SCARD_DEBUG_ERR("client doesn't exist [%d]", socket);
-		}
 
 		return result;
 	}
@@ -204,13 +200,16 @@ namespace smartcard_service_api
 		ServiceInstance *result = NULL;
 		ClientInstance *instance = NULL;
 
-		if ((instance = getClient(socket)) != NULL)
+		SCOPE_LOCK(resourceLock)
 		{
-			result = instance->getService(context);
-		}
-		else
-		{
-			SCARD_DEBUG_ERR("client doesn't exist [%d]", socket);
+			if ((instance = getClient(socket)) != NULL)
+			{
+				result = instance->getService(context);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("client doesn't exist [%d]", socket);
+			}
 		}
 
 		return result;
@@ -218,44 +217,51 @@ namespace smartcard_service_api
 
 	void ServerResource::removeService(int socket, unsigned int context)
 	{
+		vector<ServerChannel *> closing;
 		ClientInstance *instance = NULL;
 
-		if ((instance = getClient(socket)) != NULL)
-		{
-			instance->removeService(context);
-		}
-		else
+		SCOPE_LOCK(resourceLock)
 		{
-			SCARD_DEBUG_ERR("client doesn't exist [%d]", socket);
+			if ((instance = getClient(socket)) != NULL)
+			{
+				instance->removeService(context, closing);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("client doesn't exist [%d]", socket);
+			}
 		}
+
+		ServiceInstance::destroyChannels(closing);
 	}
 
 	void ServerResource::removeServices(int socket)
 	{
+		vector<ServerChannel *> closing;
 		ClientInstance *instance = NULL;
 
-		if ((instance = getClient(socket)) != NULL)
+		SCOPE_LOCK(resourceLock)
 		{
-			instance->removeServices();
-		}
-		else
-		{
-			SCARD_DEBUG_ERR("client doesn't exist [%d]", socket);
+			if ((instance = getClient(socket)) != NULL)
+			{
+				instance->removeServices(closing);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("client doesn't exist [%d]", socket);
+			}
 		}
+
+		ServiceInstance::destroyChannels(closing);
 	}
 
 	Terminal *ServerResource::getTerminal(unsigned int terminalID)
 	{
 		Terminal *result = NULL;
-		map<unsigned int, Terminal *>::iterator item;
 
-		if ((item = mapTerminals.find(terminalID)) != mapTerminals.end())
-		{
-			result = item->second;
-		}
-		else
+		if ((result = HandleTable::getInstance().getTerminal(terminalID)) == NULL)
 		{
-			SCARD_DEBUG_ERR("Terminal doesn't exist [%d]", terminalID);
+			SCARD_DEBUG_ERR("Terminal doesn't exist [0x%08X]", terminalID);
 		}
 
 		return result;
@@ -266,34 +272,66 @@ namespace smartcard_service_api
 		Terminal *result = NULL;
 		map<unsigned int, Terminal *>::iterator item;
 
-		for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
+		SCOPE_LOCK(resourceLock)
 		{
-			if (strncmp(name, item->second->getName(), strlen(name)) == 0)
+			for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
 			{
-				result = item->second;
-				break;
+				if (strncmp(name, item->second->getName(), strlen(name)) == 0)
+				{
+					result = item->second;
+					break;
+				}
 			}
 		}
 
 		return result;
 	}
 
-	unsigned int ServerResource::createSession(int socket, unsigned int context, unsigned int terminalID, ByteArray packageCert, void *caller)
+	void ServerResource::getTerminals(vector<Terminal *> &terminals)
 	{
-		unsigned int result = -1;
-		Terminal *temp = NULL;
-		ServiceInstance *instance = NULL;
+		map<unsigned int, Terminal *>::iterator item;
+
+		terminals.clear();
 
-		if ((instance = getService(socket, context)) != NULL)
+		SCOPE_LOCK(resourceLock)
 		{
-			if ((temp = getTerminal(terminalID)) != NULL)
+			for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
 			{
-				result = instance->openSession(temp, packageCert, caller);
+				terminals.push_back(item->second);
 			}
 		}
-		else
+	}
+
+	Terminal *ServerResource::getTerminalBySession(int socket, unsigned int context, unsigned int sessionID)
+	{
+		/* called by the reactor, a worker may be deleting the session */
+		return HandleTable::getInstance().getSessionTerminal(sessionID, socket, context);
+	}
+
+	Terminal *ServerResource::getTerminalByChannel(int socket, unsigned int context, unsigned int channelID)
+	{
+		return HandleTable::getInstance().getChannelTerminal(channelID, socket, context);
+	}
+
+	unsigned int ServerResource::createSession(int socket, unsigned int context, unsigned int terminalID, void *caller)
+	{
+		unsigned int result = HandleTable::INVALID_HANDLE;
+		Terminal *temp = NULL;
+		ServiceInstance *instance = NULL;
+
+		SCOPE_LOCK(resourceLock)
 		{
-			SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			if ((instance = getService(socket, context)) != NULL)
+			{
+				if ((temp = getTerminal(terminalID)) != NULL)
+				{
+					result = instance->openSession(temp, caller);
+				}
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			}
 		}
 
 		return result;
@@ -302,15 +340,10 @@ namespace smartcard_service_api
 	ServerSession *ServerResource::getSession(int socket, unsigned int context, unsigned int sessionID)
 	{
 		ServerSession *result = NULL;
-		ServiceInstance *instance = NULL;
 
-		if ((instance = getService(socket, context)) != NULL)
-		{
-			result = instance->getSession(sessionID);
-		}
-		else
+		if ((result = HandleTable::getInstance().getSession(sessionID, socket, context)) == NULL)
 		{
-			SCARD_DEBUG_ERR("Session doesn't exist : socket [%d], context [%d], handle [%d]", socket, context, sessionID);
+			SCARD_DEBUG_ERR("Session doesn't exist : socket [%d], context [%d], handle [0x%08X]", socket, context, sessionID);
 		}
 
 		return result;
@@ -321,13 +354,16 @@ namespace smartcard_service_api
 		unsigned int result = -1;
 		ServiceInstance *instance = NULL;
 
-		if ((instance = getService(socket, context)) != NULL)
+		SCOPE_LOCK(resourceLock)
 		{
-			result = instance->getChannelCountBySession(sessionID);
-		}
-		else
-		{
-			SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			if ((instance = getService(socket, context)) != NULL)
+			{
+				result = instance->getChannelCountBySession(sessionID);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			}
 		}
 
 		return result;
@@ -335,33 +371,39 @@ namespace smartcard_service_api
 
 	void ServerResource::removeSession(int socket, unsigned int context, unsigned int sessionID)
 	{
+		vector<ServerChannel *> closing;
 		ServiceInstance *instance = NULL;
 
-		if ((instance = getService(socket, context)) != NULL)
-		{
-			instance->closeSession(sessionID);
-		}
-		else
+		SCOPE_LOCK(resourceLock)
 		{
-			SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			if ((instance = getService(socket, context)) != NULL)
+			{
+				instance->closeSession(sessionID, closing);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			}
 		}
+
+		ServiceInstance::destroyChannels(closing);
 	}
 
-	unsigned int ServerResource::createChannel(int socket, unsigned int context, unsigned int sessionID, int channelType, ByteArray aid)
+	unsigned int ServerResource::createChannel(int socket, unsigned int context, unsigned int sessionID, int channelType, const ByteArray &aid)
 	{
-		unsigned int result = -1;
+		unsigned int result = HandleTable::INVALID_HANDLE;
 		ServiceInstance *client = NULL;
 
 		if ((client = getService(socket, context)) != NULL)
 		{
-			if (client->isVaildSessionHandle(sessionID) == true)
+			if (isValidSessionHandle(socket, context, sessionID) == true)
 			{
 				AccessControlList *acList = NULL;
 				ServerSession *session = NULL;
 				Terminal *terminal = NULL;
 
-				terminal = client->getTerminal(sessionID);
-				session = client->getSession(sessionID);
+				terminal = getTerminalBySession(socket, context, sessionID);
+				session = getSession(socket, context, sessionID);
 				if (terminal != NULL && session != NULL)
 				{
 					int rv = 0;
@@ -369,11 +411,12 @@ namespace smartcard_service_api
 					ByteArray certHash;
 					ByteArray selectResponse;
 					ByteArray command;
-					char filename[1024] = { 0, };
+					APDUAccessRule apduRule;
+					LogicalChannelPool *pool = getChannelPool(terminal);
+					unsigned int poolEpoch = 0;
 
-					/* check exceptional case */
-					SignatureHelper::getProcessName(client->getParent()->getPID(), filename, sizeof(filename));
-					if (strncmp(filename, "ozD3Dw1MZruTDKHWGgYaDib2B2LV4/nfT+8b/g1Vsk8=", sizeof(filename)) != 0)
+					/* check exceptional case, process name is taken once when the client connects */
+					if (strcmp(client->getParent()->getProcessName(), "ozD3Dw1MZruTDKHWGgYaDib2B2LV4/nfT+8b/g1Vsk8=") != 0)
 					{
 #if 1
 						certHash = session->packageCert;
@@ -394,12 +437,20 @@ namespace smartcard_service_api
 
 							return result;
 						}
+
+						acList->getAPDUAccessRule(aid, certHash, apduRule);
 					}
 
-					if (channelType == 1)
+					if (channelType == 1 && pool != NULL && (channelNum = pool->acquire(poolEpoch)) > 0)
+					{
+						SCARD_DEBUG("channelNum [%d] from the pool", channelNum);
+					}
+					else if (channelType == 1)
 					{
 						ByteArray response;
 
+						channelNum = 0;
+
 						/* open channel */
 						command = APDUHelper::generateAPDU(APDUHelper::COMMAND_OPEN_LOGICAL_CHANNEL, 0, ByteArray::EMPTY);
 						rv = terminal->transmitSync(command, response);
@@ -431,31 +482,50 @@ namespace smartcard_service_api
 
 					/* select aid */
 					command = APDUHelper::generateAPDU(APDUHelper::COMMAND_SELECT_BY_DF_NAME, channelNum, aid);
-					rv = terminal->transmitSync(command, selectResponse);
+					if (command.getLength() > 0)
+					{
+						rv = terminal->transmitSync(command, selectResponse);
+					}
+					else
+					{
+						SCARD_DEBUG_ERR("channel [%d] can not be encoded", channelNum);
+
+						rv = -1;
+					}
 					if (rv == 0 && selectResponse.getLength() >= 2)
 					{
 						ResponseHelper resp(selectResponse);
 
 						if (resp.getStatus() == 0)
 						{
-							result = client->openChannel(sessionID, channelNum);
-							if (result != IntegerHandle::INVALID_HANDLE)
+							SCOPE_LOCK(resourceLock)
 							{
-								ServerChannel *temp = (ServerChannel *)client->getChannel(result);
-								if (temp != NULL)
+								result = client->openChannel(sessionID, channelNum);
+								if (result != HandleTable::INVALID_HANDLE)
 								{
-									/* set select response */
-									temp->selectResponse = selectResponse;
+									ServerChannel *temp = (ServerChannel *)client->getChannel(result);
+									if (temp != NULL)
+									{
+										/* set select response */
+										temp->selectResponse = selectResponse;
+										temp->apduRule = apduRule;
+
+										if (channelNum > 0)
+										{
+											temp->pool = pool;
+											temp->poolEpoch = poolEpoch;
+										}
+									}
+									else
+									{
+										SCARD_DEBUG_ERR("IS IT POSSIBLE??????????????????");
+									}
 								}
 								else
 								{
-									SCARD_DEBUG_ERR("IS IT POSSIBLE??????????????????");
+									SCARD_DEBUG_ERR("channel is null.");
 								}
 							}
-							else
-							{
-								SCARD_DEBUG_ERR("channel is null.");
-							}
 						}
 						else
 						{
@@ -467,6 +537,17 @@ namespace smartcard_service_api
 						SCARD_DEBUG_ERR("select apdu is failed, rv [%d], length [%d]", rv, selectResponse.getLength());
 					}
 
+					/* channel is not given to the client, keep it or close it */
+					if (result == HandleTable::INVALID_HANDLE && channelNum > 0)
+					{
+						if (pool == NULL || pool->release(channelNum, poolEpoch) == false)
+						{
+							ByteArray response;
+
+							command = APDUHelper::generateAPDU(APDUHelper::COMMAND_CLOSE_LOGICAL_CHANNEL, channelNum, ByteArray::EMPTY);
+							terminal->transmitSync(command, response);
+						}
+					}
 				}
 				else
 				{
@@ -489,15 +570,11 @@ namespace smartcard_service_api
 	Channel *ServerResource::getChannel(int socket, unsigned int context, unsigned int channelID)
 	{
 		Channel *result = NULL;
-		ServiceInstance *instance = NULL;
 
-		if ((instance = getService(socket, context)) != NULL)
+		/* generation and owner are checked by the table, no lock needed */
+		if ((result = HandleTable::getInstance().getChannel(channelID, socket, context)) == NULL)
 		{
-			result = instance->getChannel(channelID);
-		}
-		else
-		{
-			SCARD_DEBUG_ERR("Channel doesn't exist : socket [%d], context [%d], handle [%d]", socket, context, channelID);
+			SCARD_DEBUG_ERR("Channel doesn't exist : socket [%d], context [%d], handle [0x%08X]", socket, context, channelID);
 		}
 
 		return result;
@@ -505,16 +582,80 @@ namespace smartcard_service_api
 
 	void ServerResource::removeChannel(int socket, unsigned int context, unsigned int channelID)
 	{
+		vector<ServerChannel *> closing;
 		ServiceInstance *instance = NULL;
 
-		if ((instance = getService(socket, context)) != NULL)
+		SCOPE_LOCK(resourceLock)
 		{
-			instance->closeChannel(channelID);
+			if ((instance = getService(socket, context)) != NULL)
+			{
+				instance->closeChannel(channelID, closing);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			}
+		}
+
+		ServiceInstance::destroyChannels(closing);
+	}
+
+	void ServerResource::removeChannels(int socket, unsigned int context, unsigned int sessionID)
+	{
+		vector<ServerChannel *> closing;
+		ServiceInstance *instance = NULL;
+
+		SCOPE_LOCK(resourceLock)
+		{
+			if ((instance = getService(socket, context)) != NULL)
+			{
+				instance->closeChannelsBySession(sessionID, closing);
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			}
+		}
+
+		ServiceInstance::destroyChannels(closing);
+	}
+
+	AccessControlList *ServerResource::createAccessControlList(Terminal *terminal)
+	{
+		AccessControlList *result = NULL;
+		ServerChannel *channel = new ServerChannel(NULL, NULL, 0, terminal);
+
+		if (channel != NULL)
+		{
+			ByteArray atr;
+
+			/* extended length lets big files be read at once */
+			if (getATR(terminal, atr) == 0)
+			{
+				channel->setMaxResponseSize(ATRHelper::getMaxResponseSize(atr));
+			}
+
+			/* load access control */
+			result = new GPSEACL(channel);
+			if (result != NULL)
+			{
+				/* terminal name keys the access control cache file */
+				result->setTerminal(terminal);
+				result->loadACL();
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("alloc failed");
+
+				delete channel;
+			}
 		}
 		else
 		{
-			SCARD_DEBUG_ERR("getService doesn't exist : socket [%d], context [%d]", socket, context);
+			SCARD_DEBUG_ERR("alloc failed");
 		}
+
+		return result;
 	}
 
 	AccessControlList *ServerResource::getAccessControlList(Terminal *terminal)
@@ -522,37 +663,152 @@ namespace smartcard_service_api
 		AccessControlList *result = NULL;
 		map<Terminal *, AccessControlList *>::iterator item;
 
-		if ((item = mapACL.find(terminal)) == mapACL.end())
+		SCOPE_LOCK(resourceLock)
 		{
-			ServerChannel *channel = new ServerChannel(NULL, NULL, 0, terminal);
-			if (channel != NULL)
+			if ((item = mapACL.find(terminal)) != mapACL.end())
 			{
-				/* load access control */
-				result = new GPSEACL(channel);
-				if (result != NULL)
-				{
-					result->loadACL();
+				result = item->second;
+			}
+		}
 
+		/* normally preloaded by ServerACLManager,
+		 * only the worker of this terminal loads its access control list */
+		if (result == NULL)
+		{
+			if ((result = createAccessControlList(terminal)) != NULL)
+			{
+				SCOPE_LOCK(resourceLock)
+				{
 					mapACL.insert(make_pair(terminal, result));
 				}
+			}
+		}
+
+		return result;
+	}
+
+	void ServerResource::updateAccessControlList(Terminal *terminal, bool force)
+	{
+		AccessControlList *acList = NULL;
+		AccessControlList *oldList = NULL;
+		map<Terminal *, AccessControlList *>::iterator item;
+
+		SCOPE_LOCK(resourceLock)
+		{
+			if ((item = mapACL.find(terminal)) != mapACL.end())
+			{
+				oldList = item->second;
+			}
+		}
+
+		/* lists are used only by the worker of the terminal, which is running this.
+		 * an unchanged refresh tag keeps the list with its index and cached decisions */
+		if (force == false && oldList != NULL && oldList->isChanged() == false)
+		{
+			SCARD_DEBUG("access control list is not changed, terminal [%s]", terminal->getName());
+		}
+		else if ((acList = createAccessControlList(terminal)) != NULL)
+		{
+			/* card i/o is done aside, the current list is used until it is replaced */
+			SCOPE_LOCK(resourceLock)
+			{
+				if ((item = mapACL.find(terminal)) != mapACL.end())
+				{
+					item->second = acList;
+				}
 				else
 				{
-					SCARD_DEBUG_ERR("alloc failed");
+					mapACL.insert(make_pair(terminal, acList));
 				}
 			}
-			else
+
+			if (oldList != NULL)
 			{
-				SCARD_DEBUG_ERR("alloc failed");
+				delete oldList;
 			}
+
+			SCARD_DEBUG("access control list is updated, terminal [%s]", terminal->getName());
 		}
 		else
 		{
-			result = item->second;
+			SCARD_DEBUG_ERR("createAccessControlList failed, terminal [%s]", terminal->getName());
+			return;
+		}
+
+		/* the card is settled, warm up its channels on the same worker */
+		LogicalChannelPool *pool = getChannelPool(terminal);
+		if (pool != NULL)
+		{
+			pool->fill();
+		}
+	}
+
+	LogicalChannelPool *ServerResource::getChannelPool(Terminal *terminal)
+	{
+		LogicalChannelPool *result = NULL;
+		map<Terminal *, LogicalChannelPool *>::iterator item;
+
+		SCOPE_LOCK(resourceLock)
+		{
+			if ((item = mapChannelPools.find(terminal)) != mapChannelPools.end())
+			{
+				result = item->second;
+			}
 		}
 
 		return result;
 	}
 
+	int ServerResource::getATR(Terminal *terminal, ByteArray &atr)
+	{
+		int rv = 0;
+		unsigned int generation = 0;
+		map<Terminal *, atr_cache_t>::iterator item;
+
+		SCOPE_LOCK(resourceLock)
+		{
+			if ((item = mapATR.find(terminal)) != mapATR.end())
+			{
+				if (item->second.atr.isEmpty() == false)
+				{
+					atr = item->second.atr;
+
+					return 0;
+				}
+
+				generation = item->second.generation;
+			}
+		}
+
+		/* only the worker of this terminal reads it from the card */
+		if ((rv = terminal->getATRSync(atr)) == 0)
+		{
+			SCOPE_LOCK(resourceLock)
+			{
+				atr_cache_t &cache = mapATR[terminal];
+
+				/* the card may be changed while reading */
+				if (cache.generation == generation)
+				{
+					cache.atr = atr;
+				}
+			}
+		}
+
+		return rv;
+	}
+
+	void ServerResource::invalidateATR(Terminal *terminal)
+	{
+		SCOPE_LOCK(resourceLock)
+		{
+			atr_cache_t &cache = mapATR[terminal];
+
+			cache.atr.releaseBuffer();
+			cache.generation++;
+		}
+	}
+
 	Terminal *ServerResource::createInstance(void *library)
 	{
 		Terminal *terminal = NULL;
@@ -593,10 +849,24 @@ namespace smartcard_service_api
 			terminal = createInstance(libHandle);
 			if (terminal != NULL)
 			{
-				unsigned int handle = IntegerHandle::assignHandle();
+				unsigned int handle = HandleTable::getInstance().assignHandle(HandleTable::HANDLE_TYPE_READER, terminal, HandleTable::ANY_OWNER, 0, terminal);
+				/* the only probe, notifications keep it up to date afterwards */
+				bool present = terminal->isSecureElementPresence();
+
+				SCOPE_LOCK(resourceLock)
+				{
+					mapTerminals.insert(make_pair(handle, terminal));
+					mapPresence[terminal] = present;
+					libraries.push_back(libHandle);
+
+					if (CHANNEL_POOL_SIZE > 0)
+					{
+						mapChannelPools.insert(make_pair(terminal, new LogicalChannelPool(terminal, CHANNEL_POOL_SIZE)));
+					}
+				}
 
-				mapTerminals.insert(make_pair(handle, terminal));
-				libraries.push_back(libHandle);
+				/* each terminal has its own worker queue, async capable plugins are driven by events */
+				serverDispatcher->addTerminal(terminal, libHandle);
 
 				terminal->setStatusCallback(&ServerResource::terminalCallback);
 
@@ -663,23 +933,47 @@ namespace smartcard_service_api
 	{
 		size_t i;
 		map<unsigned int, Terminal *>::iterator item;
+		vector<Terminal *> terminals;
+		vector<void *> handles;
 
-		for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
+		SCOPE_LOCK(resourceLock)
 		{
-			item->second->finalize();
+			for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
+			{
+				terminals.push_back(item->second);
 
-			IntegerHandle::releaseHandle(item->first);
-		}
+				HandleTable::getInstance().releaseHandle(item->first);
+			}
+
+			mapTerminals.clear();
+			mapPresence.clear();
 
-		mapTerminals.clear();
+			updateReadersInformation();
 
-		for (i = 0; i < libraries.size(); i++)
+			handles = libraries;
+			libraries.clear();
+		}
+
+		/* a worker may wait for resourceLock, it is joined without holding it */
+		for (i = 0; i < terminals.size(); i++)
 		{
-			if (libraries[i] != NULL)
-				dlclose(libraries[i]);
+			serverDispatcher->removeTerminal(terminals[i]);
+
+			terminals[i]->finalize();
+
+			/* open channels may still refer to the pool, only forget the card */
+			LogicalChannelPool *pool = getChannelPool(terminals[i]);
+			if (pool != NULL)
+			{
+				pool->invalidate();
+			}
 		}
 
-		libraries.clear();
+		for (i = 0; i < handles.size(); i++)
+		{
+			if (handles[i] != NULL)
+				dlclose(handles[i]);
+		}
 	}
 
 	bool ServerResource::isValidReaderHandle(unsigned int reader)
@@ -689,66 +983,109 @@ namespace smartcard_service_api
 
 	bool ServerResource::isValidSessionHandle(int socket, unsigned int context, unsigned int session)
 	{
-		ServiceInstance *instance = NULL;
-
-		return (((instance = getService(socket, context)) != NULL) && (getService(socket, context)->isVaildSessionHandle(session)));
+		return (HandleTable::getInstance().getSession(session, socket, context) != NULL);
 	}
 
-	int ServerResource::getReadersInformation(ByteArray &info)
+	void ServerResource::updateReadersInformation()
 	{
-		int result = 0;
+		int count = 0;
 		unsigned char *buffer = NULL;
 		unsigned int length = 0;
 		unsigned int offset = 0;
 		unsigned int nameLen = 0;
+		map<unsigned int, Terminal *>::iterator item;
+		map<Terminal *, bool>::iterator flag;
+		vector<unsigned int> present;
+		size_t i;
 
-		if (mapTerminals.size() > 0)
+		/* built from the flags, no plugin call while every user of the lock waits */
+		SCOPE_LOCK(resourceLock)
 		{
-			map<unsigned int, Terminal *>::iterator item;
-
 			for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
 			{
-				if (item->second->isSecureElementPresence())
+				if ((flag = mapPresence.find(item->second)) != mapPresence.end() && flag->second == true)
 				{
 					length += sizeof(nameLen) + strlen(item->second->getName()) + sizeof(unsigned int);
-					result++;
+					present.push_back(item->first);
 				}
 			}
 
-			buffer = new unsigned char[length];
-			if (buffer != NULL)
+			if (length > 0)
 			{
-				memset(buffer, 0, length);
+				buffer = new unsigned char[length];
+				if (buffer == NULL)
+				{
+					SCARD_DEBUG_ERR("alloc failed");
 
-				for (item = mapTerminals.begin(); item != mapTerminals.end(); item++)
+					return;
+				}
+
+				for (i = 0; i < present.size(); i++)
 				{
-					if (item->second->isSecureElementPresence())
-					{
-						nameLen = strlen(item->second->getName());
+					const char *name = mapTerminals[present[i]]->getName();
 
-						memcpy(buffer + offset, &nameLen, sizeof(nameLen));
-						offset += sizeof(nameLen);
+					nameLen = strlen(name);
 
-						memcpy(buffer + offset, item->second->getName(), nameLen);
-						offset += nameLen;
+					memcpy(buffer + offset, &nameLen, sizeof(nameLen));
+					offset += sizeof(nameLen);
 
-						memcpy(buffer + offset, &item->first, sizeof(unsigned int));
-						offset += sizeof(unsigned int);
-					}
+					memcpy(buffer + offset, name, nameLen);
+					offset += nameLen;
+
+					memcpy(buffer + offset, &present[i], sizeof(unsigned int));
+					offset += sizeof(unsigned int);
+
+					count++;
 				}
 
-				info.setBuffer(buffer, length);
+				readersInfo.setBuffer(buffer, length);
 				delete []buffer;
 			}
 			else
 			{
-				SCARD_DEBUG_ERR("alloc failed");
-				result = -1;
+				SCARD_DEBUG("no secure element");
+
+				readersInfo.releaseBuffer();
+			}
+
+			readersCount = count;
+			if (++readersVersion == 0)
+			{
+				readersVersion = 1;
 			}
+
+			SCARD_DEBUG("readers [%d], version [%u]", readersCount, readersVersion);
 		}
-		else
+	}
+
+	void ServerResource::setPresence(const char *name, bool present)
+	{
+		Terminal *terminal;
+
+		if ((terminal = getTerminal(name)) == NULL)
+		{
+			SCARD_DEBUG_ERR("unknown terminal [%s]", name);
+			return;
+		}
+
+		SCOPE_LOCK(resourceLock)
+		{
+			mapPresence[terminal] = present;
+		}
+
+		updateReadersInformation();
+	}
+
+	int ServerResource::getReadersInformation(ByteArray &info, unsigned int &version)
+	{
+		int result = 0;
+
+		SCOPE_LOCK(resourceLock)
 		{
-			SCARD_DEBUG("no secure element");
+			/* shares the prebuilt buffer */
+			info = readersInfo;
+			version = readersVersion;
+			result = readersCount;
 		}
 
 		return result;
@@ -759,10 +1096,13 @@ namespace smartcard_service_api
 		bool result = true;
 		map<int, ClientInstance *>::iterator item;
 
-		for (item = mapClients.begin(); item != mapClients.end(); item++)
+		SCOPE_LOCK(resourceLock)
 		{
-			if (item->second->sendMessageToAllServices(item->second->getSocket(), msg) == false)
-				result = false;
+			for (item = mapClients.begin(); item != mapClients.end(); item++)
+			{
+				if (item->second->sendMessageToAllServices(item->second->getSocket(), msg) == false)
+					result = false;
+			}
 		}
 
 		return result;
@@ -782,11 +1122,24 @@ namespace smartcard_service_api
 
 				SCARD_DEBUG("terminal [%s], event [%d], error [%d], user_param [%p]", (char *)terminal, event, error, user_param);
 
+				/* readers requested after the notification see the card */
+				ServerResource::getInstance().setPresence((char *)terminal, true);
+
 				/* send all client to refresh reader */
 				msg.message = msg.MSG_NOTIFY_SE_INSERTED;
 				msg.data.setBuffer((unsigned char *)terminal, strlen((char *)terminal) + 1);
 
 				ServerResource::getInstance().sendMessageToAllClients(msg);
+
+				/* new card has its own answer to reset */
+				Terminal *instance = ServerResource::getInstance().getTerminal((char *)terminal);
+				if (instance != NULL)
+				{
+					ServerResource::getInstance().invalidateATR(instance);
+				}
+
+				/* new card may have different rules, even under the same refresh tag */
+				ServerACLManager::getInstance()->requestUpdate((char *)terminal, true);
 			}
 			break;
 
@@ -798,11 +1151,26 @@ namespace smartcard_service_api
 
 				SCARD_DEBUG("terminal [%s], event [%d], error [%d], user_param [%p]", (char *)terminal, event, error, user_param);
 
+				ServerResource::getInstance().setPresence((char *)terminal, false);
+
 				/* send all client to refresh reader */
 				msg.message = msg.MSG_NOTIFY_SE_REMOVED;
 				msg.data.setBuffer((unsigned char *)terminal, strlen((char *)terminal) + 1);
 
 				ServerResource::getInstance().sendMessageToAllClients(msg);
+
+				/* channels kept for the removed card are gone with it */
+				Terminal *instance = ServerResource::getInstance().getTerminal((char *)terminal);
+				if (instance != NULL)
+				{
+					ServerResource::getInstance().invalidateATR(instance);
+
+					LogicalChannelPool *pool = ServerResource::getInstance().getChannelPool(instance);
+					if (pool != NULL)
+					{
+						pool->invalidate();
+					}
+				}
 			}
 			break;
 
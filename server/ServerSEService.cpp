@@ -291,6 +291,7 @@ namespace smartcard_service_api
 	bool ServerSEService::dispatcherCallback(void *message, int socket)
 	{
 		int count = 0;
+		unsigned int version = 0;
 		ByteArray info;
 		Message *msg = (Message *)message;
 		Message response(*msg);
@@ -316,10 +317,10 @@ namespace smartcard_service_api
 			}
 		}
 
-		if ((count = resource.getReadersInformation(info)) > 0)
+		if ((count = resource.getReadersInformation(info, version)) > 0)
 		{
 			response.param1 = count;
-			response.param2 = 0;
+			response.param2 = version;
 			response.error = 0;
 			response.data = info;
 		}
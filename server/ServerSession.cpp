@@ -30,12 +30,15 @@
 
 namespace smartcard_service_api
 {
-	ServerSession::ServerSession(ServerReader *reader, ByteArray packageCert, void *caller, Terminal *terminal):SessionHelper(reader)
+	ServerSession::ServerSession(ServerReader *reader, const ByteArray &packageCert, void *caller, Terminal *terminal):SessionHelper(reader)
 	{
 		this->caller = NULL;
 		this->terminal = NULL;
+		this->channelList = NULL;
+		this->channelCount = 0;
 
-		if (caller == NULL || terminal == NULL)
+		/* caller is an opaque tag, client pointers don't cross the socket any more */
+		if (terminal == NULL)
 		{
 			SCARD_DEBUG_ERR("invalid param");
 
@@ -68,6 +71,33 @@ namespace smartcard_service_api
 		}
 	}
 
+	void ServerSession::linkChannel(ServerChannel *channel)
+	{
+		channel->prevChannel = NULL;
+		channel->nextChannel = channelList;
+
+		if (channelList != NULL)
+			channelList->prevChannel = channel;
+
+		channelList = channel;
+		channelCount++;
+	}
+
+	void ServerSession::unlinkChannel(ServerChannel *channel)
+	{
+		if (channel->prevChannel != NULL)
+			channel->prevChannel->nextChannel = channel->nextChannel;
+		else
+			channelList = channel->nextChannel;
+
+		if (channel->nextChannel != NULL)
+			channel->nextChannel->prevChannel = channel->prevChannel;
+
+		channel->prevChannel = NULL;
+		channel->nextChannel = NULL;
+		channelCount--;
+	}
+
 	void ServerSession::closeChannels()
 	{
 		size_t i;
@@ -113,6 +143,13 @@ namespace smartcard_service_api
 
 		/* select aid */
 		command = APDUHelper::generateAPDU(APDUHelper::COMMAND_SELECT_BY_DF_NAME, channelID, aid);
+		if (command.getLength() == 0)
+		{
+			SCARD_DEBUG_ERR("channel [%d] can not be encoded", channelID);
+
+			return channel;
+		}
+
 		rv = terminal->transmitSync(command, result);
 		if (rv == 0 && result.getLength() >= 2)
 		{
@@ -211,6 +248,16 @@ namespace smartcard_service_api
 
 		/* select aid */
 		command = APDUHelper::generateAPDU(APDUHelper::COMMAND_SELECT_BY_DF_NAME, channelID, aid);
+		if (command.getLength() == 0)
+		{
+			SCARD_DEBUG_ERR("channel [%d] can not be encoded", channelID);
+
+			command = APDUHelper::generateAPDU(APDUHelper::COMMAND_CLOSE_LOGICAL_CHANNEL, channelID, ByteArray::EMPTY);
+			terminal->transmitSync(command, result);
+
+			return channel;
+		}
+
 		rv = terminal->transmitSync(command, result);
 
 		if (rv == 0 && result.getLength() >= 2)
@@ -24,74 +24,88 @@
 #include "ServiceInstance.h"
 #include "ClientInstance.h"
 #include "ServerResource.h"
+#include "HandleTable.h"
 
 namespace smartcard_service_api
 {
-	unsigned int ServiceInstance::openSession(Terminal *terminal, ByteArray packageCert, void *caller)
+	ServiceInstance::~ServiceInstance()
 	{
-		unsigned int handle = IntegerHandle::assignHandle();
+		vector<ServerChannel *> closing;
 
-		ServerSession *session = new ServerSession((ServerReader *)0, packageCert, caller, terminal);
-
-		mapSessions.insert(make_pair(handle, make_pair(session, terminal)));
-
-		return handle;
+		closeSessions(closing);
+		destroyChannels(closing);
 	}
 
-	ServerSession *ServiceInstance::getSession(unsigned int session)
+	unsigned int ServiceInstance::openSession(Terminal *terminal, void *caller)
 	{
-		ServerSession *result = NULL;
-		map<unsigned int, pair<ServerSession *, Terminal *> >::iterator item;
+		unsigned int handle = HandleTable::INVALID_HANDLE;
+		ServerSession *session = new ServerSession((ServerReader *)0, parent->getCertificationHash(), caller, terminal);
 
-		if ((item = mapSessions.find(session)) != mapSessions.end())
+		if (session != NULL)
 		{
-			/*if (item->second.first == session)*/
-				result = item->second.first;
+			handle = HandleTable::getInstance().assignHandle(HandleTable::HANDLE_TYPE_SESSION, session, parent->getSocket(), context, terminal);
+			if (handle != HandleTable::INVALID_HANDLE)
+			{
+				mapSessions.insert(make_pair(handle, session));
+			}
+			else
+			{
+				delete session;
+			}
+		}
+		else
+		{
+			SCARD_DEBUG_ERR("alloc failed");
 		}
 
-		return result;
+		return handle;
+	}
+
+	ServerSession *ServiceInstance::getSession(unsigned int session)
+	{
+		return HandleTable::getInstance().getSession(session, parent->getSocket(), context);
 	}
 
 	Terminal *ServiceInstance::getTerminal(unsigned int session)
 	{
 		Terminal *result = NULL;
-		map<unsigned int, pair<ServerSession *, Terminal *> >::iterator item;
+		ServerSession *instance = NULL;
 
-		if ((item = mapSessions.find(session)) != mapSessions.end())
+		if ((instance = getSession(session)) != NULL)
 		{
-			result = item->second.second;
+			result = instance->terminal;
 		}
 
 		return result;
 	}
 
-	void ServiceInstance::closeSession(unsigned int session)
+	void ServiceInstance::closeSession(unsigned int session, vector<ServerChannel *> &closing)
 	{
-		map<unsigned int, pair<ServerSession *, Terminal *> >::iterator item;
+		map<unsigned int, ServerSession *>::iterator item;
 
 		if ((item = mapSessions.find(session)) != mapSessions.end())
 		{
-			closeChannelsBySession(session);
+			HandleTable::getInstance().releaseHandle(session);
 
-			item->second.first->closeSync();
+			closeChannelsBySession(item->second, closing);
 
-			mapSessions.erase(item);
+			item->second->closeSync();
 
-			IntegerHandle::releaseHandle(session);
+			mapSessions.erase(item);
 		}
 	}
 
-	void ServiceInstance::closeSessions()
+	void ServiceInstance::closeSessions(vector<ServerChannel *> &closing)
 	{
-		map<unsigned int, pair<ServerSession *, Terminal *> >::iterator item;
+		map<unsigned int, ServerSession *>::iterator item;
 
-		closeChannels();
+		closeChannels(closing);
 
 		for (item = mapSessions.begin(); item != mapSessions.end(); item++)
 		{
-			item->second.first->closeSync();
+			HandleTable::getInstance().releaseHandle(item->first);
 
-			IntegerHandle::releaseHandle(item->first);
+			item->second->closeSync();
 		}
 
 		mapSessions.clear();
@@ -99,16 +113,31 @@ namespace smartcard_service_api
 
 	unsigned int ServiceInstance::openChannel(unsigned int session, int channelNum)
 	{
-		Terminal *terminal = getTerminal(session);
+		ServerSession *instance = getSession(session);
 		ServerChannel *channel = NULL;
-		unsigned int handle = -1;
+		unsigned int handle = HandleTable::INVALID_HANDLE;
+
+		if (instance == NULL)
+		{
+			SCARD_DEBUG_ERR("invalid session handle [0x%08X]", session);
+
+			return handle;
+		}
 
 		/* create ServerChannel */
-		channel = new ServerChannel((ServerSession *)session, (void *)parent->getPID(), channelNum, terminal);
+		channel = new ServerChannel(instance, (void *)parent->getPID(), channelNum, instance->terminal);
 		if (channel != NULL)
 		{
-			handle = IntegerHandle::assignHandle();
-			mapChannels.insert(make_pair(handle, make_pair(session, channel)));
+			handle = HandleTable::getInstance().assignHandle(HandleTable::HANDLE_TYPE_CHANNEL, channel, parent->getSocket(), context, instance->terminal);
+			if (handle != HandleTable::INVALID_HANDLE)
+			{
+				channel->handle = handle;
+				instance->linkChannel(channel);
+			}
+			else
+			{
+				delete channel;
+			}
 		}
 		else
 		{
@@ -120,78 +149,86 @@ namespace smartcard_service_api
 
 	ServerChannel *ServiceInstance::getChannel(/*unsigned int session, */unsigned int channel)
 	{
-		ServerChannel *result = NULL;
-		map<unsigned int, pair<unsigned int, ServerChannel *> >::iterator item;
-
-		if ((item = mapChannels.find(channel)) != mapChannels.end())
-		{
-			/*if (item->second.first == session)*/
-				result = item->second.second;
-		}
-
-		return result;
+		return HandleTable::getInstance().getChannel(channel, parent->getSocket(), context);
 	}
 
 	unsigned int ServiceInstance::getChannelCountBySession(unsigned int session)
 	{
 		unsigned int channelCount = 0;
-		map<unsigned int, pair<unsigned int, ServerChannel *> >::iterator item;
+		ServerSession *instance = NULL;
 
-		for (item = mapChannels.begin(); item != mapChannels.end(); item++)
+		if ((instance = getSession(session)) != NULL)
 		{
-			if (item->second.first == session)
-				channelCount++;
+			channelCount = instance->getChannelCount();
 		}
 
 		return channelCount;
 	}
 
-	void ServiceInstance::closeChannel(unsigned int channel)
+	void ServiceInstance::destroyChannel(ServerSession *session, ServerChannel *channel, vector<ServerChannel *> &closing)
 	{
-		map<unsigned int, pair<unsigned int, ServerChannel *> >::iterator item;
+		/* handle goes first, lookups in flight fail from now */
+		HandleTable::getInstance().releaseHandle(channel->handle);
 
-		if ((item = mapChannels.find(channel)) != mapChannels.end())
-		{
-			/* destroy ServerChannel */
-			delete item->second.second;
+		session->unlinkChannel(channel);
 
-			mapChannels.erase(item);
+		/* not reachable any more, closed on the card by the caller */
+		closing.push_back(channel);
+	}
+
+	void ServiceInstance::closeChannel(unsigned int channel, vector<ServerChannel *> &closing)
+	{
+		ServerChannel *instance = NULL;
 
-			IntegerHandle::releaseHandle(channel);
+		if ((instance = getChannel(channel)) != NULL)
+		{
+			destroyChannel((ServerSession *)instance->getSession(), instance, closing);
 		}
 	}
 
-	void ServiceInstance::closeChannelsBySession(unsigned int session)
+	void ServiceInstance::closeChannelsBySession(ServerSession *session, vector<ServerChannel *> &closing)
 	{
-		size_t i;
-		vector<unsigned int> list;
-		map<unsigned int, pair<unsigned int, ServerChannel *> >::iterator item;
+		ServerChannel *channel;
 
-		for (item = mapChannels.begin(); item != mapChannels.end(); item++)
+		/* only the channels of this session are visited */
+		while ((channel = session->getChannelList()) != NULL)
 		{
-			if (item->second.first == session)
-				list.push_back(item->second.first);
+			destroyChannel(session, channel, closing);
 		}
+	}
+
+	void ServiceInstance::closeChannelsBySession(unsigned int session, vector<ServerChannel *> &closing)
+	{
+		map<unsigned int, ServerSession *>::iterator item;
 
-		for (i = 0; i < list.size(); i++)
+		/* session handle may be released already while the session is closing */
+		if ((item = mapSessions.find(session)) != mapSessions.end())
 		{
-			closeChannel(list[i]);
+			closeChannelsBySession(item->second, closing);
 		}
 	}
 
-	void ServiceInstance::closeChannels()
+	void ServiceInstance::closeChannels(vector<ServerChannel *> &closing)
 	{
-		map<unsigned int, pair<unsigned int, ServerChannel *> >::iterator item;
+		map<unsigned int, ServerSession *>::iterator item;
 
-		for (item = mapChannels.begin(); item != mapChannels.end(); item++)
+		for (item = mapSessions.begin(); item != mapSessions.end(); item++)
 		{
-			/* destroy ServerChannel */
-			delete item->second.second;
+			closeChannelsBySession(item->second, closing);
+		}
+	}
 
-			IntegerHandle::releaseHandle(item->first);
+	void ServiceInstance::destroyChannels(vector<ServerChannel *> &channels)
+	{
+		size_t i;
+
+		/* destroy ServerChannel, logical channel is closed on the card */
+		for (i = 0; i < channels.size(); i++)
+		{
+			delete channels[i];
 		}
 
-		mapChannels.clear();
+		channels.clear();
 	}
 
 } /* namespace smartcard_service_api */
@@ -0,0 +1,458 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <dlfcn.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "TerminalDispatcher.h"
+#include "ServerDispatcher.h"
+#include "ServerResource.h"
+#include "ServerChannel.h"
+#include "ServerIPC.h"
+
+namespace smartcard_service_api
+{
+	TerminalDispatcher::TerminalDispatcher(Terminal *terminal, void *library):DispatcherHelper()
+	{
+		SCARD_BEGIN();
+
+		this->terminal = terminal;
+		capabilities = 0;
+		eventFd = -1;
+		processEvents = NULL;
+		runningMsg = NULL;
+		busy = false;
+
+		pthread_mutex_init(&stateMutex, NULL);
+		pthread_cond_init(&stateCondition, NULL);
+
+		loadInterface(library);
+
+		runDispatcherThread();
+
+		SCARD_END();
+	}
+
+	TerminalDispatcher::~TerminalDispatcher()
+	{
+		if (isAsynchronous() == true)
+		{
+			/* waits for the request in flight, nothing starts after this */
+			lock();
+		}
+
+		if (eventFd >= 0)
+		{
+			ServerIPC::getInstance()->removeEventSource(eventFd);
+		}
+
+		/* joined before anything it uses is freed, processLock is free for the request in progress */
+		stopDispatcherThread();
+
+		clearQueue();
+		scheduler.clear();
+
+		pthread_cond_destroy(&stateCondition);
+		pthread_mutex_destroy(&stateMutex);
+	}
+
+	void TerminalDispatcher::loadInterface(void *library)
+	{
+		terminal_get_abi_version_fn getVersion = NULL;
+		terminal_get_capabilities_fn getCapabilities = NULL;
+		terminal_get_event_fd_fn getEventFd = NULL;
+		int version;
+
+		if (library == NULL)
+			return;
+
+		if ((getVersion = (terminal_get_abi_version_fn)dlsym(library, TERMINAL_SYMBOL_GET_ABI_VERSION)) == NULL)
+		{
+			SCARD_DEBUG("plugin abi version 1, terminal [%s]", terminal->getName());
+
+			return;
+		}
+
+		if ((version = getVersion()) < TERMINAL_ABI_VERSION)
+		{
+			SCARD_DEBUG_ERR("unknown plugin abi version [%d], terminal [%s]", version, terminal->getName());
+
+			return;
+		}
+
+		if ((getCapabilities = (terminal_get_capabilities_fn)dlsym(library, TERMINAL_SYMBOL_GET_CAPABILITIES)) != NULL)
+		{
+			capabilities = getCapabilities(terminal);
+		}
+
+		if (capabilities & TERMINAL_CAP_POLLABLE_FD)
+		{
+			getEventFd = (terminal_get_event_fd_fn)dlsym(library, TERMINAL_SYMBOL_GET_EVENT_FD);
+			processEvents = (terminal_process_events_fn)dlsym(library, TERMINAL_SYMBOL_PROCESS_EVENTS);
+
+			if (getEventFd == NULL || processEvents == NULL ||
+				(eventFd = getEventFd(terminal)) < 0 ||
+				ServerIPC::getInstance()->addEventSource(eventFd, &TerminalDispatcher::eventHandler, this) == false)
+			{
+				SCARD_DEBUG_ERR("event fd is not available, terminal [%s]", terminal->getName());
+
+				/* completions would never be delivered */
+				capabilities = 0;
+				eventFd = -1;
+				processEvents = NULL;
+			}
+		}
+
+		SCARD_DEBUG("plugin abi version [%d], capabilities [0x%08X], terminal [%s]", version, capabilities, terminal->getName());
+	}
+
+	void *TerminalDispatcher::dispatcherThreadFunc(DispatcherMsg *msg, void *data)
+	{
+		SCOPE_LOCK(processLock)
+		{
+			runningMsg = msg;
+
+			ServerDispatcher::getInstance()->dispatcherThreadFunc(msg, data);
+
+			runningMsg = NULL;
+		}
+
+		/* the request handed over by runNext is done */
+		if (isAsynchronous() == true)
+		{
+			runNext();
+		}
+
+		return NULL;
+	}
+
+	DispatcherMsg *TerminalDispatcher::fetchMessage()
+	{
+		/* with an async plugin, the worker queue holds only the request owning the terminal */
+		if (isAsynchronous() == true)
+		{
+			return DispatcherHelper::fetchMessage();
+		}
+
+		return scheduler.pop();
+	}
+
+	void TerminalDispatcher::pushMessage(DispatcherMsg *msg)
+	{
+		bool start = false;
+
+		if (isAsynchronous() == false)
+		{
+			syncLock();
+
+			scheduler.push(msg);
+
+			signalCondition();
+			syncUnlock();
+
+			return;
+		}
+
+		pthread_mutex_lock(&stateMutex);
+
+		scheduler.push(msg);
+
+		if (busy == false)
+		{
+			busy = true;
+			start = true;
+		}
+
+		pthread_mutex_unlock(&stateMutex);
+
+		if (start == true)
+		{
+			runNext();
+		}
+	}
+
+	void TerminalDispatcher::runNext()
+	{
+		DispatcherMsg *msg = NULL;
+
+		/* called by the owner of the terminal only */
+		while (true)
+		{
+			pthread_mutex_lock(&stateMutex);
+
+			if ((msg = scheduler.pop()) == NULL)
+			{
+				busy = false;
+				pthread_cond_broadcast(&stateCondition);
+				pthread_mutex_unlock(&stateMutex);
+
+				return;
+			}
+
+			pthread_mutex_unlock(&stateMutex);
+
+			if (msg->message != Message::MSG_REQUEST_TRANSMIT)
+			{
+				/* may block on the card, the worker thread continues from there */
+				DispatcherHelper::pushMessage(msg);
+
+				return;
+			}
+
+			if (submitTransmit(msg) == true)
+			{
+				delete msg;
+
+				/* the completion continues */
+				return;
+			}
+
+			delete msg;
+		}
+	}
+
+	bool TerminalDispatcher::submitTransmit(DispatcherMsg *msg)
+	{
+		int rv = -1;
+		int socket = msg->getPeerSocket();
+		ByteArray command;
+		ServerChannel *channel = NULL;
+		transmit_context_t *context = NULL;
+
+		if ((channel = (ServerChannel *)ServerResource::getInstance().getChannel(socket, msg->error/* service context */, msg->param1)) == NULL)
+		{
+			SCARD_DEBUG_ERR("invalid handle : socket [%d], context [%d], channel [%d]", socket, msg->error/* service context */, msg->param1);
+		}
+		else if ((rv = channel->buildCommand(msg->data, command)) == 0)
+		{
+			context = new transmit_context_t;
+			if (context != NULL)
+			{
+				context->dispatcher = this;
+				context->socket = socket;
+				context->response = new Message(*msg);
+				context->response->param1 = 0;
+				context->response->param2 = 0;
+				context->response->error = -1;
+				context->response->data.releaseBuffer();
+				context->chaining = ((msg->param2 & Message::TRANSMIT_AUTO_GET_RESPONSE) != 0);
+				context->apdu = command;
+				context->count = 0;
+
+				if ((rv = terminal->transmit(command, &TerminalDispatcher::transmitCallback, context)) == 0)
+				{
+					return true;
+				}
+
+				SCARD_DEBUG_ERR("transmit failed [%d]", rv);
+
+				ServerResource::getInstance().invalidateATR(terminal);
+
+				delete context->response;
+				delete context;
+			}
+			else
+			{
+				SCARD_DEBUG_ERR("alloc failed");
+
+				rv = -1;
+			}
+		}
+
+		/* failed before reaching the card */
+		Message response(*msg);
+
+		response.param1 = 0;
+		response.param2 = 0;
+		response.error = rv;
+		response.data.releaseBuffer();
+
+		ServerIPC::getInstance()->sendMessage(socket, &response);
+
+		return false;
+	}
+
+	void TerminalDispatcher::transmitCallback(unsigned char *buffer, unsigned int length, int error, void *userParam)
+	{
+		transmit_context_t *context = (transmit_context_t *)userParam;
+		TerminalDispatcher *dispatcher = NULL;
+
+		if (context == NULL)
+		{
+			SCARD_DEBUG_ERR("context is null");
+
+			return;
+		}
+
+		dispatcher = context->dispatcher;
+
+		if (error == 0 && buffer != NULL && length > 0 && context->chaining == true)
+		{
+			ByteArray next;
+
+			if (ServerChannel::chainResponse(context->apdu, ByteArray(buffer, length), context->collected, context->count, next) == true)
+			{
+				context->apdu = next;
+				context->count++;
+
+				/* the terminal is still owned by this request */
+				if ((error = dispatcher->terminal->transmit(next, &TerminalDispatcher::transmitCallback, context)) == 0)
+				{
+					return;
+				}
+			}
+			else
+			{
+				context->response->data = context->collected;
+				context->response->param2 = context->count;
+				context->response->error = 0;
+			}
+		}
+		else if (error == 0 && buffer != NULL && length > 0)
+		{
+			context->response->data.setBuffer(buffer, length);
+			context->response->error = 0;
+		}
+
+		if (context->response->error != 0)
+		{
+			SCARD_DEBUG_ERR("transmit failed [%d]", error);
+
+			context->response->error = (error != 0) ? error : -1;
+
+			/* transport error, cached answer to reset is not trusted any more */
+			ServerResource::getInstance().invalidateATR(dispatcher->terminal);
+		}
+
+		ServerIPC::getInstance()->sendMessage(context->socket, context->response);
+
+		delete context->response;
+		delete context;
+
+		dispatcher->runNext();
+	}
+
+	void TerminalDispatcher::eventHandler(int fd, void *userParam)
+	{
+		TerminalDispatcher *dispatcher = (TerminalDispatcher *)userParam;
+
+		/* completions are called from here */
+		dispatcher->processEvents(dispatcher->terminal);
+	}
+
+	void TerminalDispatcher::lockScheduler()
+	{
+		if (isAsynchronous() == true)
+			pthread_mutex_lock(&stateMutex);
+		else
+			syncLock();
+	}
+
+	void TerminalDispatcher::unlockScheduler()
+	{
+		if (isAsynchronous() == true)
+			pthread_mutex_unlock(&stateMutex);
+		else
+			syncUnlock();
+	}
+
+	void TerminalDispatcher::removeMessages(int socket)
+	{
+		lockScheduler();
+
+		scheduler.remove(socket);
+
+		unlockScheduler();
+	}
+
+	void TerminalDispatcher::interleave()
+	{
+		DispatcherMsg *msg = NULL;
+		unsigned int count;
+
+		if (runningMsg == NULL)
+			return;
+
+		/* one turn of the clients waiting */
+		lockScheduler();
+		count = scheduler.getActiveClientCount();
+		unlockScheduler();
+
+		while (count-- > 0)
+		{
+			lockScheduler();
+			msg = scheduler.popTransmit(runningMsg->getPeerSocket(), runningMsg->param1);
+			unlockScheduler();
+
+			if (msg == NULL)
+				break;
+
+			/* processLock is already held by this worker thread */
+			ServerDispatcher::getInstance()->dispatcherThreadFunc(msg, this);
+
+			delete msg;
+		}
+	}
+
+	void TerminalDispatcher::getStatistics(vector<queue_statistics_t> &result)
+	{
+		lockScheduler();
+
+		scheduler.getStatistics(result);
+
+		unlockScheduler();
+	}
+
+	void TerminalDispatcher::lock()
+	{
+		if (isAsynchronous() == false)
+		{
+			processLock.lock();
+
+			return;
+		}
+
+		pthread_mutex_lock(&stateMutex);
+
+		while (busy == true)
+		{
+			pthread_cond_wait(&stateCondition, &stateMutex);
+		}
+
+		busy = true;
+
+		pthread_mutex_unlock(&stateMutex);
+	}
+
+	void TerminalDispatcher::unlock()
+	{
+		if (isAsynchronous() == false)
+		{
+			processLock.unlock();
+
+			return;
+		}
+
+		/* requests queued meanwhile */
+		runNext();
+	}
+
+} /* namespace smartcard_service_api */
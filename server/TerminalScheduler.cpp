@@ -0,0 +1,382 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/* standard library header */
+#include <string.h>
+#include <time.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Debug.h"
+#include "TerminalScheduler.h"
+
+namespace smartcard_service_api
+{
+	TerminalScheduler::TerminalScheduler()
+	{
+		memset(&statistics, 0, sizeof(statistics));
+	}
+
+	TerminalScheduler::~TerminalScheduler()
+	{
+		clear();
+	}
+
+	unsigned long long TerminalScheduler::getTime()
+	{
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		return (unsigned long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+	}
+
+	unsigned int TerminalScheduler::getFlowHandle(DispatcherMsg *msg)
+	{
+		switch (msg->message)
+		{
+		case Message::MSG_REQUEST_TRANSMIT :
+		case Message::MSG_REQUEST_TRANSMIT_BATCH :
+			/* channel handle */
+			return msg->param1;
+
+		default :
+			/* opening or closing changes the channels, keep it in order with all */
+			return 0;
+		}
+	}
+
+	void TerminalScheduler::account(scheduler_statistics_t &statistics, unsigned long long wait)
+	{
+		statistics.depth--;
+		statistics.dispatched++;
+		statistics.totalWait += wait;
+
+		if (statistics.maxWait < wait)
+			statistics.maxWait = wait;
+	}
+
+	void TerminalScheduler::push(DispatcherMsg *msg)
+	{
+		map<int, client_t *>::iterator item;
+		client_t *client = NULL;
+		unsigned int handle;
+		entry_t entry;
+
+		if ((item = mapClients.find(msg->getPeerSocket())) == mapClients.end())
+		{
+			client = new client_t;
+
+			client->socket = msg->getPeerSocket();
+			client->seq = 0;
+			memset(&client->statistics, 0, sizeof(client->statistics));
+
+			mapClients.insert(make_pair(client->socket, client));
+		}
+		else
+		{
+			client = item->second;
+		}
+
+		entry.msg = msg;
+		entry.flow = NULL;
+		entry.seq = client->seq++;
+		entry.queued = getTime();
+
+		if ((handle = getFlowHandle(msg)) == 0)
+		{
+			client->control.push(entry);
+		}
+		else
+		{
+			map<unsigned int, flow_t *>::iterator flowItem;
+			flow_t *flow;
+
+			if ((flowItem = client->mapFlows.find(handle)) == client->mapFlows.end())
+			{
+				flow = new flow_t;
+				flow->handle = handle;
+				memset(&flow->statistics, 0, sizeof(flow->statistics));
+
+				client->mapFlows.insert(make_pair(handle, flow));
+			}
+			else
+			{
+				flow = flowItem->second;
+			}
+
+			/* idle channel takes its turn again */
+			if (flow->entries.size() == 0)
+			{
+				client->flows.push_back(flow);
+			}
+
+			entry.flow = flow;
+			flow->entries.push(entry);
+
+			if (++flow->statistics.depth > flow->statistics.maxDepth)
+				flow->statistics.maxDepth = flow->statistics.depth;
+		}
+
+		if (client->statistics.depth++ == 0)
+		{
+			activeClients.push_back(client);
+		}
+
+		if (client->statistics.maxDepth < client->statistics.depth)
+			client->statistics.maxDepth = client->statistics.depth;
+
+		if (++statistics.depth > statistics.maxDepth)
+			statistics.maxDepth = statistics.depth;
+	}
+
+	bool TerminalScheduler::popEntry(client_t *client, bool transmitOnly, int socket, unsigned int handle, entry_t &entry)
+	{
+		unsigned long long barrier = (unsigned long long)-1;
+		list<flow_t *>::iterator item;
+		size_t i, count;
+
+		if (client->control.size() > 0)
+		{
+			barrier = client->control.front().seq;
+
+			if (transmitOnly == false)
+			{
+				/* runs when everything queued before it is done */
+				for (item = client->flows.begin(); item != client->flows.end(); item++)
+				{
+					if ((*item)->entries.front().seq < barrier)
+						break;
+				}
+
+				if (item == client->flows.end())
+				{
+					entry = client->control.front();
+					client->control.pop();
+
+					return true;
+				}
+			}
+		}
+
+		/* channels in turn */
+		for (i = 0, count = client->flows.size(); i < count; i++)
+		{
+			flow_t *flow = client->flows.front();
+			entry_t &head = flow->entries.front();
+
+			client->flows.pop_front();
+
+			if (head.seq < barrier && (transmitOnly == false ||
+				(head.msg->message == Message::MSG_REQUEST_TRANSMIT &&
+				(client->socket != socket || flow->handle != handle))))
+			{
+				entry = head;
+				flow->entries.pop();
+
+				if (flow->entries.size() > 0)
+				{
+					client->flows.push_back(flow);
+				}
+
+				return true;
+			}
+
+			client->flows.push_back(flow);
+		}
+
+		return false;
+	}
+
+	DispatcherMsg *TerminalScheduler::dispatched(client_t *client, entry_t &entry)
+	{
+		unsigned long long wait = getTime() - entry.queued;
+
+		if (entry.flow != NULL)
+		{
+			account(entry.flow->statistics, wait);
+		}
+
+		account(client->statistics, wait);
+		account(statistics, wait);
+
+		/* closed channels don't send apdus any more */
+		switch (entry.msg->message)
+		{
+		case Message::MSG_REQUEST_CLOSE_CHANNEL :
+			removeIdleFlows(client, entry.msg->param1);
+			break;
+
+		case Message::MSG_REQUEST_CLOSE_CHANNELS :
+		case Message::MSG_REQUEST_CLOSE_SESSION :
+			removeIdleFlows(client, 0);
+			break;
+
+		default :
+			break;
+		}
+
+		/* next turn */
+		if (activeClients.front() == client)
+			activeClients.pop_front();
+		else
+			activeClients.remove(client);
+
+		if (client->statistics.depth > 0)
+		{
+			activeClients.push_back(client);
+		}
+
+		return entry.msg;
+	}
+
+	DispatcherMsg *TerminalScheduler::pop()
+	{
+		entry_t entry;
+		client_t *client;
+
+		if (activeClients.size() == 0)
+			return NULL;
+
+		client = activeClients.front();
+
+		/* a waiting client has always one request to run */
+		if (popEntry(client, false, -1, 0, entry) == false)
+		{
+			SCARD_DEBUG_ERR("no runnable request, socket [%d], depth [%d]", client->socket, client->statistics.depth);
+
+			return NULL;
+		}
+
+		return dispatched(client, entry);
+	}
+
+	DispatcherMsg *TerminalScheduler::popTransmit(int socket, unsigned int handle)
+	{
+		list<client_t *>::iterator item;
+		entry_t entry;
+
+		for (item = activeClients.begin(); item != activeClients.end(); item++)
+		{
+			if (popEntry(*item, true, socket, handle, entry) == true)
+			{
+				return dispatched(*item, entry);
+			}
+		}
+
+		return NULL;
+	}
+
+	/* handle 0 removes all idle channels of the client */
+	void TerminalScheduler::removeIdleFlows(client_t *client, unsigned int handle)
+	{
+		map<unsigned int, flow_t *>::iterator item;
+
+		for (item = client->mapFlows.begin(); item != client->mapFlows.end();)
+		{
+			if ((handle == 0 || item->first == handle) && item->second->entries.size() == 0)
+			{
+				delete item->second;
+				client->mapFlows.erase(item++);
+			}
+			else
+			{
+				item++;
+			}
+		}
+	}
+
+	void TerminalScheduler::remove(int socket)
+	{
+		map<int, client_t *>::iterator item;
+		map<unsigned int, flow_t *>::iterator flowItem;
+		client_t *client;
+
+		if ((item = mapClients.find(socket)) == mapClients.end())
+			return;
+
+		client = item->second;
+
+		while (client->control.size() > 0)
+		{
+			delete client->control.front().msg;
+			client->control.pop();
+		}
+
+		for (flowItem = client->mapFlows.begin(); flowItem != client->mapFlows.end(); flowItem++)
+		{
+			while (flowItem->second->entries.size() > 0)
+			{
+				delete flowItem->second->entries.front().msg;
+				flowItem->second->entries.pop();
+			}
+
+			delete flowItem->second;
+		}
+
+		SCARD_DEBUG("socket [%d], dispatched [%llu], wait avg [%llu] max [%llu] usec, depth max [%d], dropped [%d]",
+			socket, client->statistics.dispatched,
+			client->statistics.dispatched ? client->statistics.totalWait / client->statistics.dispatched : 0,
+			client->statistics.maxWait, client->statistics.maxDepth, client->statistics.depth);
+
+		statistics.depth -= client->statistics.depth;
+
+		activeClients.remove(client);
+		mapClients.erase(item);
+
+		delete client;
+	}
+
+	void TerminalScheduler::clear()
+	{
+		while (mapClients.size() > 0)
+		{
+			remove(mapClients.begin()->first);
+		}
+	}
+
+	void TerminalScheduler::getStatistics(vector<queue_statistics_t> &result)
+	{
+		map<int, client_t *>::iterator item;
+		map<unsigned int, flow_t *>::iterator flowItem;
+		queue_statistics_t queue;
+
+		result.clear();
+
+		queue.socket = -1;
+		queue.handle = 0;
+		queue.statistics = statistics;
+		result.push_back(queue);
+
+		for (item = mapClients.begin(); item != mapClients.end(); item++)
+		{
+			queue.socket = item->first;
+			queue.handle = 0;
+			queue.statistics = item->second->statistics;
+			result.push_back(queue);
+
+			for (flowItem = item->second->mapFlows.begin(); flowItem != item->second->mapFlows.end(); flowItem++)
+			{
+				queue.handle = flowItem->first;
+				queue.statistics = flowItem->second->statistics;
+				result.push_back(queue);
+			}
+		}
+	}
+
+} /* namespace smartcard_service_api */
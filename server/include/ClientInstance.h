@@ -20,6 +20,7 @@
 
 /* standard library header */
 #include <map>
+#include <sys/types.h>
 //#include <hash_map>
 
 /* SLP library header */
@@ -38,22 +39,26 @@ namespace smartcard_service_api
 		int watchID;
 		int state;
 		int pid;
+		uid_t uid;
+		char processName[64]; /* base64 of sha256 of the executable name, computed once per pid */
 		ByteArray certHash;
 
 		map<unsigned int, ServiceInstance *> mapServices;
 
-		inline ByteArray getCertificationHash() { return certHash; }
-
 	public:
-		ClientInstance(void *ioChannel, int socket, int watchID, int state, int pid)
+		ClientInstance(void *ioChannel, int socket, int watchID, int state, int pid, uid_t uid)
 		{
 			this->ioChannel = ioChannel;
 			this->socket = socket;
 			this->watchID = watchID;
 			this->state = state;
-			this->pid = pid;
+			this->pid = -1;
+			this->uid = uid;
+			this->processName[0] = '\0';
+
+			setPID(pid);
 		}
-		~ClientInstance() { removeServices(); }
+		~ClientInstance();
 
 		inline bool operator ==(const int &socket) const { return (this->socket == socket); }
 
@@ -64,12 +69,18 @@ namespace smartcard_service_api
 
 		void setPID(int pid);
 		inline int getPID() { return pid; }
+		inline uid_t getUID() { return uid; }
+		inline const char *getProcessName() { return processName; }
+
+		void setCertificationHash(const ByteArray &hash);
+		inline const ByteArray &getCertificationHash() { return certHash; }
 
 
 		bool createService(unsigned int context);
 		ServiceInstance *getService(unsigned int context);
-		void removeService(unsigned int context);
-		void removeServices();
+		/* channels of the services are left in closing */
+		void removeService(unsigned int context, vector<ServerChannel *> &closing);
+		void removeServices(vector<ServerChannel *> &closing);
 
 		bool sendMessageToAllServices(int socket, Message &msg);
 	};
@@ -0,0 +1,128 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef HANDLETABLE_H_
+#define HANDLETABLE_H_
+
+/* standard library header */
+
+/* SLP library header */
+
+/* local header */
+#include "Lock.h"
+
+namespace smartcard_service_api
+{
+	class Terminal;
+	class ServerSession;
+	class ServerChannel;
+
+	/* handle = generation (upper 16 bits) | slot index (lower 16 bits).
+	 * lookups don't lock, a released or forged handle fails the generation check */
+	class HandleTable
+	{
+	public:
+		static const unsigned int INVALID_HANDLE = (unsigned int)-1;
+		static const int ANY_OWNER = -1;
+
+		static const int HANDLE_TYPE_NONE = 0;
+		static const int HANDLE_TYPE_READER = 1;
+		static const int HANDLE_TYPE_SESSION = 2;
+		static const int HANDLE_TYPE_CHANNEL = 3;
+
+	private:
+		static const unsigned int INDEX_BITS = 16;
+		static const unsigned int INDEX_MASK = 0xFFFF;
+		static const unsigned int GENERATION_MASK = 0xFFFF;
+		static const unsigned int SEGMENT_SIZE = 256;
+		static const unsigned int SEGMENT_COUNT = 255; /* index 0xFFFF is never used */
+		static const unsigned int NO_SLOT = (unsigned int)-1;
+
+		typedef struct _handle_slot_t
+		{
+			volatile unsigned int generation; /* odd while assigned */
+			volatile int type;
+			void *volatile object;
+			Terminal *volatile terminal; /* routing never dereferences the object */
+			volatile int socket;
+			volatile unsigned int context;
+			unsigned int nextFree;
+		}
+		handle_slot_t;
+
+		/* segments are never freed or moved, readers may hold a slot pointer */
+		handle_slot_t *volatile segments[SEGMENT_COUNT];
+		unsigned int segmentCount;
+		unsigned int freeHead; /* released slots are reused in fifo order */
+		unsigned int freeTail;
+		unsigned int usedCount;
+		PMutex mutexLock;
+
+		HandleTable();
+		~HandleTable();
+
+		inline handle_slot_t *getSlot(unsigned int index) const
+		{
+			handle_slot_t *segment;
+
+			if (index / SEGMENT_SIZE >= SEGMENT_COUNT)
+				return NULL;
+
+			if ((segment = segments[index / SEGMENT_SIZE]) == NULL)
+				return NULL;
+
+			return &segment[index % SEGMENT_SIZE];
+		}
+
+		bool appendSegment();
+		void pushFreeSlot(unsigned int index);
+
+	public:
+		static HandleTable &getInstance();
+
+		unsigned int assignHandle(int type, void *object, int socket = ANY_OWNER, unsigned int context = 0, Terminal *terminal = NULL);
+		bool releaseHandle(unsigned int handle);
+
+		void *getObject(unsigned int handle, int type, int socket = ANY_OWNER, unsigned int context = 0) const;
+		/* the object may be deleted by its worker meanwhile, its terminal stays */
+		Terminal *getObjectTerminal(unsigned int handle, int type, int socket, unsigned int context) const;
+		inline unsigned int getCount() const { return usedCount; }
+
+		inline Terminal *getTerminal(unsigned int handle) const
+		{
+			return (Terminal *)getObject(handle, HANDLE_TYPE_READER);
+		}
+		inline ServerSession *getSession(unsigned int handle, int socket, unsigned int context) const
+		{
+			return (ServerSession *)getObject(handle, HANDLE_TYPE_SESSION, socket, context);
+		}
+		inline ServerChannel *getChannel(unsigned int handle, int socket, unsigned int context) const
+		{
+			return (ServerChannel *)getObject(handle, HANDLE_TYPE_CHANNEL, socket, context);
+		}
+		inline Terminal *getSessionTerminal(unsigned int handle, int socket, unsigned int context) const
+		{
+			return getObjectTerminal(handle, HANDLE_TYPE_SESSION, socket, context);
+		}
+		inline Terminal *getChannelTerminal(unsigned int handle, int socket, unsigned int context) const
+		{
+			return getObjectTerminal(handle, HANDLE_TYPE_CHANNEL, socket, context);
+		}
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* HANDLETABLE_H_ */
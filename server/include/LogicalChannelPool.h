@@ -0,0 +1,96 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef LOGICALCHANNELPOOL_H_
+#define LOGICALCHANNELPOOL_H_
+
+/* standard library header */
+#include <vector>
+
+/* SLP library header */
+
+/* local header */
+#include "Terminal.h"
+#include "Lock.h"
+
+using namespace std;
+
+#ifndef CHANNEL_POOL_SIZE
+#define CHANNEL_POOL_SIZE 2
+#endif
+
+namespace smartcard_service_api
+{
+	typedef struct _pool_statistics_t
+	{
+		unsigned int capacity;
+		unsigned int idle; /* channels open now */
+		unsigned int hit;
+		unsigned int miss;
+		bool disabled;
+	}
+	pool_statistics_t;
+
+	/* logical channels kept open on the card of one terminal, so opening a
+	 * channel costs only the select of the application.
+	 * a returned channel is reset by an empty select before it is reused,
+	 * if the card refuses it, the pool is disabled until the card changes.
+	 * card i/o is done by the worker of the terminal, only invalidate() may
+	 * be called from elsewhere */
+	class LogicalChannelPool
+	{
+	private:
+		Terminal *terminal;
+		unsigned int capacity;
+		vector<int> idleChannels; /* open and reset */
+		unsigned int epoch; /* changes when the card is removed */
+		bool disabled;
+		unsigned int hitCount;
+		unsigned int missCount;
+		PMutex poolLock;
+
+		int openChannel();
+		void closeChannel(int channelNum);
+		bool resetChannel(int channelNum);
+		bool hasRoom(unsigned int epoch);
+		bool keepChannel(int channelNum, unsigned int epoch);
+
+	public:
+		LogicalChannelPool(Terminal *terminal, unsigned int capacity);
+		~LogicalChannelPool();
+
+		/* opens channels up to the capacity */
+		void fill();
+
+		/* returns an open channel or -1, epoch is given back with the channel */
+		int acquire(unsigned int &epoch);
+
+		/* false if the channel must be closed by the caller */
+		bool release(int channelNum, unsigned int epoch);
+
+		/* the card is removed, its channels are gone */
+		void invalidate();
+
+		inline unsigned int getHitCount() { return hitCount; }
+		inline unsigned int getMissCount() { return missCount; }
+		inline bool isDisabled() { return disabled; }
+
+		void getStatistics(pool_statistics_t &result);
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* LOGICALCHANNELPOOL_H_ */
@@ -0,0 +1,59 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef SERVERACLMANAGER_H_
+#define SERVERACLMANAGER_H_
+
+/* standard library header */
+#include <glib.h>
+
+/* SLP library header */
+
+/* local header */
+#include "Terminal.h"
+
+namespace smartcard_service_api
+{
+	/* loads access control lists in terminal workers, off the request path */
+	class ServerACLManager
+	{
+	private:
+		unsigned int interval;
+		guint timerID;
+
+		ServerACLManager();
+		~ServerACLManager();
+
+		static gboolean timerCallback(gpointer user_data);
+
+	public:
+		static const unsigned int DEFAULT_INTERVAL = 600; /* seconds */
+
+		static ServerACLManager *getInstance();
+
+		/* interval 0 disables periodic refresh tag check */
+		void start(unsigned int interval);
+		void stop();
+
+		void requestUpdate();
+		/* forced update reloads the list even if the refresh tag is the same */
+		void requestUpdate(Terminal *terminal, bool force = false);
+		void requestUpdate(const char *name, bool force = false);
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* SERVERACLMANAGER_H_ */
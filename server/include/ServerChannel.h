@@ -19,6 +19,7 @@
 #define SERVERCHANNEL_H_
 
 /* standard library header */
+#include <vector>
 
 /* SLP library header */
 
@@ -26,33 +27,61 @@
 #include "Channel.h"
 #include "Terminal.h"
 #include "ServerSession.h"
+#include "AccessCondition.h"
 
 namespace smartcard_service_api
 {
+	class TerminalDispatcher;
+	class LogicalChannelPool;
+
 	class ServerChannel: public Channel
 	{
 	private:
 		Terminal *terminal;
 		void *caller;
+		APDUAccessRule apduRule; /* copied from access control list at opening */
+		unsigned int handle; /* handle given to the client, INVALID_HANDLE for internal channels */
+		ServerChannel *prevChannel; /* channel list of the session */
+		ServerChannel *nextChannel;
+		LogicalChannelPool *pool; /* channel goes back to the pool at closing, if set */
+		unsigned int poolEpoch;
 
 		ServerChannel(ServerSession *session, void *caller, int channelNum, Terminal *terminal);
 
+		static unsigned char getResponseCLA(unsigned char cla);
+
 	protected:
+		int buildCommand(const ByteArray &command, ByteArray &apdu);
 		void closeSync();
-		int transmitSync(ByteArray command, ByteArray &result);
+		int transmitSync(const ByteArray &command, ByteArray &result);
+		/* with GET RESPONSE and Le retries, count is the number of extra apdus */
+		int transmitSync(const ByteArray &command, ByteArray &result, unsigned int &count);
+		int transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results);
+		/* options are TRANSMIT_* of Message, worker is given to let other channels run between the apdus */
+		int transmitSync(vector<ByteArray> &commands, vector<ByteArray> &results, unsigned int options, unsigned int &count, TerminalDispatcher *worker = NULL);
 
 	public:
+		/* limits of response chaining, the card status is returned as is beyond them */
+		static const unsigned int MAX_CHAINED_RESPONSE = 65536;
+		static const unsigned int MAX_CHAINED_APDUS = 256;
+
 		~ServerChannel();
 
+		/* response is added to collected, next is set if another apdu completes it */
+		static bool chainResponse(const ByteArray &apdu, const ByteArray &response, ByteArray &collected, unsigned int count, ByteArray &next);
+
 		int getChannelNumber();
+		inline Terminal *getTerminal() { return terminal; }
 
 		int close(closeCallback callback, void *userParam) { return -1; }
-		int transmit(ByteArray command, transmitCallback callback, void *userParam) { return -1; };
+		int transmit(const ByteArray &command, transmitCallback callback, void *userParam) { return -1; };
 
 		friend class ServerReader;
 		friend class ServerSession;
 		friend class ServiceInstance;
 		friend class ServerResource;
+		friend class ServerDispatcher;
+		friend class TerminalDispatcher;
 	};
 
 } /* namespace smartcard_service_api */
@@ -19,11 +19,18 @@
 #define SERVERDISPATCHER_H_
 
 /* standard library header */
+#include <map>
+#include <glib.h>
 
 /* SLP library header */
 
 /* local header */
 #include "DispatcherHelper.h"
+#include "TerminalDispatcher.h"
+#include "Terminal.h"
+#include "Lock.h"
+
+using namespace std;
 
 namespace smartcard_service_api
 {
@@ -32,14 +39,37 @@ namespace smartcard_service_api
 	class ServerDispatcher: public DispatcherHelper
 	{
 	private:
+		PMutex terminalLock;
+		map<Terminal *, TerminalDispatcher *> mapTerminals; /* terminal instance <-> worker queue map */
+		guint statisticsTimerID;
+
 		ServerDispatcher();
 		~ServerDispatcher();
 
 		void *dispatcherThreadFunc(DispatcherMsg *msg, void *data);
 
+		TerminalDispatcher *getTerminalDispatcher(DispatcherMsg *msg);
+		void lockTerminals();
+		void unlockTerminals();
+		void removeTerminalMessages(int socket);
+
+		static gboolean statisticsCallback(gpointer user_data);
+
 	public:
 
 		static ServerDispatcher *getInstance();
+
+		void pushMessage(DispatcherMsg *msg);
+
+		bool addTerminal(Terminal *terminal, void *library);
+		void removeTerminal(Terminal *terminal);
+
+		/* queue depth and wait time of every terminal, client and channel to the log.
+		 * interval 0 stops the periodic dump */
+		void dumpStatistics();
+		void startStatistics(unsigned int interval);
+
+		friend class TerminalDispatcher;
 	};
 
 } /* namespace smartcard_service_api */
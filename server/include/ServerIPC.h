@@ -14,30 +14,97 @@
 * limitations under the License.
 */
 
+
 #ifndef SERVERIPC_H_
 #define SERVERIPC_H_
 
 /* standard library header */
 #include <map>
+#include <vector>
+#include <pthread.h>
 
 /* SLP library header */
 
 /* local header */
 #include "IPCHelper.h"
+#include "DispatcherMsg.h"
+#include "Lock.h"
+#ifdef USE_SHM_TRANSPORT
+#include "IPCSharedMemory.h"
+#endif
 
 using namespace std;
 
 namespace smartcard_service_api
 {
+	/* receiving state and writer lock of a client socket.
+	 * the socket is closed when the last reference is dropped */
+	class IPCConnection
+	{
+	public:
+		int socket;
+		int refCount; /* the map and every sender in progress */
+		unsigned int received; /* bytes of the current frame */
+		message_header_t header;
+		DispatcherMsg *msg;
+		vector<int> fds; /* passed with the current frame */
+		PMutex sendLock;
+		ByteArray pending; /* frames the socket couldn't take yet */
+		unsigned int pendingOffset;
+#ifdef USE_SHM_TRANSPORT
+		IPCSharedMemory *shm;
+
+		IPCConnection(int socket) : socket(socket), refCount(1), received(0), msg(NULL), pendingOffset(0), shm(NULL) {}
+#else
+		IPCConnection(int socket) : socket(socket), refCount(1), received(0), msg(NULL), pendingOffset(0) {}
+#endif
+		~IPCConnection();
+
+		void closeDescriptors();
+	};
+
+	typedef void (*ipcEventHandler)(int fd, void *userParam);
+
 	class ServerIPC: public IPCHelper
 	{
 	private:
+		static const int IPC_MAX_EVENTS = 32;
+		static const int IPC_MAX_FRAMES = 8; /* per wakeup, a busy client can't starve the others */
+		static const int IPC_MAX_DESCRIPTORS = 4;
+		static const unsigned int IPC_MAX_PENDING = 1024 * 1024; /* unsent bytes before a client is dropped */
+
+		int epollFd;
+		pthread_t reactorThread;
+		PMutex connectionLock;
+		map<int, IPCConnection *> mapConnections;
+#ifdef USE_SHM_TRANSPORT
+		map<int, int> mapDoorbells; /* doorbell, socket */
+#endif
+		map<int, pair<ipcEventHandler, void *> > mapEventSources; /* descriptors of terminal plugins */
+
 		ServerIPC();
 		~ServerIPC();
 
+		static void *reactorThreadFunc(void *data);
+		void runReactor();
+
 		bool acceptClient();
 		void restartServerIPC();
 		void releaseClient(void *channel, int socket, int watchID);
+		IPCConnection *getConnection(int socket);
+		void putConnection(IPCConnection *connection);
+		ssize_t receiveData(IPCConnection *connection, void *buffer, size_t length);
+		bool receiveFrames(IPCConnection *connection, vector<DispatcherMsg *> &messages);
+		void handleClientEvent(int socket, unsigned int events);
+		void disconnectClient(int socket);
+		bool queueFrame(IPCConnection *connection, Message *msg);
+		bool flushFrames(IPCConnection *connection);
+		void watchWritable(IPCConnection *connection, bool writable);
+		void attachTransport(IPCConnection *connection);
+#ifdef USE_SHM_TRANSPORT
+		bool handleDoorbellEvent(int doorbell);
+#endif
+		bool handleEventSource(int fd);
 
 		int handleIOErrorCondition(void *channel, GIOCondition condition);
 		int handleInvalidSocketCondition(void *channel, GIOCondition condition);
@@ -46,6 +113,13 @@ namespace smartcard_service_api
 	public:
 		static ServerIPC *getInstance();
 
+		bool createListenSocket();
+		bool sendMessage(int socket, Message *msg);
+
+		/* handler is called on the reactor thread when fd is readable */
+		bool addEventSource(int fd, ipcEventHandler handler, void *userParam);
+		void removeEventSource(int fd);
+
 		friend class ServerResource;
 	};
 
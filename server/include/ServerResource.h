@@ -34,33 +34,35 @@
 #include "ServerSession.h"
 #include "ClientInstance.h"
 #include "ServiceInstance.h"
+#include "HandleTable.h"
+#include "LogicalChannelPool.h"
 
 using namespace std;
 
 namespace smartcard_service_api
 {
-	class IntegerHandle
-	{
-	private:
-		static unsigned int newHandle;
-		static set<unsigned int> setHandles;
-		static PMutex mutexLock;
-
-	public:
-		static const unsigned int INVALID_HANDLE = (unsigned int)-1;
-
-		static unsigned int assignHandle();
-		static void releaseHandle(unsigned int);
-	};
-
 	class ServerResource
 	{
 	private:
+		typedef struct _atr_cache_t
+		{
+			ByteArray atr; /* empty until read from the card */
+			unsigned int generation; /* changes at invalidation, a read started before is dropped */
+		}
+		atr_cache_t;
+
 		/* non-static member */
 		vector<void *> libraries;
-		map<unsigned int, Terminal *> mapTerminals; /* unique id <-> terminal instance map */
+		map<unsigned int, Terminal *> mapTerminals; /* reader handle <-> terminal instance map */
 		map<int, ClientInstance *> mapClients; /* client pid <-> client instance map */
 		map<Terminal *, AccessControlList *> mapACL; /* terminal instance <-> access control instance map */
+		map<Terminal *, LogicalChannelPool *> mapChannelPools; /* terminal instance <-> idle logical channels */
+		map<Terminal *, atr_cache_t> mapATR; /* terminal instance <-> answer to reset of the current card */
+		map<Terminal *, bool> mapPresence; /* terminal instance <-> se presence, kept by notifications */
+		ByteArray readersInfo; /* prebuilt reply of MSG_REQUEST_READERS */
+		int readersCount;
+		unsigned int readersVersion; /* changes at each rebuild, never 0 */
+		PRecursiveMutex resourceLock; /* guards the maps above, terminal workers share them */
 
 		ServerIPC *serverIPC;
 		ServerDispatcher *serverDispatcher;
@@ -69,8 +71,10 @@ namespace smartcard_service_api
 		~ServerResource();
 
 		Terminal *createInstance(void *library);
+		AccessControlList *createAccessControlList(Terminal *terminal);
 		bool appendSELibrary(char *library);
 		void clearSELibraries();
+		void setPresence(const char *name, bool present);
 
 		static void terminalCallback(void *terminal, int event, int error, void *user_param);
 
@@ -84,10 +88,14 @@ namespace smartcard_service_api
 
 		Terminal *getTerminal(unsigned int terminalID);
 		Terminal *getTerminal(const char *name);
-		int getReadersInformation(ByteArray &info);
+		void getTerminals(vector<Terminal *> &terminals);
+		Terminal *getTerminalBySession(int socket, unsigned int context, unsigned int sessionID);
+		Terminal *getTerminalByChannel(int socket, unsigned int context, unsigned int channelID);
+		void updateReadersInformation();
+		int getReadersInformation(ByteArray &info, unsigned int &version);
 		bool isValidReaderHandle(unsigned int reader);
 
-		bool createClient(void *ioChannel, int socket, int watchID, int state, int pid);
+		bool createClient(void *ioChannel, int socket, int watchID, int state, int pid, uid_t uid);
 		ClientInstance *getClient(int socket);
 		void setPID(int socket, int pid);
 		void removeClient(int socket);
@@ -98,17 +106,25 @@ namespace smartcard_service_api
 		void removeService(int socket, unsigned int context);
 		void removeServices(int socket);
 
-		unsigned int createSession(int socket, unsigned int context, unsigned int terminalID, ByteArray packageCert, void *caller);
+		unsigned int createSession(int socket, unsigned int context, unsigned int terminalID, void *caller);
 		ServerSession *getSession(int socket, unsigned int context, unsigned int sessionID);
 		unsigned int getChannelCount(int socket, unsigned int context, unsigned int sessionID);
 		void removeSession(int socket, unsigned int context, unsigned int session);
 		bool isValidSessionHandle(int socket, unsigned int context, unsigned int sessionID);
 
-		unsigned int createChannel(int socket, unsigned int context, unsigned int sessionID, int channelType, ByteArray aid);
+		unsigned int createChannel(int socket, unsigned int context, unsigned int sessionID, int channelType, const ByteArray &aid);
 		Channel *getChannel(int socket, unsigned int context, unsigned int channelID);
 		void removeChannel(int socket, unsigned int context, unsigned int channelID);
+		void removeChannels(int socket, unsigned int context, unsigned int sessionID);
 
 		AccessControlList *getAccessControlList(Terminal *terminal);
+		/* the list is rebuilt only if its refresh tag is changed, unless forced */
+		void updateAccessControlList(Terminal *terminal, bool force = false);
+
+		LogicalChannelPool *getChannelPool(Terminal *terminal);
+
+		int getATR(Terminal *terminal, ByteArray &atr);
+		void invalidateATR(Terminal *terminal);
 
 		bool sendMessageToAllClients(Message &msg);
 
@@ -35,6 +35,7 @@ using namespace std;
 namespace smartcard_service_api
 {
 	class ServerReader;
+	class ServerChannel;
 
 	class ServerSession : public SessionHelper
 	{
@@ -42,8 +43,10 @@ namespace smartcard_service_api
 		void *caller;
 		Terminal *terminal;
 		ByteArray packageCert;
+		ServerChannel *channelList; /* channels opened by the client, linked through ServerChannel */
+		unsigned int channelCount;
 
-		ServerSession(ServerReader *reader, ByteArray packageCert, void *caller, Terminal *terminal);
+		ServerSession(ServerReader *reader, const ByteArray &packageCert, void *caller, Terminal *terminal);
 
 		int getATR(getATRCallback callback, void *userData){ return -1; }
 		int close(closeSessionCallback callback, void *userData){ return -1; }
@@ -60,6 +63,11 @@ namespace smartcard_service_api
 
 		void closeChannels();
 
+		void linkChannel(ServerChannel *channel);
+		void unlinkChannel(ServerChannel *channel);
+		inline ServerChannel *getChannelList() { return channelList; }
+		inline unsigned int getChannelCount() { return channelCount; }
+
 		Channel *openBasicChannelSync(ByteArray aid);
 		Channel *openBasicChannelSync(unsigned char *aid, unsigned int length);
 		Channel *openBasicChannelSync(ByteArray aid, void *caller);
@@ -20,6 +20,7 @@
 
 /* standard library header */
 #include <map>
+#include <vector>
 
 /* SLP library header */
 
@@ -37,8 +38,10 @@ namespace smartcard_service_api
 	private:
 		unsigned int context;
 		ClientInstance *parent;
-		map<unsigned int, pair<ServerSession *, Terminal *> > mapSessions; /* session unique id <-> terminal instance map */
-		map<unsigned int, pair<unsigned int, ServerChannel *> > mapChannels; /* channel unique id <-> (session unique id, channel instance) map */
+		map<unsigned int, ServerSession *> mapSessions; /* session handle <-> session instance map, lookups go to HandleTable */
+
+		void destroyChannel(ServerSession *session, ServerChannel *channel, vector<ServerChannel *> &closing);
+		void closeChannelsBySession(ServerSession *session, vector<ServerChannel *> &closing);
 
 	public:
 		ServiceInstance(ClientInstance *parent, unsigned int context)
@@ -46,26 +49,30 @@ namespace smartcard_service_api
 			this->parent = parent;
 			this->context = context;
 		}
-		~ServiceInstance() { closeSessions(); };
+		~ServiceInstance();
 
 		inline bool operator ==(const unsigned int &context) const { return (this->context == context); }
-		inline bool isVaildSessionHandle(unsigned int handle) { return (mapSessions.find(handle) != mapSessions.end()); }
-		inline bool isVaildChannelHandle(unsigned int handle) { return (mapChannels.find(handle) != mapChannels.end()); }
+		inline bool isVaildSessionHandle(unsigned int handle) { return (getSession(handle) != NULL); }
+		inline bool isVaildChannelHandle(unsigned int handle) { return (getChannel(handle) != NULL); }
 		inline ClientInstance *getParent() { return parent; }
+		inline unsigned int getContext() { return context; }
 
-		unsigned int openSession(Terminal *terminal, ByteArray packageCert, void *caller);
+		unsigned int openSession(Terminal *terminal, void *caller);
 		ServerSession *getSession(unsigned int session);
-		void closeSession(unsigned int session);
-		void closeSessions();
+		/* unlinked channels are put in closing, destroyChannels closes them on the card */
+		void closeSession(unsigned int session, vector<ServerChannel *> &closing);
+		void closeSessions(vector<ServerChannel *> &closing);
 
 		Terminal *getTerminal(unsigned int session);
 
 		unsigned int openChannel(unsigned int session, int channelNum);
 		ServerChannel *getChannel(/*unsigned int session, */unsigned int channel);
 		unsigned int getChannelCountBySession(unsigned int session);
-		void closeChannel(unsigned int channel);
-		void closeChannelsBySession(unsigned int session);
-		void closeChannels();
+		void closeChannel(unsigned int channel, vector<ServerChannel *> &closing);
+		void closeChannelsBySession(unsigned int session, vector<ServerChannel *> &closing);
+		void closeChannels(vector<ServerChannel *> &closing);
+
+		static void destroyChannels(vector<ServerChannel *> &channels);
 	};
 
 } /* namespace smartcard_service_api */
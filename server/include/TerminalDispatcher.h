@@ -0,0 +1,109 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef TERMINALDISPATCHER_H_
+#define TERMINALDISPATCHER_H_
+
+/* standard library header */
+#include <queue>
+#include <pthread.h>
+
+/* SLP library header */
+
+/* local header */
+#include "DispatcherHelper.h"
+#include "Terminal.h"
+#include "TerminalInterface.h"
+#include "TerminalScheduler.h"
+#include "Lock.h"
+
+using namespace std;
+
+namespace smartcard_service_api
+{
+	class ServerDispatcher;
+
+	/* worker queue which serializes the requests for one terminal.
+	 * requests wait in the scheduler, which picks the next one fairly.
+	 * with an async capable plugin, transmits are submitted by the thread
+	 * which queued them or by the completion of the previous one, only
+	 * requests which may block on the card go to the worker thread */
+	class TerminalDispatcher: public DispatcherHelper
+	{
+	private:
+		typedef struct _transmit_context_t
+		{
+			TerminalDispatcher *dispatcher;
+			int socket;
+			Message *response;
+			bool chaining; /* TRANSMIT_AUTO_GET_RESPONSE */
+			ByteArray apdu; /* last apdu sent */
+			ByteArray collected;
+			unsigned int count;
+		}
+		transmit_context_t;
+
+		Terminal *terminal;
+		PMutex processLock;
+		TerminalScheduler scheduler; /* under syncLock, or stateMutex if asynchronous */
+		DispatcherMsg *runningMsg; /* request on the worker thread */
+
+		/* plugin abi version 2 */
+		unsigned int capabilities;
+		int eventFd;
+		terminal_process_events_fn processEvents;
+
+		pthread_mutex_t stateMutex;
+		pthread_cond_t stateCondition;
+		bool busy; /* a request or a lock owns the terminal */
+
+		void *dispatcherThreadFunc(DispatcherMsg *msg, void *data);
+		DispatcherMsg *fetchMessage();
+
+		void loadInterface(void *library);
+		void lockScheduler();
+		void unlockScheduler();
+		void runNext();
+		bool submitTransmit(DispatcherMsg *msg);
+
+		static void transmitCallback(unsigned char *buffer, unsigned int length, int error, void *userParam);
+		static void eventHandler(int fd, void *userParam);
+
+	public:
+		TerminalDispatcher(Terminal *terminal, void *library);
+		~TerminalDispatcher();
+
+		inline Terminal *getTerminal() { return terminal; }
+		inline bool isAsynchronous() { return ((capabilities & TERMINAL_CAP_ASYNC_TRANSMIT) != 0); }
+
+		void pushMessage(DispatcherMsg *msg);
+		void removeMessages(int socket);
+
+		/* between two apdus of a batch, runs the apdus of other channels due before the next one */
+		void interleave();
+
+		void getStatistics(vector<queue_statistics_t> &result);
+
+		/* block the terminal between two requests */
+		void lock();
+		void unlock();
+
+		friend class ServerDispatcher;
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* TERMINALDISPATCHER_H_ */
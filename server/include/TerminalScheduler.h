@@ -0,0 +1,128 @@
+/*
+* Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef TERMINALSCHEDULER_H_
+#define TERMINALSCHEDULER_H_
+
+/* standard library header */
+#include <map>
+#include <list>
+#include <queue>
+#include <vector>
+
+/* SLP library header */
+
+/* local header */
+#include "DispatcherMsg.h"
+
+using namespace std;
+
+namespace smartcard_service_api
+{
+	typedef struct _scheduler_statistics_t
+	{
+		unsigned int depth; /* requests waiting now */
+		unsigned int maxDepth;
+		unsigned long long dispatched;
+		unsigned long long totalWait; /* usec */
+		unsigned long long maxWait; /* usec */
+	}
+	scheduler_statistics_t;
+
+	typedef struct _queue_statistics_t
+	{
+		int socket; /* -1 for the whole terminal */
+		unsigned int handle; /* channel, 0 for all requests of the client */
+		scheduler_statistics_t statistics;
+	}
+	queue_statistics_t;
+
+	/* requests waiting for one terminal, served round robin over clients and
+	 * then over the channels of a client, so every client gets an equal share
+	 * of the card and its channels split that share.
+	 * apdus of a channel keep their order, other requests of a client are
+	 * barriers which run after everything queued before them and before
+	 * everything queued after them.
+	 * not locked, the owner serializes the calls */
+	class TerminalScheduler
+	{
+	private:
+		struct _flow_t;
+
+		typedef struct _entry_t
+		{
+			DispatcherMsg *msg;
+			struct _flow_t *flow; /* NULL for requests other than apdus */
+			unsigned long long seq;
+			unsigned long long queued; /* usec */
+		}
+		entry_t;
+
+		/* kept while the channel is open, so its numbers last over idle times */
+		typedef struct _flow_t
+		{
+			unsigned int handle;
+			queue<entry_t> entries;
+			scheduler_statistics_t statistics;
+		}
+		flow_t;
+
+		typedef struct _client_t
+		{
+			int socket;
+			unsigned long long seq;
+			queue<entry_t> control; /* requests other than apdus, in order */
+			list<flow_t *> flows; /* channels with apdus waiting, in turn */
+			map<unsigned int, flow_t *> mapFlows; /* all channels which sent apdus */
+			scheduler_statistics_t statistics;
+		}
+		client_t;
+
+		map<int, client_t *> mapClients;
+		list<client_t *> activeClients; /* clients with requests waiting, in turn */
+		scheduler_statistics_t statistics;
+
+		static unsigned long long getTime();
+		static unsigned int getFlowHandle(DispatcherMsg *msg);
+		static void account(scheduler_statistics_t &statistics, unsigned long long wait);
+
+		bool popEntry(client_t *client, bool transmitOnly, int socket, unsigned int handle, entry_t &entry);
+		DispatcherMsg *dispatched(client_t *client, entry_t &entry);
+		void removeIdleFlows(client_t *client, unsigned int handle);
+
+	public:
+		TerminalScheduler();
+		~TerminalScheduler();
+
+		void push(DispatcherMsg *msg);
+		DispatcherMsg *pop();
+
+		/* single apdu of another channel, to run between the apdus of a batch on this one */
+		DispatcherMsg *popTransmit(int socket, unsigned int handle);
+
+		void remove(int socket);
+		void clear();
+
+		inline unsigned int getDepth() { return statistics.depth; }
+		inline unsigned int getActiveClientCount() { return activeClients.size(); }
+
+		/* terminal first, then each client followed by its channels */
+		void getStatistics(vector<queue_statistics_t> &result);
+	};
+
+} /* namespace smartcard_service_api */
+#endif /* TERMINALSCHEDULER_H_ */
@@ -33,6 +33,8 @@
 #include "Channel.h"
 #include "ServerResource.h"
 #include "ServerSEService.h"
+#include "ServerACLManager.h"
+#include "ServerDispatcher.h"
 
 /* definition */
 using namespace std;
@@ -83,9 +85,37 @@ static void daemonize(void)
 	close(STDERR_FILENO);
 }
 
-int main()
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage : %s [-r refresh interval of access control in seconds, 0 to disable]"
+		" [-s interval of scheduler and channel pool statistics in the log, in seconds]\n", name);
+}
+
+int main(int argc, char *argv[])
 {
 	GMainLoop* loop = NULL;
+	unsigned int aclInterval = ServerACLManager::DEFAULT_INTERVAL;
+	unsigned int statisticsInterval = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r' :
+			aclInterval = strtoul(optarg, NULL, 10);
+			break;
+
+		case 's' :
+			statisticsInterval = strtoul(optarg, NULL, 10);
+			break;
+
+		default :
+			usage(argv[0]);
+			exit(EXIT_FAILURE);
+			break;
+		}
+	}
 
 	daemonize();
 
@@ -97,6 +127,11 @@ int main()
 	serverResource = &ServerResource::getInstance();
 	ServerIPC::getInstance()->createListenSocket();
 
+	/* load access control lists before clients ask for them */
+	ServerACLManager::getInstance()->start(aclInterval);
+
+	ServerDispatcher::getInstance()->startStatistics(statisticsInterval);
+
 	loop = g_main_new(TRUE);
 	g_main_loop_run(loop);
 